@@ -0,0 +1,90 @@
+// Header file for this class
+#include "AnimationScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Longest gap the adaptive timestep will integrate over in one tick, in seconds
+const double MAX_ADAPTIVE_STEP = 0.1;
+
+} // namespace
+
+// Constructor
+AnimationScheduler::AnimationScheduler() {
+    transform = vtkSmartPointer<vtkTransform>::New();
+    transform->PostMultiply();
+}
+
+void AnimationScheduler::setRates(double x, double y, double z) {
+    rates[0] = x;
+    rates[1] = y;
+    rates[2] = z;
+}
+
+double AnimationScheduler::getRate(int axis) const {
+    return rates[axis];
+}
+
+// Changing the step drops any partial step that was accumulated
+void AnimationScheduler::setTimestep(double seconds) {
+    timestep = std::max(0.0, seconds);
+    accumulator = 0.0;
+}
+
+void AnimationScheduler::setPivot(const double pivot[3]) {
+    std::copy(pivot, pivot + 3, this->pivot);
+    updateTransform();
+}
+
+// Integrates the rates over the real time since the last tick
+bool AnimationScheduler::tick(Clock::time_point now) {
+    if (!started) {
+        started = true;
+        last = now;
+        return false;
+    }
+
+    double elapsed = std::chrono::duration<double>(now - last).count();
+    last = now;
+
+    if (rates[0] == 0.0 && rates[1] == 0.0 && rates[2] == 0.0) {
+        accumulator = 0.0;
+        return false;
+    }
+
+    double step = 0.0;
+    if (timestep > 0.0) {
+        accumulator = std::min(accumulator + elapsed, timestep * MAX_STEPS_PER_TICK);
+        const double steps = std::floor(accumulator / timestep);
+        step = steps * timestep;
+        accumulator -= step;
+    }
+    else {
+        step = std::min(elapsed, MAX_ADAPTIVE_STEP);
+    }
+
+    if (step <= 0.0)
+        return false;
+
+    for (int i = 0; i < 3; i++)
+        angles[i] = std::fmod(angles[i] + rates[i] * step, 360.0);
+
+    updateTransform();
+    return true;
+}
+
+vtkTransform* AnimationScheduler::getTransform() const {
+    return transform;
+}
+
+// One combined rotation about the pivot, X then Y then Z as the old per step rotations did
+void AnimationScheduler::updateTransform() {
+    transform->Identity();
+    transform->Translate(-pivot[0], -pivot[1], -pivot[2]);
+    transform->RotateX(angles[0]);
+    transform->RotateY(angles[1]);
+    transform->RotateZ(angles[2]);
+    transform->Translate(pivot[0], pivot[1], pivot[2]);
+}
@@ -0,0 +1,63 @@
+#ifndef VIEWER_ANIMATIONSCHEDULER_H
+#define VIEWER_ANIMATIONSCHEDULER_H
+
+#include <chrono>
+
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+
+/* Turns rotation rates into one scene transform driven by real elapsed time.
+ * Rates are in degrees per second, so the animation runs at the same speed whatever the
+ * frame rate or event loop jitter. With a fixed timestep the angles advance in whole steps
+ * (catching up at most MAX_STEPS_PER_TICK steps per tick), with the adaptive timestep they
+ * advance by exactly the time since the previous tick. The transform rotates about a pivot
+ * and is meant to be shared by the whole scene, e.g. concatenated into the user transform of every actor.
+ */
+class AnimationScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Constructor - no rotation, adaptive timestep, pivot at the origin
+      */
+    AnimationScheduler();
+
+    /** @param x, y, z are the rotation rates about each axis in degrees per second
+      */
+    void setRates(double x, double y, double z);
+    double getRate(int axis) const;
+
+    /** @param seconds is the fixed step length, 0 selects the adaptive timestep
+      */
+    void setTimestep(double seconds);
+
+    /** @param pivot is the point the scene rotates about
+      */
+    void setPivot(const double pivot[3]);
+
+    /** Advance the angles to the given time and update the transform
+      * @param now is the current time, the first call only starts the clock
+      * @return true if the transform changed
+      */
+    bool tick(Clock::time_point now);
+
+    /** @return the scene transform, the same object for the lifetime of the scheduler
+      */
+    vtkTransform* getTransform() const;
+
+    /** Most fixed steps taken in one tick, so a long stall does not cause a burst of steps */
+    static const int MAX_STEPS_PER_TICK = 5;
+
+private:
+    void updateTransform();
+
+    double rates[3] = { 0.0, 0.0, 0.0 };
+    double angles[3] = { 0.0, 0.0, 0.0 };
+    double pivot[3] = { 0.0, 0.0, 0.0 };
+    double timestep = 0.0;
+    double accumulator = 0.0;
+    bool started = false;
+    Clock::time_point last;
+    vtkSmartPointer<vtkTransform> transform;
+};
+
+#endif // VIEWER_ANIMATIONSCHEDULER_H
@@ -0,0 +1,359 @@
+// Header file for this class
+#include "BatchRenderer.h"
+#include "ModelPart.h"
+
+// VTK headers
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkCellData.h>
+#include <vtkDataSetAttributes.h>
+#include <vtkFloatArray.h>
+#include <vtkIntArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkTypeInt32Array.h>
+
+#include <algorithm>
+
+// Constructor
+BatchRenderer::BatchRenderer(vtkRenderer* renderer)
+    : renderer(renderer) {
+}
+
+// Destructor
+BatchRenderer::~BatchRenderer() {
+    clear();
+}
+
+// Enables or disables batching, the caller redraws every mesh afterwards
+void BatchRenderer::setEnabled(bool enabled) {
+    this->enabled = enabled;
+    if (!enabled)
+        clear();
+}
+
+bool BatchRenderer::isEnabled() const {
+    return enabled;
+}
+
+// Parts that left the group are hidden in their batch, new ones join one, the rest only get their colour refreshed
+bool BatchRenderer::setGroup(vtkPolyData* mesh, const QList<ModelPart*>& parts) {
+    const QList<ModelPart*> oldParts = groups.take(mesh);
+    const bool batched = enabled && mesh && !parts.isEmpty() && mesh->GetNumberOfPolys() <= SMALL_PART_TRIANGLES;
+    QSet<ModelPart*> kept;
+    if (batched) {
+        for (ModelPart* part : parts)
+            kept.insert(part);
+    }
+
+    // A part that moved to another mesh may already have been placed by that mesh's group
+    for (ModelPart* part : oldParts) {
+        if (!kept.contains(part) && groupOf.value(part) == mesh) {
+            hidePart(part);
+            groupOf.remove(part);
+        }
+    }
+    if (!batched)
+        return false;
+
+    for (ModelPart* part : parts) {
+        groupOf.insert(part, mesh);
+        Batch* batch = batchOf.value(part, nullptr);
+        if (batch) {
+            auto slot = std::find_if(batch->slots.begin(), batch->slots.end(),
+                                     [part](const Slot& s) { return s.part == part; });
+            const int index = int(slot - batch->slots.begin());
+            // A new shading mode or reloaded geometry needs the mesh merged again
+            if (slot->drawnMesh.GetPointer() != part->getShadedMesh()) {
+                removePart(part);
+                addPart(part);
+            }
+            else {
+                if (!slot->shown)
+                    showSlot(*batch, index);
+                if (!batch->dirty)
+                    setSlotColour(*batch, index);
+            }
+        }
+        else {
+            addPart(part);
+        }
+    }
+
+    groups.insert(mesh, parts);
+    return true;
+}
+
+// Rebuilds the changed batches and drops the ones that became empty or only hold hidden parts
+void BatchRenderer::flush() {
+    for (auto it = batches.begin(); it != batches.end();) {
+        Batch* batch = *it;
+        if (!batch->slots.isEmpty() && batch->hiddenTriangles == batch->triangles) {
+            for (const Slot& slot : batch->slots)
+                batchOf.remove(slot.part);
+            batch->slots.clear();
+        }
+        if (batch->slots.isEmpty()) {
+            if (batch->actor)
+                renderer->RemoveActor(batch->actor);
+            delete batch;
+            it = batches.erase(it);
+            continue;
+        }
+        if (batch->dirty)
+            rebuildBatch(*batch);
+        ++it;
+    }
+}
+
+// Removes every batch actor
+void BatchRenderer::clear() {
+    for (Batch* batch : batches) {
+        if (batch->actor)
+            renderer->RemoveActor(batch->actor);
+    }
+    qDeleteAll(batches);
+    batches.clear();
+    batchOf.clear();
+    groups.clear();
+    groupOf.clear();
+}
+
+int BatchRenderer::batchCount() const {
+    return batches.size();
+}
+
+void BatchRenderer::forgetPart(ModelPart* part) {
+    removePart(part);
+    groupOf.remove(part);
+}
+
+// The batch is rebuilt without the part on the next flush
+void BatchRenderer::removePart(ModelPart* part) {
+    Batch* batch = batchOf.take(part);
+    if (!batch)
+        return;
+
+    for (int i = 0; i < batch->slots.size(); ++i) {
+        if (batch->slots[i].part == part) {
+            batch->triangles -= batch->slots[i].triangles;
+            if (!batch->slots[i].shown)
+                batch->hiddenTriangles -= batch->slots[i].triangles;
+            batch->slots.remove(i);
+            break;
+        }
+    }
+    batch->dirty = true;
+}
+
+// The part keeps its slot, only its triangles stop being drawn
+void BatchRenderer::hidePart(ModelPart* part) {
+    Batch* batch = batchOf.value(part, nullptr);
+    if (!batch)
+        return;
+
+    for (int i = 0; i < batch->slots.size(); ++i) {
+        Slot& slot = batch->slots[i];
+        if (slot.part == part && slot.shown) {
+            slot.shown = false;
+            batch->hiddenTriangles += slot.triangles;
+            maskSlot(*batch, i);
+            break;
+        }
+    }
+}
+
+void BatchRenderer::showSlot(Batch& batch, int slot) {
+    batch.slots[slot].shown = true;
+    batch.hiddenTriangles -= batch.slots[slot].triangles;
+    maskSlot(batch, slot);
+}
+
+// Writes the slot's visibility into the ghost array, a batch waiting to be rebuilt gets it then
+void BatchRenderer::maskSlot(Batch& batch, int slot) {
+    if (batch.dirty || !batch.hiddenCells)
+        return;
+
+    const Slot& entry = batch.slots[slot];
+    const unsigned char flag = entry.shown ? 0 : vtkDataSetAttributes::HIDDENCELL;
+    unsigned char* cells = batch.hiddenCells->GetPointer(entry.firstCell);
+    std::fill(cells, cells + entry.triangles, flag);
+    batch.hiddenCells->Modified();
+}
+
+// Fills the first batch with room and the same shading, so batches stay packed as parts come and go
+void BatchRenderer::addPart(ModelPart* part) {
+    vtkPolyData* drawnMesh = part->getShadedMesh();
+    const vtkIdType triangles = drawnMesh->GetNumberOfPolys();
+    const bool smooth = hasNormals(drawnMesh);
+
+    Batch* target = nullptr;
+    for (Batch* batch : batches) {
+        if (batch->smooth == smooth && batch->triangles + triangles <= MAX_BATCH_TRIANGLES) {
+            target = batch;
+            break;
+        }
+    }
+    if (!target) {
+        target = new Batch;
+        target->smooth = smooth;
+        batches.append(target);
+    }
+
+    Slot slot;
+    slot.part = part;
+    slot.drawnMesh = drawnMesh;
+    slot.triangles = triangles;
+    target->slots.append(slot);
+    target->triangles += triangles;
+    target->dirty = true;
+    batchOf.insert(part, target);
+}
+
+// Merges the slot meshes into assembly coordinates with a part id per triangle and hidden parts masked
+void BatchRenderer::rebuildBatch(Batch& batch) {
+    // Parts whose mesh is gone cannot be merged, hidden ones stay unless they fill half the batch
+    const bool dropHidden = 2 * batch.hiddenTriangles > batch.triangles;
+    for (int i = batch.slots.size() - 1; i >= 0; --i) {
+        const Slot& slot = batch.slots[i];
+        if ((!slot.shown && dropHidden) || !slot.drawnMesh) {
+            batch.triangles -= slot.triangles;
+            if (!slot.shown)
+                batch.hiddenTriangles -= slot.triangles;
+            batchOf.remove(slot.part);
+            batch.slots.remove(i);
+        }
+    }
+
+    vtkIdType pointCount = 0;
+    for (const Slot& slot : batch.slots)
+        pointCount += slot.drawnMesh->GetNumberOfPoints();
+
+    vtkNew<vtkFloatArray> coords;
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(pointCount);
+    vtkNew<vtkFloatArray> normals;
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    if (batch.smooth)
+        normals->SetNumberOfTuples(pointCount);
+
+    vtkNew<vtkTypeInt32Array> connectivity;
+    connectivity->Allocate(3 * batch.triangles);
+    vtkNew<vtkIntArray> partIds;
+    partIds->SetName("PartId");
+    partIds->Allocate(batch.triangles);
+    vtkSmartPointer<vtkUnsignedCharArray> hiddenCells = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    hiddenCells->SetName(vtkDataSetAttributes::GhostArrayName());
+    hiddenCells->Allocate(batch.triangles);
+
+    vtkIdType firstPoint = 0;
+    for (int slotIndex = 0; slotIndex < batch.slots.size(); ++slotIndex) {
+        Slot& slot = batch.slots[slotIndex];
+        vtkPolyData* mesh = slot.drawnMesh;
+        const double* origin = slot.part->getGeometry().origin;
+        const vtkIdType points = mesh->GetNumberOfPoints();
+        const unsigned char flag = slot.shown ? 0 : vtkDataSetAttributes::HIDDENCELL;
+        slot.firstCell = partIds->GetNumberOfValues();
+
+        float* position = coords->GetPointer(3 * firstPoint);
+        double point[3];
+        for (vtkIdType i = 0; i < points; ++i) {
+            mesh->GetPoint(i, point);
+            for (int axis = 0; axis < 3; ++axis)
+                position[3 * i + axis] = float(point[axis] + origin[axis]);
+        }
+        if (batch.smooth) {
+            vtkFloatArray* source = vtkFloatArray::FastDownCast(mesh->GetPointData()->GetNormals());
+            std::copy(source->GetPointer(0), source->GetPointer(0) + 3 * points, normals->GetPointer(3 * firstPoint));
+        }
+
+        // Polygons with more than three corners are split into fans, like everywhere else
+        vtkSmartPointer<vtkCellArrayIterator> cell = vtk::TakeSmartPointer(mesh->GetPolys()->NewIterator());
+        for (cell->GoToFirstCell(); !cell->IsDoneWithTraversal(); cell->GoToNextCell()) {
+            vtkIdType size;
+            const vtkIdType* ids;
+            cell->GetCurrentCell(size, ids);
+            for (vtkIdType i = 2; i < size; ++i) {
+                connectivity->InsertNextValue(vtkTypeInt32(firstPoint + ids[0]));
+                connectivity->InsertNextValue(vtkTypeInt32(firstPoint + ids[i - 1]));
+                connectivity->InsertNextValue(vtkTypeInt32(firstPoint + ids[i]));
+                partIds->InsertNextValue(slotIndex);
+                hiddenCells->InsertNextValue(flag);
+            }
+        }
+        // Fans can give more triangles than the mesh has polygons, the mask covers what was written
+        slot.triangles = partIds->GetNumberOfValues() - slot.firstCell;
+        firstPoint += points;
+    }
+
+    // The slot counts may have changed with the fans, the totals are taken again
+    batch.triangles = 0;
+    batch.hiddenTriangles = 0;
+    for (const Slot& slot : batch.slots) {
+        batch.triangles += slot.triangles;
+        if (!slot.shown)
+            batch.hiddenTriangles += slot.triangles;
+    }
+
+    vtkNew<vtkTypeInt32Array> offsets;
+    offsets->SetNumberOfValues(partIds->GetNumberOfValues() + 1);
+    for (vtkIdType i = 0; i < offsets->GetNumberOfValues(); ++i)
+        offsets->SetValue(i, vtkTypeInt32(3 * i));
+
+    vtkNew<vtkPoints> mergedPoints;
+    mergedPoints->SetData(coords);
+    vtkNew<vtkCellArray> cells;
+    cells->SetData(offsets, connectivity);
+
+    vtkSmartPointer<vtkPolyData> merged = vtkSmartPointer<vtkPolyData>::New();
+    merged->SetPoints(mergedPoints);
+    merged->SetPolys(cells);
+    merged->GetCellData()->AddArray(partIds);
+    merged->GetCellData()->AddArray(hiddenCells);
+    if (batch.smooth)
+        merged->GetPointData()->SetNormals(normals);
+    batch.hiddenCells = hiddenCells;
+
+    // One table entry per slot, centred on the integer ids so every id maps to its own colour
+    const int slotCount = batch.slots.size();
+    batch.colours = vtkSmartPointer<vtkLookupTable>::New();
+    batch.colours->SetNumberOfTableValues(slotCount);
+    batch.colours->SetTableRange(-0.5, slotCount - 0.5);
+    for (int i = 0; i < slotCount; ++i)
+        setSlotColour(batch, i);
+
+    vtkNew<vtkPolyDataMapper> mapper;
+    mapper->SetInputData(merged);
+    mapper->SetLookupTable(batch.colours);
+    mapper->UseLookupTableScalarRangeOn();
+    mapper->SetScalarModeToUseCellFieldData();
+    mapper->SelectColorArray("PartId");
+    mapper->SetColorModeToMapScalars();
+    mapper->ScalarVisibilityOn();
+
+    if (!batch.actor) {
+        batch.actor = vtkSmartPointer<vtkActor>::New();
+        renderer->AddActor(batch.actor);
+    }
+    batch.actor->SetMapper(mapper);
+    batch.dirty = false;
+}
+
+// Only float normals are copied into a batch, like the meshes NormalGenerator builds
+bool BatchRenderer::hasNormals(vtkPolyData* mesh) {
+    return vtkFloatArray::FastDownCast(mesh->GetPointData()->GetNormals()) != nullptr;
+}
+
+// Copies the part's colour into its table entry
+void BatchRenderer::setSlotColour(Batch& batch, int slot) {
+    if (!batch.colours)
+        return;
+
+    const ModelPart* part = batch.slots[slot].part;
+    batch.colours->SetTableValue(slot, part->getColourR() / 255.0, part->getColourG() / 255.0,
+                                 part->getColourB() / 255.0, 1.0);
+    batch.colours->Modified();
+}
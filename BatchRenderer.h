@@ -0,0 +1,118 @@
+#ifndef VIEWER_BATCHRENDERER_H
+#define VIEWER_BATCHRENDERER_H
+
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+#include <vtkActor.h>
+#include <vtkLookupTable.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkUnsignedCharArray.h>
+
+class ModelPart;
+
+/* Draws many small parts through a few merged meshes instead of one actor per part.
+ * Visible parts are packed into batches of up to MAX_BATCH_TRIANGLES, each batch is one mesh in
+ * assembly coordinates with a "PartId" cell array holding the part's slot in the batch, and a
+ * lookup table with one entry per slot gives each part its colour. Parts with point normals
+ * (smooth shading) and parts without are kept in separate batches, otherwise they share every
+ * material setting. A colour change only edits the lookup table. Hiding a part keeps it in its
+ * batch and flags its triangles as hidden cells in the ghost array, which the mapper leaves out,
+ * and showing it again clears the flags. A batch is only merged again when a part joins it, its
+ * geometry changes or it is removed from the tree; hidden parts are then dropped once they make
+ * up half of the batch, or as soon as their mesh is gone. A batch left with only hidden parts is
+ * removed on the next flush.
+ * Parts above SMALL_PART_TRIANGLES keep their own actors, so levels of detail and culling still
+ * apply to them. Picking and the tree work on the parts and are unaffected.
+ */
+class BatchRenderer {
+public:
+    /** Constructor
+      * @param renderer is the renderer the batch actors are added to
+      */
+    explicit BatchRenderer(vtkRenderer* renderer);
+
+    /** Destructor - removes the batch actors
+      */
+    ~BatchRenderer();
+
+    /** Turn batching on or off, when off the caller redraws every mesh with its own actors
+      */
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    /** Set the visible parts of one mesh, replacing the ones given for it before
+      * @param mesh is the shared local frame mesh
+      * @param parts are the visible parts that use the mesh
+      * @return true if the parts are drawn batched, false if they need their own actors
+      */
+    bool setGroup(vtkPolyData* mesh, const QList<ModelPart*>& parts);
+
+    /** Take a part out of its batch for good, call before the part is deleted
+      */
+    void forgetPart(ModelPart* part);
+
+    /** Rebuild the batches changed by setGroup() calls since the last flush
+      */
+    void flush();
+
+    /** Remove every batch actor from the renderer
+      */
+    void clear();
+
+    /** @return the number of batch actors
+      */
+    int batchCount() const;
+
+    /** Parts with more triangles than this keep their own actor */
+    static const vtkIdType SMALL_PART_TRIANGLES = 1 << 14;
+
+    /** Most triangles merged into one batch */
+    static const vtkIdType MAX_BATCH_TRIANGLES = 1 << 18;
+
+private:
+    /* A part in a batch, with the mesh it was merged with so a change of geometry is noticed.
+     * The mesh is weak, a hidden part that released its geometry does not keep it alive
+     */
+    struct Slot {
+        ModelPart* part;
+        vtkWeakPointer<vtkPolyData> drawnMesh;
+        vtkIdType triangles;
+        bool shown = true;
+        vtkIdType firstCell = 0;                        /**< First triangle of the part in the merged mesh */
+    };
+
+    struct Batch {
+        QVector<Slot> slots;
+        vtkIdType triangles = 0;                        /**< Of every slot, shown or hidden */
+        vtkIdType hiddenTriangles = 0;
+        bool smooth = false;                            /**< The slot meshes have point normals */
+        bool dirty = false;
+        vtkSmartPointer<vtkActor> actor;
+        vtkSmartPointer<vtkLookupTable> colours;
+        vtkSmartPointer<vtkUnsignedCharArray> hiddenCells; /**< Ghost array of the merged mesh */
+    };
+
+    void removePart(ModelPart* part);
+    void addPart(ModelPart* part);
+    void hidePart(ModelPart* part);
+    void showSlot(Batch& batch, int slot);
+    void maskSlot(Batch& batch, int slot);
+    void rebuildBatch(Batch& batch);
+    void setSlotColour(Batch& batch, int slot);
+    static bool hasNormals(vtkPolyData* mesh);
+
+    vtkRenderer* renderer;
+    bool enabled = false;
+    QList<Batch*> batches;
+    QHash<ModelPart*, Batch*> batchOf;                  /**< Batch holding each batched part */
+    QHash<vtkPolyData*, QList<ModelPart*>> groups;      /**< Batched parts of each mesh, as given to setGroup */
+    QHash<ModelPart*, vtkPolyData*> groupOf;            /**< Mesh group each batched part was last given in */
+};
+
+#endif // VIEWER_BATCHRENDERER_H
@@ -0,0 +1,234 @@
+// Header file for this class
+#include "Bvh.h"
+
+#include <limits>
+
+namespace {
+
+// Candidate split planes per node along its longest centroid axis
+const int SAH_BINS = 12;
+
+// Nodes with at most this many primitives stay leaves when no split is cheaper than testing them all
+const uint32_t MAX_SAH_LEAF_SIZE = 16;
+
+// Box accumulated from primitive boxes or points
+struct Bounds {
+    float lo[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    float hi[3] = { -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+
+    Bounds() = default;
+
+    explicit Bounds(const float box[6]) {
+        std::copy(box, box + 3, lo);
+        std::copy(box + 3, box + 6, hi);
+    }
+
+    void store(float box[6]) const {
+        std::copy(lo, lo + 3, box);
+        std::copy(hi, hi + 3, box + 3);
+    }
+
+    void grow(const float* boxLo, const float* boxHi) {
+        for (int axis = 0; axis < 3; ++axis) {
+            lo[axis] = std::min(lo[axis], boxLo[axis]);
+            hi[axis] = std::max(hi[axis], boxHi[axis]);
+        }
+    }
+
+    void grow(const Bounds& other) {
+        grow(other.lo, other.hi);
+    }
+
+    // Half the surface area, proportional to the chance a random ray hits the box
+    float halfArea() const {
+        if (lo[0] > hi[0])
+            return 0.0f;
+        const float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        return dx * dy + dy * dz + dz * dx;
+    }
+};
+
+} // namespace
+
+// A primitive's box and id, the build partitions these in place so every pass reads memory in order
+struct Bvh::Reference {
+    float lo[3];
+    float hi[3];
+    uint32_t id;
+
+    float centroid(int axis) const {
+        return 0.5f * (lo[axis] + hi[axis]);
+    }
+};
+
+// Builds the tree top down from the root, which covers every primitive
+void Bvh::build(const std::vector<float>& boxes) {
+    nodes.clear();
+    order.clear();
+
+    const uint32_t count = static_cast<uint32_t>(boxes.size() / 6);
+    if (count == 0)
+        return;
+
+    std::vector<Reference> references(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        std::copy(&boxes[6 * size_t(i)], &boxes[6 * size_t(i)] + 3, references[i].lo);
+        std::copy(&boxes[6 * size_t(i)] + 3, &boxes[6 * size_t(i)] + 6, references[i].hi);
+        references[i].id = i;
+    }
+
+    float bounds[6], centroidBounds[6];
+    measure(references.data(), references.data() + count, bounds, centroidBounds);
+
+    // A binary tree with leaves of a few primitives has fewer nodes than primitives
+    nodes.reserve(count);
+    nodes.push_back(Node());
+    split(0, references.data(), 0, count, 0, bounds, centroidBounds);
+    nodes.shrink_to_fit();
+
+    order.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+        order[i] = references[i].id;
+}
+
+// Box of a range of primitives and box of their centroids
+void Bvh::measure(const Reference* begin, const Reference* end, float bounds[6], float centroidBounds[6]) {
+    Bounds box, centroidBox;
+    for (const Reference* it = begin; it != end; ++it) {
+        box.grow(it->lo, it->hi);
+        const float centroid[3] = { it->centroid(0), it->centroid(1), it->centroid(2) };
+        centroidBox.grow(centroid, centroid);
+    }
+    box.store(bounds);
+    centroidBox.store(centroidBounds);
+}
+
+// Sets a node's box and either makes it a leaf or splits its primitives between two new children.
+// The bins give the boxes of both halves, so a range is only measured again after a median split
+void Bvh::split(uint32_t index, Reference* references, uint32_t first, uint32_t count, int depth,
+                const float nodeBounds[6], const float nodeCentroidBounds[6]) {
+    const Bounds bounds(nodeBounds), centroidBounds(nodeCentroidBounds);
+
+    Node& node = nodes[index];
+    std::copy(bounds.lo, bounds.lo + 3, node.lo);
+    std::copy(bounds.hi, bounds.hi + 3, node.hi);
+    node.first = first;
+    node.count = count;
+
+    if (count <= MAX_LEAF_SIZE)
+        return;
+
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (centroidBounds.hi[a] - centroidBounds.lo[a] > centroidBounds.hi[axis] - centroidBounds.lo[axis])
+            axis = a;
+    }
+    const float extent = centroidBounds.hi[axis] - centroidBounds.lo[axis];
+    // Every centroid in the same place, no plane can separate them
+    if (extent <= 0.0f)
+        return;
+
+    Reference* begin = references + first;
+    Reference* end = begin + count;
+    Reference* middle = nullptr;
+    float childBounds[2][6], childCentroidBounds[2][6];
+
+    if (depth < SAH_MAX_DEPTH) {
+        // Bin the centroids and pick the plane with the lowest surface area cost
+        auto binOf = [&](const Reference& reference) {
+            const int bin = int((reference.centroid(axis) - centroidBounds.lo[axis]) * SAH_BINS / extent);
+            return std::min(bin, SAH_BINS - 1);
+        };
+
+        Bounds binBounds[SAH_BINS], binCentroids[SAH_BINS];
+        uint32_t binCounts[SAH_BINS] = {};
+        for (const Reference* it = begin; it != end; ++it) {
+            const int bin = binOf(*it);
+            binBounds[bin].grow(it->lo, it->hi);
+            const float centroid[3] = { it->centroid(0), it->centroid(1), it->centroid(2) };
+            binCentroids[bin].grow(centroid, centroid);
+            ++binCounts[bin];
+        }
+
+        // Costs of everything right of each plane, swept from the right
+        float rightCost[SAH_BINS];
+        Bounds right;
+        uint32_t rightCount = 0;
+        for (int bin = SAH_BINS - 1; bin > 0; --bin) {
+            right.grow(binBounds[bin]);
+            rightCount += binCounts[bin];
+            rightCost[bin] = right.halfArea() * rightCount;
+        }
+
+        float bestCost = std::numeric_limits<float>::max();
+        int bestPlane = -1;
+        Bounds left;
+        uint32_t leftCount = 0;
+        for (int plane = 1; plane < SAH_BINS; ++plane) {
+            left.grow(binBounds[plane - 1]);
+            leftCount += binCounts[plane - 1];
+            const float cost = left.halfArea() * leftCount + rightCost[plane];
+            if (leftCount > 0 && leftCount < count && cost < bestCost) {
+                bestCost = cost;
+                bestPlane = plane;
+            }
+        }
+
+        // Testing a small node's primitives directly can be cheaper than any split
+        const float leafCost = bounds.halfArea() * count;
+        if (count <= MAX_SAH_LEAF_SIZE && bestCost >= leafCost)
+            return;
+
+        if (bestPlane > 0) {
+            middle = std::partition(begin, end, [&](const Reference& reference) { return binOf(reference) < bestPlane; });
+
+            Bounds halves[2], halfCentroids[2];
+            for (int bin = 0; bin < SAH_BINS; ++bin) {
+                halves[bin >= bestPlane].grow(binBounds[bin]);
+                halfCentroids[bin >= bestPlane].grow(binCentroids[bin]);
+            }
+            for (int half = 0; half < 2; ++half) {
+                halves[half].store(childBounds[half]);
+                halfCentroids[half].store(childCentroidBounds[half]);
+            }
+        }
+    }
+
+    // Deep or unsplittable by the bins: halve by count, which always makes progress
+    if (!middle || middle == begin || middle == end) {
+        middle = begin + count / 2;
+        std::nth_element(begin, middle, end, [axis](const Reference& a, const Reference& b) {
+            return a.centroid(axis) < b.centroid(axis);
+        });
+        measure(begin, middle, childBounds[0], childCentroidBounds[0]);
+        measure(middle, end, childBounds[1], childCentroidBounds[1]);
+    }
+
+    const uint32_t leftChild = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    // push_back may have moved the array, so the node is looked up again
+    nodes[index].first = leftChild;
+    nodes[index].count = 0;
+
+    const uint32_t leftCount = static_cast<uint32_t>(middle - begin);
+    split(leftChild, references, first, leftCount, depth + 1, childBounds[0], childCentroidBounds[0]);
+    split(leftChild + 1, references, first + leftCount, count - leftCount, depth + 1,
+          childBounds[1], childCentroidBounds[1]);
+}
+
+bool Bvh::isEmpty() const {
+    return nodes.empty();
+}
+
+const std::vector<uint32_t>& Bvh::leafOrder() const {
+    return order;
+}
+
+void Bvh::releaseLeafOrder() {
+    std::vector<uint32_t>().swap(order);
+}
+
+size_t Bvh::memoryBytes() const {
+    return nodes.capacity() * sizeof(Node) + order.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,133 @@
+#ifndef VIEWER_BVH_H
+#define VIEWER_BVH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Bounding volume hierarchy over axis aligned boxes, built with a binned surface area heuristic.
+ * It only knows about boxes: the caller builds it from one box per primitive (a triangle, a part)
+ * and tests the primitives of the leaves a ray reaches itself. Nodes are stored in one array with
+ * the two children of a node next to each other, and the leaves refer to a range of leaf
+ * positions, so callers can store their primitives in leaf order for cache friendly traversal.
+ */
+class Bvh {
+public:
+    struct Node {
+        float lo[3];
+        float hi[3];
+        uint32_t first;     /**< Leaf: first leaf position, interior: left child, the right child follows it */
+        uint32_t count;     /**< Primitives in a leaf, 0 for an interior node */
+    };
+
+    /** Leaves are not split below this many primitives */
+    static const uint32_t MAX_LEAF_SIZE = 4;
+
+    /** Build the hierarchy, replacing any previous one
+      * @param boxes holds six floats per primitive, the low corner then the high corner
+      */
+    void build(const std::vector<float>& boxes);
+
+    /** @return true if there is nothing to intersect
+      */
+    bool isEmpty() const;
+
+    /** @return the primitive stored at each leaf position
+      */
+    const std::vector<uint32_t>& leafOrder() const;
+
+    /** Free the leaf order once the caller has stored its primitives in that order
+      */
+    void releaseLeafOrder();
+
+    /** @return the memory held by the nodes and the leaf order in bytes
+      */
+    size_t memoryBytes() const;
+
+    /** Walk the leaves a ray passes through, nearer children first
+      * @param origin, direction define the ray, the direction does not need to be normalised
+      * @param tMax is how far along the ray to look, in units of the direction's length
+      * @param hit is called as hit(leafPosition, tMax) for each primitive of every leaf the ray enters
+      *        before tMax, and lowers tMax when it finds a closer intersection
+      */
+    template <typename Hit>
+    void traverse(const float origin[3], const float direction[3], float& tMax, Hit&& hit) const;
+
+private:
+    /** Depth after which splits are made at the median, which bounds the depth of the tree */
+    static const int SAH_MAX_DEPTH = 40;
+    /** Bounded by SAH_MAX_DEPTH plus a median split per bit of a 32-bit primitive count */
+    static const int MAX_STACK = 128;
+
+    struct Reference;
+
+    static void measure(const Reference* begin, const Reference* end, float bounds[6], float centroidBounds[6]);
+    void split(uint32_t index, Reference* references, uint32_t first, uint32_t count, int depth,
+               const float bounds[6], const float centroidBounds[6]);
+
+    static bool enters(const Node& node, const float origin[3], const float inverse[3], float tMax, float& tEnter);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> order;
+};
+
+// Ray against a node's box with the slab test, tEnter is where the ray enters it
+inline bool Bvh::enters(const Node& node, const float origin[3], const float inverse[3], float tMax, float& tEnter) {
+    float tNear = 0.0f;
+    float tFar = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t0 = (node.lo[axis] - origin[axis]) * inverse[axis];
+        float t1 = (node.hi[axis] - origin[axis]) * inverse[axis];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tNear = t0 > tNear ? t0 : tNear;
+        tFar = t1 < tFar ? t1 : tFar;
+    }
+    tEnter = tNear;
+    return tNear <= tFar;
+}
+
+// Depth first with an explicit stack, the farther child is pushed first so the nearer is visited first
+template <typename Hit>
+void Bvh::traverse(const float origin[3], const float direction[3], float& tMax, Hit&& hit) const {
+    if (nodes.empty())
+        return;
+
+    const float inverse[3] = { 1.0f / direction[0], 1.0f / direction[1], 1.0f / direction[2] };
+
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        float tEnter;
+        // Checked again on the way out of the stack, tMax may have dropped since the push
+        if (!enters(node, origin, inverse, tMax, tEnter))
+            continue;
+
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                hit(i, tMax);
+            continue;
+        }
+
+        float tLeft, tRight;
+        const bool left = enters(nodes[node.first], origin, inverse, tMax, tLeft);
+        const bool right = enters(nodes[node.first + 1], origin, inverse, tMax, tRight);
+        if (left && right) {
+            const bool leftFirst = tLeft <= tRight;
+            stack[top++] = leftFirst ? node.first + 1 : node.first;
+            stack[top++] = leftFirst ? node.first : node.first + 1;
+        }
+        else if (left) {
+            stack[top++] = node.first;
+        }
+        else if (right) {
+            stack[top++] = node.first + 1;
+        }
+    }
+}
+
+#endif // VIEWER_BVH_H
@@ -0,0 +1,298 @@
+// Header file for this class
+#include "CompactMesh.h"
+
+// VTK headers
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkFloatArray.h>
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+inline double signNotZero(double v) {
+    return v < 0.0 ? -1.0 : 1.0;
+}
+
+// Projects a unit vector onto the octahedron |x|+|y|+|z| = 1 and unfolds the lower half onto the square
+void octahedralEncode(const float n[3], double out[2]) {
+    const double sum = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    if (sum == 0.0) {
+        out[0] = out[1] = 0.0;
+        return;
+    }
+
+    const double x = n[0] / sum, y = n[1] / sum;
+    if (n[2] < 0.0f) {
+        out[0] = (1.0 - std::abs(y)) * signNotZero(x);
+        out[1] = (1.0 - std::abs(x)) * signNotZero(y);
+    }
+    else {
+        out[0] = x;
+        out[1] = y;
+    }
+}
+
+// Folds the square back onto the octahedron and normalises
+void octahedralDecode(double u, double v, float out[3]) {
+    double x = u, y = v;
+    const double z = 1.0 - std::abs(u) - std::abs(v);
+    if (z < 0.0) {
+        x = (1.0 - std::abs(v)) * signNotZero(u);
+        y = (1.0 - std::abs(u)) * signNotZero(v);
+    }
+
+    const double length = std::sqrt(x * x + y * y + z * z);
+    out[0] = float(x / length);
+    out[1] = float(y / length);
+    out[2] = float(z / length);
+}
+
+// Grid cell of each coordinate, rounded to the nearest
+template <typename T>
+void quantisePositions(vtkPoints* points, const double lower[3], const double step[3], std::vector<T>& out) {
+    const vtkIdType count = points->GetNumberOfPoints();
+    out.resize(size_t(count) * 3);
+
+    vtkFloatArray* coords = vtkFloatArray::FastDownCast(points->GetData());
+    const double levels = double(std::numeric_limits<T>::max());
+    double p[3];
+    for (vtkIdType i = 0; i < count; ++i) {
+        if (coords) {
+            const float* f = coords->GetPointer(3 * i);
+            p[0] = f[0]; p[1] = f[1]; p[2] = f[2];
+        }
+        else {
+            points->GetPoint(i, p);
+        }
+
+        for (int k = 0; k < 3; ++k) {
+            const double cell = step[k] > 0.0 ? std::round((p[k] - lower[k]) / step[k]) : 0.0;
+            out[size_t(3 * i + k)] = T(std::min(std::max(cell, 0.0), levels));
+        }
+    }
+}
+
+// Each octahedral component in [-1, 1] scaled to the symmetric range of the type
+template <typename T>
+void quantiseNormals(vtkFloatArray* normals, int bits, std::vector<T>& out) {
+    const vtkIdType count = normals->GetNumberOfTuples();
+    out.resize(size_t(count) * 2);
+
+    const double range = double((1 << (bits - 1)) - 1);
+    double folded[2];
+    for (vtkIdType i = 0; i < count; ++i) {
+        octahedralEncode(normals->GetPointer(3 * i), folded);
+        out[size_t(2 * i)] = T(std::round(folded[0] * range));
+        out[size_t(2 * i + 1)] = T(std::round(folded[1] * range));
+    }
+}
+
+template <typename T>
+void decodePositions(const std::vector<T>& in, const double lower[3], const double step[3], float* out) {
+    for (size_t i = 0; i < in.size(); i += 3) {
+        out[i] = float(lower[0] + in[i] * step[0]);
+        out[i + 1] = float(lower[1] + in[i + 1] * step[1]);
+        out[i + 2] = float(lower[2] + in[i + 2] * step[2]);
+    }
+}
+
+template <typename T>
+void decodeNormals(const std::vector<T>& in, int bits, float* out) {
+    const double range = double((1 << (bits - 1)) - 1);
+    for (size_t i = 0; i < in.size() / 2; ++i)
+        octahedralDecode(in[2 * i] / range, in[2 * i + 1] / range, out + 3 * i);
+}
+
+// Copies the corners and builds the matching offsets, as the loaders do
+template <typename ArrayT, typename IndexT>
+void fillTriangles(vtkCellArray* cells, const std::vector<IndexT>& indices) {
+    using ValueType = typename ArrayT::ValueType;
+    const vtkIdType corners = vtkIdType(indices.size());
+
+    vtkNew<ArrayT> connectivity;
+    connectivity->SetNumberOfValues(corners);
+    ValueType* corner = connectivity->GetPointer(0);
+    for (vtkIdType i = 0; i < corners; ++i)
+        corner[i] = static_cast<ValueType>(indices[size_t(i)]);
+
+    vtkNew<ArrayT> offsets;
+    offsets->SetNumberOfValues(corners / 3 + 1);
+    ValueType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= corners / 3; ++i)
+        offset[i] = static_cast<ValueType>(3 * i);
+
+    cells->SetData(offsets, connectivity);
+}
+
+template <typename IndexT>
+void fillTriangles(vtkCellArray* cells, const std::vector<IndexT>& indices) {
+    if (indices.size() <= size_t(std::numeric_limits<vtkTypeInt32>::max()))
+        fillTriangles<vtkTypeInt32Array>(cells, indices);
+    else
+        fillTriangles<vtkTypeInt64Array>(cells, indices);
+}
+
+// Polygons become triangle fans, anything with fewer than three corners is dropped
+template <typename T>
+void encodeTriangles(vtkCellArray* polys, std::vector<T>& out) {
+    out.clear();
+    out.reserve(size_t(polys->GetNumberOfConnectivityIds()));
+
+    vtkSmartPointer<vtkCellArrayIterator> it = vtk::TakeSmartPointer(polys->NewIterator());
+    vtkIdType count;
+    const vtkIdType* ids;
+    for (it->GoToFirstCell(); !it->IsDoneWithTraversal(); it->GoToNextCell()) {
+        it->GetCurrentCell(count, ids);
+        for (vtkIdType i = 2; i < count; ++i) {
+            out.push_back(T(ids[0]));
+            out.push_back(T(ids[i - 1]));
+            out.push_back(T(ids[i]));
+        }
+    }
+}
+
+} // namespace
+
+// Quantises the mesh, then decodes it once to measure what was lost
+std::shared_ptr<const CompactMesh> CompactMesh::encode(vtkPolyData* mesh, const Options& options, const Error& inherited) {
+    if (!mesh || !mesh->GetPoints() || mesh->GetNumberOfPoints() == 0)
+        return nullptr;
+
+    std::shared_ptr<CompactMesh> compact(new CompactMesh());
+    compact->encodedWith.positionBits = std::min(16, std::max(8, options.positionBits));
+    compact->encodedWith.normalBits = std::min(16, std::max(8, options.normalBits));
+    compact->originalBytes = qint64(mesh->GetActualMemorySize()) * 1024;
+    compact->pointCount = size_t(mesh->GetNumberOfPoints());
+
+    // The grid has 2^bits - 1 steps across the bounds on each axis
+    double bounds[6];
+    mesh->GetBounds(bounds);
+    const int positionBits = compact->encodedWith.positionBits;
+    const double steps = double((1 << positionBits) - 1);
+    for (int k = 0; k < 3; ++k) {
+        compact->lower[k] = bounds[2 * k];
+        compact->step[k] = (bounds[2 * k + 1] - bounds[2 * k]) / steps;
+    }
+
+    if (positionBits <= 8)
+        quantisePositions(mesh->GetPoints(), compact->lower, compact->step, compact->positions8);
+    else
+        quantisePositions(mesh->GetPoints(), compact->lower, compact->step, compact->positions16);
+
+    vtkFloatArray* normals = vtkFloatArray::FastDownCast(mesh->GetPointData()->GetNormals());
+    if (normals && normals->GetNumberOfComponents() == 3 && normals->GetNumberOfTuples() == mesh->GetNumberOfPoints()) {
+        if (compact->encodedWith.normalBits <= 8)
+            quantiseNormals(normals, compact->encodedWith.normalBits, compact->normals8);
+        else
+            quantiseNormals(normals, compact->encodedWith.normalBits, compact->normals16);
+    }
+    else {
+        normals = nullptr;
+    }
+
+    if (vtkCellArray* polys = mesh->GetPolys()) {
+        if (compact->pointCount <= 65536)
+            encodeTriangles(polys, compact->indices16);
+        else
+            encodeTriangles(polys, compact->indices32);
+    }
+
+    // Measured rather than derived from the step, so the report is exactly what is drawn
+    vtkSmartPointer<vtkPolyData> decoded = compact->decode();
+    vtkFloatArray* decodedCoords = vtkFloatArray::FastDownCast(decoded->GetPoints()->GetData());
+    vtkFloatArray* decodedNormals = vtkFloatArray::FastDownCast(decoded->GetPointData()->GetNormals());
+    double worstDistance = 0.0;
+    double smallestCosine = 1.0;
+    double p[3];
+    for (vtkIdType i = 0; i < mesh->GetNumberOfPoints(); ++i) {
+        mesh->GetPoints()->GetPoint(i, p);
+        const float* q = decodedCoords->GetPointer(3 * i);
+        const double dx = p[0] - q[0], dy = p[1] - q[1], dz = p[2] - q[2];
+        worstDistance = std::max(worstDistance, dx * dx + dy * dy + dz * dz);
+
+        if (normals && decodedNormals) {
+            const float* a = normals->GetPointer(3 * i);
+            const float* b = decodedNormals->GetPointer(3 * i);
+            const double length = std::sqrt(double(a[0]) * a[0] + double(a[1]) * a[1] + double(a[2]) * a[2]);
+            if (length > 0.0)
+                smallestCosine = std::min(smallestCosine, (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / length);
+        }
+    }
+
+    const double diagonal = std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                                      (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                                      (bounds[5] - bounds[4]) * (bounds[5] - bounds[4]));
+    // Errors of a mesh that was itself decoded add up, the sum bounds the distance to the original
+    compact->maxError.position = inherited.position + std::sqrt(worstDistance);
+    compact->maxError.relative = diagonal > 0.0 ? compact->maxError.position / diagonal : 0.0;
+    compact->maxError.normalDegrees =
+        inherited.normalDegrees + std::acos(std::min(1.0, std::max(-1.0, smallestCosine))) * 180.0 / PI;
+
+    return compact;
+}
+
+// Float points on the grid, 32 or 64 bit cells depending on the corner count, and normals if stored
+vtkSmartPointer<vtkPolyData> CompactMesh::decode() const {
+    vtkNew<vtkFloatArray> coords;
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(vtkIdType(pointCount));
+    if (!positions8.empty())
+        decodePositions(positions8, lower, step, coords->GetPointer(0));
+    else
+        decodePositions(positions16, lower, step, coords->GetPointer(0));
+
+    vtkNew<vtkPoints> points;
+    points->SetData(coords);
+
+    vtkNew<vtkCellArray> cells;
+    if (!indices32.empty())
+        fillTriangles(cells, indices32);
+    else
+        fillTriangles(cells, indices16);
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(points);
+    mesh->SetPolys(cells);
+
+    if (!normals8.empty() || !normals16.empty()) {
+        vtkNew<vtkFloatArray> normals;
+        normals->SetName("Normals");
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(vtkIdType(pointCount));
+        if (!normals8.empty())
+            decodeNormals(normals8, encodedWith.normalBits, normals->GetPointer(0));
+        else
+            decodeNormals(normals16, encodedWith.normalBits, normals->GetPointer(0));
+        mesh->GetPointData()->SetNormals(normals);
+    }
+
+    return mesh;
+}
+
+qint64 CompactMesh::bytes() const {
+    return qint64(sizeof(CompactMesh) + positions8.capacity() + positions16.capacity() * sizeof(uint16_t) +
+                  normals8.capacity() + normals16.capacity() * sizeof(int16_t) +
+                  indices16.capacity() * sizeof(uint16_t) + indices32.capacity() * sizeof(uint32_t));
+}
+
+qint64 CompactMesh::sourceBytes() const {
+    return originalBytes;
+}
+
+const CompactMesh::Error& CompactMesh::error() const {
+    return maxError;
+}
+
+const CompactMesh::Options& CompactMesh::options() const {
+    return encodedWith;
+}
@@ -0,0 +1,91 @@
+#ifndef VIEWER_COMPACTMESH_H
+#define VIEWER_COMPACTMESH_H
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+/* Lossy, compact copy of a triangle mesh for parts that are kept in memory but not drawn.
+ * Positions are stored as integers on a grid spanning the mesh bounds, point normals (when the
+ * mesh has them) are folded onto an octahedron and stored as two signed integers, and the
+ * triangle corners use 16 bit indices when the mesh has few enough points. A 16 bit copy of a
+ * float mesh takes about half its memory. VTK only draws and picks float arrays, so the copy
+ * is decoded back into a normal mesh before the part is shown again.
+ */
+class CompactMesh {
+public:
+    /** Precision of the stored values, 9 to 16 bits are kept in 16 bit integers and fewer in 8 bit ones */
+    struct Options {
+        int positionBits = 16;      /**< Bits per coordinate, 8 to 16 */
+        int normalBits = 16;        /**< Bits per octahedral component, 8 to 16 */
+    };
+
+    /** Largest difference between the decoded mesh and the original */
+    struct Error {
+        double position = 0.0;      /**< Distance between a decoded point and its original, model units */
+        double relative = 0.0;      /**< position divided by the diagonal of the mesh bounds */
+        double normalDegrees = 0.0; /**< Angle between a decoded normal and its original */
+    };
+
+    /** Encode a mesh, safe to call from worker threads
+      * @param mesh is a polygon mesh with float or double points, polygons are split into triangle fans
+      * @param options sets the precision
+      * @param inherited is how far mesh already is from the original, when it was decoded from another copy
+      * @return the compact copy, null if the mesh has no points
+      */
+    static std::shared_ptr<const CompactMesh> encode(vtkPolyData* mesh, const Options& options,
+                                                     const Error& inherited = Error());
+
+    /** Build a float mesh from the compact copy, safe to call from worker threads
+      * @return a triangle mesh with the original point order and, if it had them, point normals
+      */
+    vtkSmartPointer<vtkPolyData> decode() const;
+
+    /** @return the memory held by the compact copy in bytes
+      */
+    qint64 bytes() const;
+
+    /** @return the memory the original mesh held when it was encoded in bytes
+      */
+    qint64 sourceBytes() const;
+
+    /** @return how far the decoded mesh is from the original
+      */
+    const Error& error() const;
+
+    /** @return the precision the copy was encoded with
+      */
+    const Options& options() const;
+
+private:
+    CompactMesh() = default;
+
+    Options encodedWith;
+    Error maxError;
+    qint64 originalBytes = 0;
+
+    size_t pointCount = 0;
+    double lower[3] = { 0.0, 0.0, 0.0 };        /**< Grid origin, the minimum of the bounds */
+    double step[3] = { 0.0, 0.0, 0.0 };         /**< Grid spacing along each axis */
+
+    // Only one array of each pair is filled, depending on the number of bits or points
+    std::vector<uint8_t> positions8;
+    std::vector<uint16_t> positions16;
+    std::vector<int8_t> normals8;
+    std::vector<int16_t> normals16;
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+};
+
+/* Compact copy of a part's local frame mesh, origin places it in the assembly like PartGeometry::origin */
+struct CompactGeometry {
+    std::shared_ptr<const CompactMesh> mesh;    /**< Shared by every part whose mesh was shared when it was encoded */
+    double origin[3] = { 0.0, 0.0, 0.0 };
+};
+
+#endif // VIEWER_COMPACTMESH_H
@@ -0,0 +1,44 @@
+#ifndef VIEWER_CONTENTHASH_H
+#define VIEWER_CONTENTHASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/** Fast non-cryptographic 64 bit hash of a block of memory. It consumes 8 bytes per step so
+  *  it can run over whole meshes and files at close to memory bandwidth.
+  * @param data is the start of the block
+  * @param bytes is the length of the block
+  * @param seed allows several blocks to be chained, pass the previous result
+  * @return the hash value
+  */
+inline uint64_t contentHash64(const void* data, size_t bytes, uint64_t seed = 0) {
+    const uint64_t prime = 0x9E3779B97F4A7C15ull;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (static_cast<uint64_t>(bytes) * prime);
+
+    while (bytes >= 8) {
+        uint64_t word;
+        std::memcpy(&word, p, 8);
+        word *= 0xFF51AFD7ED558CCDull;
+        word ^= word >> 33;
+        h ^= word;
+        h = ((h << 27) | (h >> 37)) * prime + 0x52DCE729u;
+        p += 8;
+        bytes -= 8;
+    }
+
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, bytes);
+    h ^= tail * 0xC4CEB9FE1A85EC53ull;
+
+    // Final avalanche so nearby inputs spread over the whole range
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+#endif // VIEWER_CONTENTHASH_H
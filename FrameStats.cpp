@@ -0,0 +1,245 @@
+// Header file for this class
+#include "FrameStats.h"
+#include "LoadProfiler.h"
+
+// Q includes
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+// VTK headers
+#include <vtkActor.h>
+#include <vtkAssemblyNode.h>
+#include <vtkAssemblyPath.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkPolyData.h>
+#include <vtkPropCollection.h>
+
+#include <algorithm>
+
+namespace {
+
+// Milliseconds between two LoadProfiler timestamps
+float elapsedMs(qint64 fromNs, qint64 toNs) {
+    return float(toNs - fromNs) / 1.0e6f;
+}
+
+// Triangles one actor submits, a glyph mapper draws its source once per input point
+qint64 trianglesOf(vtkActor* actor) {
+    vtkMapper* mapper = actor->GetMapper();
+    if (!mapper)
+        return 0;
+
+    if (vtkGlyph3DMapper* glyphs = vtkGlyph3DMapper::SafeDownCast(mapper)) {
+        vtkPolyData* source = glyphs->GetSource(0);
+        vtkDataSet* instances = glyphs->GetInput();
+        if (!source || !instances)
+            return 0;
+        return qint64(source->GetNumberOfPolys()) * instances->GetNumberOfPoints();
+    }
+
+    vtkPolyData* mesh = vtkPolyData::SafeDownCast(mapper->GetInputDataObject(0, 0));
+    return mesh ? qint64(mesh->GetNumberOfPolys()) : 0;
+}
+
+// Trace event shared by the frame and its phases
+QJsonObject completeEvent(const char* name, qint64 startNs, float durationMs, int pid) {
+    QJsonObject event;
+    event["name"] = name;
+    event["cat"] = "frame";
+    event["ph"] = "X";
+    event["ts"] = startNs / 1000.0;
+    event["dur"] = durationMs * 1000.0;
+    event["pid"] = pid;
+    event["tid"] = 1;
+    return event;
+}
+
+} // namespace
+
+// Constructor - the ring is allocated once so recording never allocates
+FrameStats::FrameStats(const QString& name)
+    : name(name), ring(CAPACITY) {
+}
+
+// Overwrites the oldest frame once the ring is full
+void FrameStats::record(const Frame& frame) {
+    QMutexLocker lock(&mutex);
+    ring[next] = frame;
+    next = (next + 1) % CAPACITY;
+    count = std::min(count + 1, CAPACITY);
+}
+
+// Copies the frames out in the order they were recorded
+QVector<FrameStats::Frame> FrameStats::frames() const {
+    QMutexLocker lock(&mutex);
+    QVector<Frame> ordered;
+    ordered.reserve(count);
+    for (int i = 0; i < count; ++i)
+        ordered.append(ring[(next - count + i + CAPACITY) % CAPACITY]);
+    return ordered;
+}
+
+// Forgets every frame, the ring keeps its memory
+void FrameStats::clear() {
+    QMutexLocker lock(&mutex);
+    next = 0;
+    count = 0;
+}
+
+// Averages and maxima of the most recent frames, the counts are from the latest one. Reads the
+// ring in place, it runs every frame while the overlay is shown
+QString FrameStats::summary(int lastFrames) const {
+    QMutexLocker lock(&mutex);
+    const int n = std::min(lastFrames, count);
+    if (n == 0)
+        return QString("%1: no frames yet").arg(name);
+
+    double cpuSum = 0, renderSum = 0, eventSum = 0;
+    float cpuMax = 0, renderMax = 0;
+    for (int i = 0; i < n; ++i) {
+        const Frame& frame = ring[(next - 1 - i + CAPACITY) % CAPACITY];
+        cpuSum += frame.cpuMs;
+        renderSum += frame.renderMs;
+        eventSum += frame.eventMs;
+        cpuMax = std::max(cpuMax, frame.cpuMs);
+        renderMax = std::max(renderMax, frame.renderMs);
+    }
+
+    const Frame& latest = ring[(next - 1 + CAPACITY) % CAPACITY];
+    return QString("%1 frame %2 ms (max %3)  render %4 ms (max %5)  events %6 ms  %7 actors  %8 k triangles")
+        .arg(name)
+        .arg(cpuSum / n, 0, 'f', 1).arg(cpuMax, 0, 'f', 1)
+        .arg(renderSum / n, 0, 'f', 1).arg(renderMax, 0, 'f', 1)
+        .arg(eventSum / n, 0, 'f', 1)
+        .arg(latest.actors)
+        .arg(latest.triangles / 1000.0, 0, 'f', 1);
+}
+
+// One frame event per frame with its two phases nested inside, plus a counter track for the scene size
+void FrameStats::appendTraceEvents(QJsonArray& events, int pid) const {
+    QJsonObject process;
+    process["name"] = "process_name";
+    process["ph"] = "M";
+    process["pid"] = pid;
+    process["args"] = QJsonObject{ { "name", name } };
+    events.append(process);
+
+    for (const Frame& frame : frames()) {
+        QJsonObject whole = completeEvent("Frame", frame.startNs, frame.cpuMs, pid);
+        whole["args"] = QJsonObject{ { "intervalMs", frame.intervalMs } };
+        events.append(whole);
+
+        events.append(completeEvent("Events", frame.startNs, frame.eventMs, pid));
+
+        const qint64 renderStartNs = frame.startNs + qint64(double(frame.eventMs) * 1.0e6);
+        events.append(completeEvent("Render", renderStartNs, frame.renderMs, pid));
+
+        QJsonObject counter;
+        counter["name"] = "Scene";
+        counter["ph"] = "C";
+        counter["ts"] = frame.startNs / 1000.0;
+        counter["pid"] = pid;
+        counter["args"] = QJsonObject{ { "actors", frame.actors }, { "triangles", double(frame.triangles) } };
+        events.append(counter);
+    }
+}
+
+// Visible actors, including the parts of visible assemblies, and the triangles they draw
+void FrameStats::countDrawn(vtkRenderer* renderer, int& actors, qint64& triangles) {
+    actors = 0;
+    triangles = 0;
+
+    vtkPropCollection* props = renderer->GetViewProps();
+    vtkCollectionSimpleIterator it;
+    props->InitTraversal(it);
+    while (vtkProp* prop = props->GetNextProp(it)) {
+        if (!prop->GetVisibility())
+            continue;
+
+        prop->InitPathTraversal();
+        while (vtkAssemblyPath* path = prop->GetNextPath()) {
+            vtkActor* actor = vtkActor::SafeDownCast(path->GetLastNode()->GetViewProp());
+            if (!actor || !actor->GetVisibility())
+                continue;
+            ++actors;
+            triangles += trianglesOf(actor);
+        }
+    }
+}
+
+// Load events are process 1, the collectors follow in the order given
+bool FrameStats::writeChromeTrace(const QString& path, const QList<const FrameStats*>& sources) {
+    QJsonArray events = LoadProfiler::instance().traceEvents();
+    for (int i = 0; i < sources.size(); ++i)
+        sources[i]->appendTraceEvents(events, i + 2);
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = "ms";
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+// Constructor - observes the start and end of every render of the window
+FrameRecorder::FrameRecorder(vtkRenderWindow* window, vtkRenderer* renderer, FrameStats* stats)
+    : window(window), renderer(renderer), stats(stats) {
+    startCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+    startCallback->SetCallback(&FrameRecorder::onStartRender);
+    startCallback->SetClientData(this);
+    startTag = window->AddObserver(vtkCommand::StartEvent, startCallback);
+
+    endCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+    endCallback->SetCallback(&FrameRecorder::onEndRender);
+    endCallback->SetClientData(this);
+    endTag = window->AddObserver(vtkCommand::EndEvent, endCallback);
+}
+
+// Destructor
+FrameRecorder::~FrameRecorder() {
+    window->RemoveObserver(startTag);
+    window->RemoveObserver(endTag);
+}
+
+// Remembers when the loop started on the next frame
+void FrameRecorder::markFrameStart() {
+    frameStart = LoadProfiler::instance().now();
+}
+
+// Sets what is told about each recorded frame
+void FrameRecorder::setFrameCallback(std::function<void(const FrameStats::Frame&)> callback) {
+    frameCallback = std::move(callback);
+}
+
+// The render is about to start
+void FrameRecorder::onStartRender(vtkObject*, unsigned long, void* clientData, void*) {
+    FrameRecorder* self = static_cast<FrameRecorder*>(clientData);
+    self->renderStart = LoadProfiler::instance().now();
+}
+
+// The render has finished, a frame without a mark counts from the start of its render
+void FrameRecorder::onEndRender(vtkObject*, unsigned long, void* clientData, void*) {
+    FrameRecorder* self = static_cast<FrameRecorder*>(clientData);
+    const qint64 end = LoadProfiler::instance().now();
+    const qint64 start = self->frameStart >= 0 ? std::min(self->frameStart, self->renderStart) : self->renderStart;
+
+    FrameStats::Frame frame;
+    frame.startNs = start;
+    frame.intervalMs = self->lastFrameStart >= 0 ? elapsedMs(self->lastFrameStart, start) : 0.0f;
+    frame.eventMs = elapsedMs(start, self->renderStart);
+    frame.renderMs = elapsedMs(self->renderStart, end);
+    frame.cpuMs = elapsedMs(start, end);
+    FrameStats::countDrawn(self->renderer, frame.actors, frame.triangles);
+
+    self->stats->record(frame);
+    self->lastFrameStart = start;
+    self->frameStart = -1;
+
+    if (self->frameCallback)
+        self->frameCallback(frame);
+}
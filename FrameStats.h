@@ -0,0 +1,133 @@
+#ifndef VIEWER_FRAMESTATS_H
+#define VIEWER_FRAMESTATS_H
+
+#include <QJsonArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+#include <vtkSmartPointer.h>
+#include <vtkCallbackCommand.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+
+/* Keeps the timings of the most recent frames of one render loop in a fixed size ring.
+ * Frames are stamped with the LoadProfiler time base, so a trace written from them lines up
+ * with the load events and hitches can be matched to the loads or edits that caused them.
+ * One collector is used per render loop, it is written by that loop's thread and can be read
+ * from any thread.
+ */
+class FrameStats {
+public:
+    /* Timings of one frame, all durations are wall time on the rendering thread */
+    struct Frame {
+        qint64 startNs = 0;         /**< When the work for the frame started, LoadProfiler::now() base */
+        float intervalMs = 0;       /**< Since the start of the previous frame */
+        float cpuMs = 0;            /**< Events plus render */
+        float eventMs = 0;          /**< Handling input, scene edits and updates before the render */
+        float renderMs = 0;         /**< The render window's Render(), including the buffer swap */
+        int actors = 0;             /**< Visible actors drawn */
+        qint64 triangles = 0;       /**< Triangles submitted, instanced copies and the current level of detail included */
+    };
+
+    /** Number of frames kept, older frames are overwritten */
+    static const int CAPACITY = 4096;
+
+    /** Constructor
+      * @param name is the render loop the frames belong to, it names the trace process
+      */
+    explicit FrameStats(const QString& name);
+
+    /** Add a finished frame, overwriting the oldest one when the ring is full
+      */
+    void record(const Frame& frame);
+
+    /** @return the frames held, oldest first
+      */
+    QVector<Frame> frames() const;
+
+    /** Forget every frame
+      */
+    void clear();
+
+    /** @param lastFrames is how many of the most recent frames to summarise
+      * @return one line of averages and maxima, as shown by the desktop overlay
+      */
+    QString summary(int lastFrames = 120) const;
+
+    /** Append the frames as Chrome trace-event objects
+      * @param events receives one frame event with its event and render phases per frame
+      * @param pid is the trace process the frames are shown under
+      */
+    void appendTraceEvents(QJsonArray& events, int pid) const;
+
+    /** Count what a renderer draws, walking into assemblies
+      * @param actors is set to the number of visible actors
+      * @param triangles is set to the number of triangles they submit
+      */
+    static void countDrawn(vtkRenderer* renderer, int& actors, qint64& triangles);
+
+    /** Write the load events and the frames of each collector as one Chrome trace
+      * @param path is the file to write
+      * @param sources are the collectors, each becomes its own trace process
+      * @return false if the file could not be written
+      */
+    static bool writeChromeTrace(const QString& path, const QList<const FrameStats*>& sources);
+
+private:
+    QString name;
+    mutable QMutex mutex;
+    QVector<Frame> ring;        /**< Guarded by mutex */
+    int next = 0;               /**< Slot the next frame goes in, guarded by mutex */
+    int count = 0;              /**< Frames held, guarded by mutex */
+};
+
+/* Times the frames of one render window into a FrameStats.
+ * The render is timed by observing the window's start and end events. Event handling is the
+ * time from markFrameStart(), called by the loop when it starts working on a frame, to the start
+ * of the render. Observers run on the rendering thread, so the recorder must be created, marked
+ * and destroyed on that thread.
+ */
+class FrameRecorder {
+public:
+    /** Constructor
+      * @param window is observed for the start and end of each render
+      * @param renderer is counted for actors and triangles after each render
+      * @param stats receives the frames, it must outlive the recorder
+      */
+    FrameRecorder(vtkRenderWindow* window, vtkRenderer* renderer, FrameStats* stats);
+
+    /** Destructor - removes the observers
+      */
+    ~FrameRecorder();
+
+    /** Note that the loop started working on the next frame, the latest mark before a render counts
+      */
+    void markFrameStart();
+
+    /** @param callback is called on the rendering thread after each frame has been recorded
+      */
+    void setFrameCallback(std::function<void(const FrameStats::Frame&)> callback);
+
+private:
+    static void onStartRender(vtkObject* caller, unsigned long eventId, void* clientData, void* callData);
+    static void onEndRender(vtkObject* caller, unsigned long eventId, void* clientData, void* callData);
+
+    vtkRenderWindow* window;
+    vtkRenderer* renderer;
+    FrameStats* stats;
+    vtkSmartPointer<vtkCallbackCommand> startCallback;
+    vtkSmartPointer<vtkCallbackCommand> endCallback;
+    unsigned long startTag = 0;
+    unsigned long endTag = 0;
+    std::function<void(const FrameStats::Frame&)> frameCallback;
+
+    qint64 frameStart = -1;         /**< Latest mark, -1 if none since the last frame */
+    qint64 renderStart = 0;
+    qint64 lastFrameStart = -1;
+};
+
+#endif // VIEWER_FRAMESTATS_H
@@ -0,0 +1,468 @@
+// Header file for this class
+#include "GeometryCache.h"
+#include "ContentHash.h"
+#include "MappedSTLReader.h"
+
+// Q includes
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// VTK headers
+#include <vtkNew.h>
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+const char MAGIC[8] = { 'S', 'T', 'L', 'C', 'A', 'C', 'H', 'E' };
+
+// Fixed header at the start of every entry, arrays follow at 16 byte aligned offsets
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t weldMode;
+    double weldTolerance;
+    uint64_t fileSize;          // size of the STL file
+    int64_t fileModified;       // modification time of the STL file, ms since epoch
+    uint64_t fileHash;          // contentHash64 of the STL file
+    uint64_t pointCount;
+    uint64_t triangleCount;
+    double origin[3];           // position of the local frame in the assembly
+    uint64_t pathOffset;        // UTF-8 absolute path of the STL file
+    uint64_t pathBytes;
+    uint64_t pointsOffset;      // pointCount x 3 float
+    uint64_t indicesOffset;     // triangleCount x 3 uint32
+    uint64_t normalsOffset;     // pointCount x 3 float, 0 when not stored
+    double smoothFeatureAngle;  // feature angle the smooth shading mesh was split with, in degrees
+    uint64_t smoothPointCount;  // vertices of the smooth shading mesh, it has triangleCount triangles
+    uint64_t smoothPointsOffset;    // smoothPointCount x 3 float, 0 when not stored
+    uint64_t smoothIndicesOffset;   // triangleCount x 3 uint32
+    uint64_t smoothNormalsOffset;   // smoothPointCount x 3 float
+    uint64_t optimisedOrder;    // 1 when the triangles and vertices were reordered by MeshOptimizer
+    uint64_t reserved[2];
+};
+static_assert(sizeof(CacheHeader) == 192, "stlcache header layout changed, bump FORMAT_VERSION");
+
+// True if bytes at offset lie inside a block of the given size, written so the sum cannot wrap
+bool fits(uint64_t offset, uint64_t bytes, uint64_t size) {
+    return offset <= size && bytes <= size - offset;
+}
+
+// True if every corner index refers to one of pointCount points
+bool indicesInRange(const uchar* indices, uint64_t cornerCount, uint64_t pointCount) {
+    uint32_t largest = 0;
+    for (uint64_t i = 0; i < cornerCount; ++i) {
+        uint32_t index;
+        std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(index));
+        largest = std::max(largest, index);
+    }
+    return cornerCount == 0 || largest < pointCount;
+}
+
+uint64_t align16(uint64_t offset) {
+    return (offset + 15) & ~uint64_t(15);
+}
+
+// Triangle cells from a block of uint32 corner indices
+template <typename ArrayT>
+void fillTriangleCells(vtkCellArray* cells, const uchar* indices, vtkIdType triangles) {
+    using ValueType = typename ArrayT::ValueType;
+
+    vtkNew<ArrayT> connectivity;
+    connectivity->SetNumberOfValues(3 * triangles);
+    ValueType* corner = connectivity->GetPointer(0);
+    if (sizeof(ValueType) == sizeof(uint32_t)) {
+        std::memcpy(corner, indices, size_t(3 * triangles) * sizeof(uint32_t));
+    }
+    else {
+        for (vtkIdType i = 0; i < 3 * triangles; ++i) {
+            uint32_t index;
+            std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(index));
+            corner[i] = static_cast<ValueType>(index);
+        }
+    }
+
+    vtkNew<ArrayT> offsets;
+    offsets->SetNumberOfValues(triangles + 1);
+    ValueType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangles; ++i)
+        offset[i] = static_cast<ValueType>(3 * i);
+
+    cells->SetData(offsets, connectivity);
+}
+
+// Writes zero bytes up to the next 16 byte boundary
+void pad(QSaveFile& out) {
+    static const char zeros[16] = {};
+    const qint64 position = out.pos();
+    out.write(zeros, align16(position) - position);
+}
+
+// Checks that an entry belongs to the file and options and that its arrays lie inside it.
+// The modification time is left to the caller
+bool checkEntry(const uchar* data, uint64_t entrySize, const QFileInfo& info, const MeshWelder::Options& weldOptions,
+                CacheHeader& header) {
+    if (entrySize < sizeof(CacheHeader))
+        return false;
+    std::memcpy(&header, data, sizeof(header));
+
+    // Layout checks, anything inconsistent is treated as a miss and rebuilt. The counts are
+    // capped before any size is computed from them so the products cannot overflow
+    if (header.pointCount > uint64_t(std::numeric_limits<uint32_t>::max())
+        || header.smoothPointCount > uint64_t(std::numeric_limits<uint32_t>::max())
+        || header.triangleCount > entrySize / (3 * sizeof(uint32_t)))
+        return false;
+
+    const uint64_t pointBytes = header.pointCount * 3 * sizeof(float);
+    const uint64_t indexBytes = header.triangleCount * 3 * sizeof(uint32_t);
+    const uint64_t smoothPointBytes = header.smoothPointCount * 3 * sizeof(float);
+    const QByteArray path = info.absoluteFilePath().toUtf8();
+    return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+        && header.version == GeometryCache::FORMAT_VERSION
+        && header.weldMode == uint32_t(weldOptions.mode)
+        && (weldOptions.mode != MeshWelder::Mode::Tolerance || header.weldTolerance == weldOptions.tolerance)
+        && header.optimisedOrder == uint64_t(weldOptions.optimiseOrder)
+        && fits(header.pathOffset, header.pathBytes, entrySize)
+        && fits(header.pointsOffset, pointBytes, entrySize)
+        && fits(header.indicesOffset, indexBytes, entrySize)
+        && (header.normalsOffset == 0 || fits(header.normalsOffset, pointBytes, entrySize))
+        && (header.smoothPointsOffset == 0 || (fits(header.smoothPointsOffset, smoothPointBytes, entrySize)
+                                               && fits(header.smoothIndicesOffset, indexBytes, entrySize)
+                                               && fits(header.smoothNormalsOffset, smoothPointBytes, entrySize)))
+        && header.pathBytes == uint64_t(path.size())
+        && std::memcmp(data + header.pathOffset, path.constData(), size_t(path.size())) == 0
+        && header.fileSize == uint64_t(info.size());
+}
+
+// Triangle mesh from a block of float positions and a block of uint32 corner indices,
+// null if an index points past the positions
+vtkSmartPointer<vtkPolyData> meshFromArrays(const uchar* positions, uint64_t pointCount,
+                                            const uchar* indices, uint64_t triangleCount) {
+    if (!indicesInRange(indices, 3 * triangleCount, pointCount))
+        return nullptr;
+
+    vtkNew<vtkFloatArray> coords;
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(vtkIdType(pointCount));
+    std::memcpy(coords->GetPointer(0), positions, size_t(pointCount * 3 * sizeof(float)));
+
+    vtkNew<vtkPoints> points;
+    points->SetData(coords);
+
+    vtkNew<vtkCellArray> cells;
+    const vtkIdType triangles = vtkIdType(triangleCount);
+    if (3 * triangles <= std::numeric_limits<vtkTypeInt32>::max())
+        fillTriangleCells<vtkTypeInt32Array>(cells, indices, triangles);
+    else
+        fillTriangleCells<vtkTypeInt64Array>(cells, indices, triangles);
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    mesh->SetPoints(points);
+    mesh->SetPolys(cells);
+    return mesh;
+}
+
+// Point normals named as VTK expects them, from a block of floats
+void attachNormals(vtkPolyData* mesh, const uchar* normals) {
+    vtkNew<vtkFloatArray> array;
+    array->SetName("Normals");
+    array->SetNumberOfComponents(3);
+    array->SetNumberOfTuples(mesh->GetNumberOfPoints());
+    std::memcpy(array->GetPointer(0), normals, size_t(mesh->GetNumberOfPoints()) * 3 * sizeof(float));
+    mesh->GetPointData()->SetNormals(array);
+}
+
+// Indices are always stored as uint32, 64 bit connectivity is converted in blocks
+void writeIndices(QSaveFile& out, vtkDataArray* connectivity) {
+    const vtkIdType corners = connectivity->GetNumberOfValues();
+    if (vtkTypeInt32Array* corners32 = vtkTypeInt32Array::FastDownCast(connectivity)) {
+        out.write(reinterpret_cast<const char*>(corners32->GetPointer(0)), qint64(corners * sizeof(uint32_t)));
+        return;
+    }
+
+    std::vector<uint32_t> block;
+    const vtkIdType blockSize = 1 << 16;
+    for (vtkIdType first = 0; first < corners; first += blockSize) {
+        const vtkIdType count = std::min(blockSize, corners - first);
+        block.resize(size_t(count));
+        for (vtkIdType i = 0; i < count; ++i)
+            block[size_t(i)] = uint32_t(connectivity->GetComponent(first + i, 0));
+        out.write(reinterpret_cast<const char*>(block.data()), qint64(count * sizeof(uint32_t)));
+    }
+}
+
+} // namespace
+
+// Constructor
+GeometryCache::GeometryCache(const QString& directory)
+    : directory(directory) {
+}
+
+// Prefers a cache folder shipped inside the repository
+QString GeometryCache::directoryFor(const QString& repositoryPath) {
+    QDir repository(repositoryPath);
+    if (repository.exists(".stlcache"))
+        return repository.absoluteFilePath(".stlcache");
+    return userDirectory();
+}
+
+// Returns <user cache location>/stlcache
+QString GeometryCache::userDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/stlcache";
+}
+
+// Entries are named after a hash of the absolute STL path and the weld settings, so every setting
+// keeps an entry of its own and switching back finds the one written before
+QString GeometryCache::entryPath(const QString& filePath, const MeshWelder::Options& weldOptions) const {
+    QByteArray name = QFileInfo(filePath).absoluteFilePath().toUtf8();
+    name += '\0';
+    name += QByteArray::number(int(weldOptions.mode));
+    if (weldOptions.mode == MeshWelder::Mode::Tolerance)
+        name += ':' + QByteArray::number(weldOptions.tolerance, 'g', 17);
+    if (weldOptions.optimiseOrder)
+        name += ":optimised";
+    const uint64_t key = contentHash64(name.constData(), size_t(name.size()));
+    return directory + "/" + QString::number(key, 16).rightJustified(16, '0') + ".stlcache";
+}
+
+// Validates an entry and copies its arrays into a new polydata
+PartGeometry GeometryCache::load(const QString& filePath, const MeshWelder::Options& weldOptions) const {
+    PartGeometry geometry;
+    if (directory.isEmpty())
+        return geometry;
+
+    const QFileInfo info(filePath);
+    if (!info.exists())
+        return geometry;
+
+    QFile entry(entryPath(filePath, weldOptions));
+    if (!entry.open(QIODevice::ReadOnly) || entry.size() < qint64(sizeof(CacheHeader)))
+        return geometry;
+
+    const uint64_t entrySize = uint64_t(entry.size());
+    uchar* data = entry.map(0, entry.size());
+    if (!data)
+        return geometry;
+
+    CacheHeader header;
+    bool valid = checkEntry(data, entrySize, info, weldOptions, header);
+
+    // Size matches but the time changed: still valid if the content is the same
+    const int64_t modified = info.lastModified().toMSecsSinceEpoch();
+    bool touched = false;
+    if (valid && header.fileModified != modified) {
+        valid = MappedSTLReader::hashFile(filePath) == header.fileHash;
+        touched = valid;
+    }
+
+    if (!valid) {
+        entry.unmap(data);
+        return geometry;
+    }
+
+    geometry.polyData = meshFromArrays(data + header.pointsOffset, header.pointCount,
+                                       data + header.indicesOffset, header.triangleCount);
+    if (!geometry.polyData) {
+        entry.unmap(data);
+        return geometry;
+    }
+    if (header.normalsOffset != 0)
+        attachNormals(geometry.polyData, data + header.normalsOffset);
+
+    geometry.origin[0] = header.origin[0];
+    geometry.origin[1] = header.origin[1];
+    geometry.origin[2] = header.origin[2];
+
+    entry.unmap(data);
+    entry.close();
+
+    // Record the new time so the hash is not needed next time
+    if (touched && entry.open(QIODevice::ReadWrite)) {
+        entry.seek(offsetof(CacheHeader, fileModified));
+        entry.write(reinterpret_cast<const char*>(&modified), sizeof(modified));
+    }
+
+    return geometry;
+}
+
+// Only the stat is taken here, the hash comes from whoever reads the file
+GeometryCache::FileStamp GeometryCache::stamp(const QString& filePath) {
+    const QFileInfo info(filePath);
+    FileStamp stamp;
+    stamp.size = uint64_t(info.size());
+    stamp.modified = info.lastModified().toMSecsSinceEpoch();
+    return stamp;
+}
+
+// Writes the header, path and arrays through a QSaveFile so readers never see a partial entry.
+// The file is not looked at again, a change after the stamp was taken leaves the entry out of date
+void GeometryCache::store(const QString& filePath, const MeshWelder::Options& weldOptions, const FileStamp& file,
+                          const PartGeometry& geometry) const {
+    vtkPolyData* mesh = geometry.polyData;
+    if (directory.isEmpty() || !mesh || !mesh->GetPoints() || !mesh->GetPolys())
+        return;
+
+    vtkFloatArray* coords = vtkFloatArray::FastDownCast(mesh->GetPoints()->GetData());
+    vtkDataArray* connectivity = mesh->GetPolys()->GetConnectivityArray();
+    if (!coords || !connectivity || mesh->GetPolys()->IsHomogeneous() != 3)
+        return;
+
+    vtkFloatArray* normals = vtkFloatArray::FastDownCast(mesh->GetPointData()->GetNormals());
+    if (normals && normals->GetNumberOfComponents() != 3)
+        normals = nullptr;
+
+    const QFileInfo info(filePath);
+    const QByteArray path = info.absoluteFilePath().toUtf8();
+
+    CacheHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.weldMode = uint32_t(weldOptions.mode);
+    header.weldTolerance = weldOptions.tolerance;
+    header.optimisedOrder = uint64_t(weldOptions.optimiseOrder);
+    header.fileSize = file.size;
+    header.fileModified = file.modified;
+    header.fileHash = file.hash;
+    header.pointCount = uint64_t(mesh->GetNumberOfPoints());
+    header.triangleCount = uint64_t(mesh->GetNumberOfPolys());
+    header.origin[0] = geometry.origin[0];
+    header.origin[1] = geometry.origin[1];
+    header.origin[2] = geometry.origin[2];
+
+    const uint64_t pointBytes = header.pointCount * 3 * sizeof(float);
+    header.pathOffset = sizeof(CacheHeader);
+    header.pathBytes = uint64_t(path.size());
+    header.pointsOffset = align16(header.pathOffset + header.pathBytes);
+    header.indicesOffset = align16(header.pointsOffset + pointBytes);
+    if (normals)
+        header.normalsOffset = align16(header.indicesOffset + header.triangleCount * 3 * sizeof(uint32_t));
+
+    QDir().mkpath(directory);
+    QSaveFile out(entryPath(filePath, weldOptions));
+    if (!out.open(QIODevice::WriteOnly))
+        return;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(path);
+    pad(out);
+    out.write(reinterpret_cast<const char*>(coords->GetPointer(0)), qint64(pointBytes));
+    pad(out);
+
+    writeIndices(out, connectivity);
+
+    if (normals) {
+        pad(out);
+        out.write(reinterpret_cast<const char*>(normals->GetPointer(0)), qint64(pointBytes));
+    }
+
+    out.commit();
+}
+
+// The smooth mesh is only read from an entry that load() has already accepted for the file as it is now
+vtkSmartPointer<vtkPolyData> GeometryCache::loadSmooth(const QString& filePath, const MeshWelder::Options& weldOptions,
+                                                       double featureAngle) const {
+    if (directory.isEmpty())
+        return nullptr;
+
+    const QFileInfo info(filePath);
+    QFile entry(entryPath(filePath, weldOptions));
+    if (!info.exists() || !entry.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    uchar* data = entry.map(0, entry.size());
+    if (!data)
+        return nullptr;
+
+    CacheHeader header;
+    vtkSmartPointer<vtkPolyData> smooth;
+    if (checkEntry(data, uint64_t(entry.size()), info, weldOptions, header)
+        && header.fileModified == info.lastModified().toMSecsSinceEpoch()
+        && header.smoothPointsOffset != 0
+        && header.smoothFeatureAngle == featureAngle) {
+        smooth = meshFromArrays(data + header.smoothPointsOffset, header.smoothPointCount,
+                                data + header.smoothIndicesOffset, header.triangleCount);
+        if (smooth)
+            attachNormals(smooth, data + header.smoothNormalsOffset);
+    }
+
+    entry.unmap(data);
+    return smooth;
+}
+
+// Copies the flat part of the entry and appends the smooth arrays, any older smooth mesh is dropped
+void GeometryCache::storeSmooth(const QString& filePath, const MeshWelder::Options& weldOptions, double featureAngle,
+                                vtkPolyData* smooth) const {
+    if (directory.isEmpty() || !smooth || !smooth->GetPoints() || !smooth->GetPolys())
+        return;
+
+    vtkFloatArray* coords = vtkFloatArray::FastDownCast(smooth->GetPoints()->GetData());
+    vtkFloatArray* normals = vtkFloatArray::FastDownCast(smooth->GetPointData()->GetNormals());
+    vtkDataArray* connectivity = smooth->GetPolys()->GetConnectivityArray();
+    if (!coords || !normals || normals->GetNumberOfComponents() != 3 || !connectivity ||
+        smooth->GetPolys()->IsHomogeneous() != 3)
+        return;
+
+    const QFileInfo info(filePath);
+    QFile entry(entryPath(filePath, weldOptions));
+    if (!info.exists() || !entry.open(QIODevice::ReadOnly))
+        return;
+    const QByteArray existing = entry.readAll();
+    entry.close();
+
+    CacheHeader header;
+    const uchar* data = reinterpret_cast<const uchar*>(existing.constData());
+    if (!checkEntry(data, uint64_t(existing.size()), info, weldOptions, header)
+        || header.fileModified != info.lastModified().toMSecsSinceEpoch()
+        || header.triangleCount != uint64_t(smooth->GetNumberOfPolys()))
+        return;
+
+    // The flat arrays end with the indices or, when stored, the flat normals
+    const uint64_t pointBytes = header.pointCount * 3 * sizeof(float);
+    uint64_t flatEnd = header.indicesOffset + header.triangleCount * 3 * sizeof(uint32_t);
+    if (header.normalsOffset != 0)
+        flatEnd = std::max(flatEnd, header.normalsOffset + pointBytes);
+
+    const uint64_t smoothPointBytes = uint64_t(smooth->GetNumberOfPoints()) * 3 * sizeof(float);
+    header.smoothFeatureAngle = featureAngle;
+    header.smoothPointCount = uint64_t(smooth->GetNumberOfPoints());
+    header.smoothPointsOffset = align16(flatEnd);
+    header.smoothIndicesOffset = align16(header.smoothPointsOffset + smoothPointBytes);
+    header.smoothNormalsOffset = align16(header.smoothIndicesOffset + header.triangleCount * 3 * sizeof(uint32_t));
+
+    QSaveFile out(entry.fileName());
+    if (!out.open(QIODevice::WriteOnly))
+        return;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(existing.constData() + sizeof(header), qint64(flatEnd - sizeof(header)));
+    pad(out);
+    out.write(reinterpret_cast<const char*>(coords->GetPointer(0)), qint64(smoothPointBytes));
+    pad(out);
+    writeIndices(out, connectivity);
+    pad(out);
+    out.write(reinterpret_cast<const char*>(normals->GetPointer(0)), qint64(smoothPointBytes));
+
+    out.commit();
+}
+
+// Removes every .stlcache file in the directory
+void GeometryCache::clear() const {
+    QDir dir(directory);
+    const QStringList entries = dir.entryList(QStringList() << "*.stlcache", QDir::Files);
+    for (const QString& name : entries)
+        dir.remove(name);
+}
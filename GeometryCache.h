@@ -0,0 +1,99 @@
+#ifndef VIEWER_GEOMETRYCACHE_H
+#define VIEWER_GEOMETRYCACHE_H
+
+#include <QString>
+
+#include "GeometryRegistry.h"
+#include "MeshWelder.h"
+
+#include <cstdint>
+
+/* On disk cache of preprocessed part geometry (.stlcache files).
+ * Every STL file gets one entry per weld setting holding its welded local frame mesh (in the GPU
+ * friendly order when the weld options ask for it), origin and any derived per vertex data, such
+ * as the smooth shading mesh, laid out as flat aligned arrays after a fixed header so an entry can
+ * be memory mapped and copied straight into VTK arrays. An entry is valid while the STL file keeps
+ * its path, size and modification time; if only the time changed the file content hash is
+ * compared instead, so touching or re-checking out a repository does not invalidate it.
+ * All methods are const and safe to call from the loader threads.
+ */
+class GeometryCache {
+public:
+    /** Constructor
+      * @param directory is where the .stlcache files live, it is created on first store
+      */
+    explicit GeometryCache(const QString& directory = QString());
+
+    /** Pick the cache directory for a repository. A ".stlcache" folder inside the repository is
+      *  used if it exists (so a cache can be shipped with the data), otherwise the user cache directory.
+      * @param repositoryPath is the folder being opened
+      * @return the cache directory
+      */
+    static QString directoryFor(const QString& repositoryPath);
+
+    /** @return the user level cache directory
+      */
+    static QString userDirectory();
+
+    /* The STL file as it was when an entry's geometry was read from it */
+    struct FileStamp {
+        uint64_t size = 0;
+        int64_t modified = 0;       /**< ms since epoch */
+        uint64_t hash = 0;          /**< contentHash64 of the whole file */
+    };
+
+    /** Take the size and modification time of a file, before it is read
+      * @param filePath is the STL file
+      * @return the stamp, its hash is left for the reader to fill in from the bytes it read
+      */
+    static FileStamp stamp(const QString& filePath);
+
+    /** Look up a file
+      * @param filePath is the STL file
+      * @param weldOptions must match the options the entry was built with
+      * @return the local frame mesh and origin (not yet interned), polyData is null on a miss
+      */
+    PartGeometry load(const QString& filePath, const MeshWelder::Options& weldOptions) const;
+
+    /** Write or replace the entry for a file
+      * @param filePath is the STL file the geometry was read from
+      * @param weldOptions are the options the geometry was built with
+      * @param file is the stamp of the file taken before it was read, with the hash of the bytes read
+      * @param geometry is the local frame mesh and origin
+      */
+    void store(const QString& filePath, const MeshWelder::Options& weldOptions, const FileStamp& file,
+               const PartGeometry& geometry) const;
+
+    /** Look up the smooth shading mesh stored with a file's entry
+      * @param filePath is the STL file
+      * @param weldOptions must match the options the entry was built with
+      * @param featureAngle must match the angle the mesh was split with, in degrees
+      * @return the local frame mesh with point normals, null on a miss
+      */
+    vtkSmartPointer<vtkPolyData> loadSmooth(const QString& filePath, const MeshWelder::Options& weldOptions,
+                                            double featureAngle) const;
+
+    /** Add a smooth shading mesh to a file's entry, replacing any stored before. Nothing is
+      *  written unless the entry is up to date with the file.
+      * @param filePath is the STL file the flat mesh was read from
+      * @param weldOptions are the options the entry was built with
+      * @param featureAngle is the angle the mesh was split with, in degrees
+      * @param smooth is the local frame triangle mesh with float point normals
+      */
+    void storeSmooth(const QString& filePath, const MeshWelder::Options& weldOptions, double featureAngle,
+                     vtkPolyData* smooth) const;
+
+    /** Delete every entry in the cache directory
+      */
+    void clear() const;
+
+    /** Bump this when the layout of an entry changes, older entries are then ignored */
+    static const uint32_t FORMAT_VERSION = 5;
+
+private:
+    QString entryPath(const QString& filePath, const MeshWelder::Options& weldOptions) const;
+
+    QString directory;
+};
+
+#endif // VIEWER_GEOMETRYCACHE_H
@@ -0,0 +1,169 @@
+// Header file for this class
+#include "GeometryCompactor.h"
+#include "ModelPart.h"
+
+#include <algorithm>
+
+namespace {
+
+bool sameOptions(const CompactMesh::Options& a, const CompactMesh::Options& b) {
+    return a.positionBits == b.positionBits && a.normalBits == b.normalBits;
+}
+
+} // namespace
+
+// Constructor
+GeometryCompactor::GeometryCompactor(QObject* parent)
+    : QObject(parent), jobs(this) {
+}
+
+// Destructor - the jobs wait for any copy that is still being encoded
+GeometryCompactor::~GeometryCompactor() {
+}
+
+void GeometryCompactor::setEnabled(bool enabled) {
+    this->enabled = enabled;
+}
+
+bool GeometryCompactor::isEnabled() const {
+    return enabled;
+}
+
+// Copies of another precision are not mixed with the new ones, they would be reused otherwise
+void GeometryCompactor::setOptions(const CompactMesh::Options& options) {
+    encodeOptions = options;
+    encoded.clearResults();
+}
+
+CompactMesh::Options GeometryCompactor::options() const {
+    return encodeOptions;
+}
+
+// Queues a mesh for encoding, or reuses the copy already made of it
+void GeometryCompactor::request(ModelPart* part) {
+    vtkPolyData* mesh = part->getGeometry().polyData;
+    if (!enabled || !mesh || mesh->GetNumberOfPoints() == 0)
+        return;
+
+    // A mesh decoded from a copy goes back to that copy, its error is measured against the original
+    const std::shared_ptr<const CompactMesh> held = part->getCompactGeometry().mesh;
+    if (held && sameOptions(held->options(), encodeOptions)) {
+        encoded.insert(mesh, held);
+        if (compactPart(part, mesh, held))
+            emit compacted({ part });
+        return;
+    }
+
+    if (const std::weak_ptr<const CompactMesh>* done = encoded.find(mesh)) {
+        if (const std::shared_ptr<const CompactMesh> compact = done->lock()) {
+            if (compactPart(part, mesh, compact))
+                emit compacted({ part });
+            return;
+        }
+    }
+
+    if (encoded.waitingFor(mesh).contains(part) || !encoded.addWaiting(mesh, part))
+        return;
+
+    // A copy of another precision cannot be reused, the new one carries its error on top
+    vtkSmartPointer<vtkPolyData> source = mesh;
+    const CompactMesh::Options options = encodeOptions;
+    const CompactMesh::Error inherited = held ? held->error() : CompactMesh::Error();
+    jobs.start([source, options, inherited]() { return CompactMesh::encode(source, options, inherited); },
+               [this, source](const std::shared_ptr<const CompactMesh>& compact) { assignCompact(source, compact); });
+}
+
+// The part may still be in a waiting list, it is taken out of every one
+void GeometryCompactor::remove(ModelPart* part) {
+    encoded.removeWaiting(part);
+    compactedParts.remove(part);
+}
+
+// Drops every request, jobs already running finish but their output is ignored
+void GeometryCompactor::clear() {
+    jobs.cancel();
+    encoded.clear();
+    compactedParts.clear();
+}
+
+// Parts lose their copy when they get geometry again, unless it was decoded from the copy
+void GeometryCompactor::prune() {
+    for (auto it = compactedParts.begin(); it != compactedParts.end();) {
+        if (!(*it)->getCompactGeometry().mesh)
+            it = compactedParts.erase(it);
+        else
+            ++it;
+    }
+
+    encoded.prune([](const std::weak_ptr<const CompactMesh>& compact) { return compact.expired(); });
+}
+
+// Copies kept by parts shown again are held too
+qint64 GeometryCompactor::totalBytes() const {
+    qint64 bytes = 0;
+    QSet<const CompactMesh*> counted;
+    for (ModelPart* part : compactedParts) {
+        const CompactMesh* compact = part->getCompactGeometry().mesh.get();
+        if (!compact || counted.contains(compact))
+            continue;
+        counted.insert(compact);
+        bytes += compact->bytes();
+    }
+    return bytes;
+}
+
+// Every distinct copy counts once, however many parts share it. Only parts that released their float
+// mesh for it are reported, the others save nothing
+GeometryCompactor::Report GeometryCompactor::report() const {
+    Report report;
+    QSet<const CompactMesh*> counted;
+    for (ModelPart* part : compactedParts) {
+        const CompactMesh* compact = part->getCompactGeometry().mesh.get();
+        if (!compact || part->getGeometry().polyData || counted.contains(compact))
+            continue;
+        counted.insert(compact);
+
+        ++report.meshes;
+        report.sourceBytes += compact->sourceBytes();
+        report.compactBytes += compact->bytes();
+        report.error.position = std::max(report.error.position, compact->error().position);
+        report.error.relative = std::max(report.error.relative, compact->error().relative);
+        report.error.normalDegrees = std::max(report.error.normalDegrees, compact->error().normalDegrees);
+    }
+    return report;
+}
+
+// Gives the finished copy to every part that still waits for it
+void GeometryCompactor::assignCompact(vtkPolyData* mesh, const std::shared_ptr<const CompactMesh>& compact) {
+    const QList<ModelPart*> parts = encoded.takeWaiting(mesh);
+    if (!compact)
+        return;
+
+    QList<ModelPart*> done;
+    for (ModelPart* part : parts) {
+        if (compactPart(part, mesh, compact))
+            done.append(part);
+    }
+
+    // Parts sharing the mesh that are hidden later take the same copy
+    if (!done.isEmpty()) {
+        encoded.insert(mesh, compact);
+        emit compacted(done);
+    }
+}
+
+// Parts that were shown, reloaded or released while the copy was made are left alone
+bool GeometryCompactor::compactPart(ModelPart* part, vtkPolyData* mesh, const std::shared_ptr<const CompactMesh>& compact) {
+    const PartGeometry& geometry = part->getGeometry();
+    if (part->visible() || part->getLoadState() != ModelPart::LoadState::Loaded || geometry.polyData != mesh)
+        return false;
+
+    CompactGeometry copy;
+    copy.mesh = compact;
+    std::copy(geometry.origin, geometry.origin + 3, copy.origin);
+
+    part->setCompactGeometry(copy);
+    part->releaseGeometry();
+    compactedParts.insert(part);
+    return true;
+}
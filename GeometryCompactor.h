@@ -0,0 +1,100 @@
+#ifndef VIEWER_GEOMETRYCOMPACTOR_H
+#define VIEWER_GEOMETRYCOMPACTOR_H
+
+#include <QObject>
+#include <QList>
+#include <QSet>
+
+#include <memory>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include "CompactMesh.h"
+#include "MeshJobs.h"
+
+class ModelPart;
+
+/* Swaps the float meshes of hidden parts for compact copies on the shared background pool.
+ * Each distinct mesh is encoded once and the copy is shared by every part that used it. When
+ * the copy is ready, parts that are still hidden and still on that mesh keep it and release
+ * their float geometry. When the part is shown again PartLoader takes the exact mesh from the disk
+ * cache, or decodes the copy if the cache has none, so neither drawing nor picking ever sees the
+ * compact form. A decoded part keeps its copy and goes back to it when hidden, so a mesh is never
+ * encoded from a decode of itself at the same precision.
+ */
+class GeometryCompactor : public QObject {
+    Q_OBJECT
+
+public:
+    /** Memory and precision of every compact copy currently held by a part */
+    struct Report {
+        int meshes = 0;                 /**< Distinct compact meshes */
+        qint64 sourceBytes = 0;         /**< Memory of the float meshes they replaced */
+        qint64 compactBytes = 0;        /**< Memory of the compact meshes */
+        CompactMesh::Error error;       /**< Largest error over all of them */
+    };
+
+    /** Constructor
+      * @param parent is used by the QObject constructor
+      */
+    explicit GeometryCompactor(QObject* parent = nullptr);
+
+    /** Destructor - abandons queued jobs and waits for running ones
+      */
+    ~GeometryCompactor();
+
+    /** Turn compaction on or off, parts already compacted keep their copy
+      */
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    /** Set the precision of copies encoded after this call, copies already made are reused
+      *  until their parts are loaded again
+      */
+    void setOptions(const CompactMesh::Options& options);
+    CompactMesh::Options options() const;
+
+    /** Queue a part for compaction, does nothing while disabled or for parts without a mesh
+      * @param part is a loaded part, it must stay alive until compacted, remove() or clear()
+      */
+    void request(ModelPart* part);
+
+    /** Forget a part that is about to be deleted
+      */
+    void remove(ModelPart* part);
+
+    /** Forget every pending request and compacted part, call before the parts are deleted
+      */
+    void clear();
+
+    /** Forget parts that were loaded again and copies whose meshes are gone
+      */
+    void prune();
+
+    /** @return the memory held by the compact copies of every compacted part in bytes
+      */
+    qint64 totalBytes() const;
+
+    /** @return the memory saved and the precision lost by the compact copies held now
+      */
+    Report report() const;
+
+signals:
+    /** Emitted on the GUI thread once some parts have released their float geometry */
+    void compacted(const QList<ModelPart*>& parts);
+
+private:
+    void assignCompact(vtkPolyData* mesh, const std::shared_ptr<const CompactMesh>& compact);
+    bool compactPart(ModelPart* part, vtkPolyData* mesh, const std::shared_ptr<const CompactMesh>& compact);
+
+    MeshJobs jobs;
+    bool enabled = false;
+    CompactMesh::Options encodeOptions;
+
+    /* Copy of each mesh, weak like the mesh so it does not outlive the parts using it */
+    MeshResults<std::weak_ptr<const CompactMesh>> encoded;
+    QSet<ModelPart*> compactedParts;
+};
+
+#endif // VIEWER_GEOMETRYCOMPACTOR_H
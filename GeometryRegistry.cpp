@@ -0,0 +1,232 @@
+// Header file for this class
+#include "GeometryRegistry.h"
+#include "ContentHash.h"
+
+// Q includes
+#include <QList>
+#include <QMutexLocker>
+
+// VTK headers
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Meshes whose local coordinates differ by less than this fraction of their size are identical
+const double MATCH_TOLERANCE = 1.0e-5;
+
+// Connectivity of the triangles, hashed and compared byte for byte
+vtkDataArray* connectivityOf(vtkPolyData* mesh) {
+    return mesh->GetPolys() ? mesh->GetPolys()->GetConnectivityArray() : nullptr;
+}
+
+// Hash of the point count and connectivity, never 0 so 0 can mean "not registered"
+uint64_t topologyHash(vtkPolyData* mesh) {
+    const vtkIdType points = mesh->GetNumberOfPoints();
+    uint64_t h = contentHash64(&points, sizeof(points));
+
+    vtkDataArray* connectivity = connectivityOf(mesh);
+    if (connectivity && connectivity->GetNumberOfValues() > 0)
+        h = contentHash64(connectivity->GetVoidPointer(0),
+                          size_t(connectivity->GetNumberOfValues()) * connectivity->GetDataTypeSize(), h);
+
+    return h | 1;
+}
+
+// Same topology and every local point within tolerance
+bool sameGeometry(vtkPolyData* a, vtkPolyData* b, double tolerance) {
+    if (a->GetNumberOfPoints() != b->GetNumberOfPoints() || a->GetNumberOfPolys() != b->GetNumberOfPolys())
+        return false;
+
+    vtkDataArray* ca = connectivityOf(a);
+    vtkDataArray* cb = connectivityOf(b);
+    if (!ca || !cb || ca->GetDataType() != cb->GetDataType() || ca->GetNumberOfValues() != cb->GetNumberOfValues())
+        return false;
+    if (ca->GetNumberOfValues() > 0 &&
+        std::memcmp(ca->GetVoidPointer(0), cb->GetVoidPointer(0), size_t(ca->GetNumberOfValues()) * ca->GetDataTypeSize()) != 0)
+        return false;
+
+    vtkFloatArray* pa = vtkFloatArray::FastDownCast(a->GetPoints()->GetData());
+    vtkFloatArray* pb = vtkFloatArray::FastDownCast(b->GetPoints()->GetData());
+    if (pa && pb) {
+        const float* x = pa->GetPointer(0);
+        const float* y = pb->GetPointer(0);
+        const vtkIdType values = 3 * a->GetNumberOfPoints();
+        for (vtkIdType i = 0; i < values; ++i) {
+            if (std::fabs(double(x[i]) - double(y[i])) > tolerance)
+                return false;
+        }
+        return true;
+    }
+
+    for (vtkIdType i = 0; i < a->GetNumberOfPoints(); ++i) {
+        double x[3], y[3];
+        a->GetPoint(i, x);
+        b->GetPoint(i, y);
+        if (std::fabs(x[0] - y[0]) > tolerance || std::fabs(x[1] - y[1]) > tolerance || std::fabs(x[2] - y[2]) > tolerance)
+            return false;
+    }
+    return true;
+}
+
+// Shifts every point so the bounding box minimum sits at the origin
+void translateToOrigin(vtkPolyData* mesh, const double origin[3]) {
+    vtkPoints* points = mesh->GetPoints();
+    vtkFloatArray* coords = vtkFloatArray::FastDownCast(points->GetData());
+
+    if (coords) {
+        float* p = coords->GetPointer(0);
+        const vtkIdType count = points->GetNumberOfPoints();
+        for (vtkIdType i = 0; i < count; ++i, p += 3) {
+            p[0] = static_cast<float>(p[0] - origin[0]);
+            p[1] = static_cast<float>(p[1] - origin[1]);
+            p[2] = static_cast<float>(p[2] - origin[2]);
+        }
+    }
+    else {
+        for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i) {
+            double p[3];
+            points->GetPoint(i, p);
+            points->SetPoint(i, p[0] - origin[0], p[1] - origin[1], p[2] - origin[2]);
+        }
+    }
+
+    points->Modified();
+    mesh->Modified();
+}
+
+} // namespace
+
+// Returns the application wide registry
+GeometryRegistry& GeometryRegistry::instance() {
+    static GeometryRegistry registry;
+    return registry;
+}
+
+// Localises the mesh, then shares it with an existing identical mesh or registers it as new
+PartGeometry GeometryRegistry::intern(vtkPolyData* world) {
+    if (!world || world->GetNumberOfPoints() == 0) {
+        PartGeometry geometry;
+        geometry.polyData = world;
+        return geometry;
+    }
+
+    double bounds[6];
+    world->GetBounds(bounds);
+    const double origin[3] = { bounds[0], bounds[2], bounds[4] };
+
+    translateToOrigin(world, origin);
+    return internLocal(world, origin);
+}
+
+// Shares a local frame mesh with an existing identical mesh or registers it as new
+PartGeometry GeometryRegistry::internLocal(vtkPolyData* local, const double origin[3]) {
+    PartGeometry geometry;
+    geometry.polyData = local;
+    if (!local || local->GetNumberOfPoints() == 0)
+        return geometry;
+
+    geometry.origin[0] = origin[0];
+    geometry.origin[1] = origin[1];
+    geometry.origin[2] = origin[2];
+
+    /* Copies of a part at different positions differ by float rounding of their assembly
+     * coordinates, so the tolerance grows with the distance from the assembly origin
+     */
+    double bounds[6];
+    local->GetBounds(bounds);
+    const double diagonal = std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                                      (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                                      (bounds[5] - bounds[4]) * (bounds[5] - bounds[4]));
+    double magnitude = 0.0;
+    for (int i = 0; i < 6; ++i)
+        magnitude = std::max(magnitude, std::fabs(bounds[i] + origin[i / 2]));
+    const double tolerance = diagonal * MATCH_TOLERANCE + 4.0 * FLT_EPSILON * magnitude;
+
+    const uint64_t hash = topologyHash(local);
+    geometry.contentHash = hash;
+
+    // Compare against candidates outside the lock, other loader threads keep running meanwhile
+    QList<vtkSmartPointer<vtkPolyData>> candidates;
+    {
+        QMutexLocker lock(&mutex);
+        for (auto it = entries.find(hash); it != entries.end() && it.key() == hash; ++it)
+            candidates.append(it->polyData);
+    }
+
+    vtkSmartPointer<vtkPolyData> match;
+    for (const vtkSmartPointer<vtkPolyData>& candidate : candidates) {
+        if (sameGeometry(candidate, local, tolerance)) {
+            match = candidate;
+            break;
+        }
+    }
+
+    QMutexLocker lock(&mutex);
+    if (match) {
+        geometry.polyData = match;
+        for (auto it = entries.find(hash); it != entries.end() && it.key() == hash; ++it) {
+            if (it->polyData == match) {
+                ++it->users;
+                return geometry;
+            }
+        }
+        // The match was released while we compared, register it again
+    }
+
+    Entry entry;
+    entry.polyData = geometry.polyData;
+    entry.users = 1;
+    entries.insert(hash, entry);
+    return geometry;
+}
+
+// Drops a user of a shared mesh
+void GeometryRegistry::release(const PartGeometry& geometry) {
+    if (geometry.contentHash == 0)
+        return;
+
+    QMutexLocker lock(&mutex);
+    for (auto it = entries.find(geometry.contentHash); it != entries.end() && it.key() == geometry.contentHash; ++it) {
+        if (it->polyData == geometry.polyData) {
+            if (--it->users == 0)
+                entries.erase(it);
+            return;
+        }
+    }
+}
+
+// Returns the number of distinct meshes
+int GeometryRegistry::uniqueCount() {
+    QMutexLocker lock(&mutex);
+    return entries.size();
+}
+
+// Number of parts holding the same shared mesh
+int GeometryRegistry::userCount(const PartGeometry& geometry) {
+    if (geometry.contentHash == 0)
+        return 1;
+
+    QMutexLocker lock(&mutex);
+    for (auto it = entries.find(geometry.contentHash); it != entries.end() && it.key() == geometry.contentHash; ++it) {
+        if (it->polyData == geometry.polyData)
+            return it->users;
+    }
+    return 1;
+}
+
+// Sum of the actual memory size of every distinct mesh, VTK reports it in KiB
+qint64 GeometryRegistry::totalBytes() {
+    QMutexLocker lock(&mutex);
+    qint64 bytes = 0;
+    for (const Entry& entry : entries)
+        bytes += qint64(entry.polyData->GetActualMemorySize()) * 1024;
+    return bytes;
+}
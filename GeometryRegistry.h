@@ -0,0 +1,77 @@
+#ifndef VIEWER_GEOMETRYREGISTRY_H
+#define VIEWER_GEOMETRYREGISTRY_H
+
+#include <QMutex>
+#include <QMultiHash>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <cstdint>
+
+/* Geometry of one part. The mesh is stored in a local frame with its bounding box minimum at
+ * the origin so that identical parts placed at different positions can share it, origin holds
+ * the translation back into the assembly.
+ */
+struct PartGeometry {
+    vtkSmartPointer<vtkPolyData> polyData;  /**< Local frame mesh, possibly shared with other parts */
+    double origin[3] = { 0.0, 0.0, 0.0 };   /**< Position of the local frame in the assembly */
+    uint64_t contentHash = 0;               /**< Key of the shared mesh, 0 if it is not registered */
+};
+
+/* Keeps one copy of every distinct mesh that is loaded. Meshes are keyed on a hash of their
+ * topology (connectivity and point count), which is identical for repeated CAD instances, and
+ * a candidate is only shared once its local coordinates have been compared within a small
+ * tolerance. It is used from the loader threads, so every call is guarded by a mutex.
+ */
+class GeometryRegistry {
+public:
+    /** @return the registry shared by every part in the application
+      */
+    static GeometryRegistry& instance();
+
+    /** Move freshly loaded geometry into its local frame and swap it for an identical mesh
+      *  that is already loaded, if there is one. The returned mesh must be handed back with
+      *  release() when the part no longer uses it.
+      * @param world is the mesh in assembly coordinates, it is modified in place
+      * @return the shared local mesh and the translation for this part
+      */
+    PartGeometry intern(vtkPolyData* world);
+
+    /** Same as intern() for a mesh that is already in its local frame, e.g. from the disk cache
+      * @param local is the mesh with its bounding box minimum at the origin
+      * @param origin is the position of the local frame in the assembly
+      * @return the shared local mesh and the translation for this part
+      */
+    PartGeometry internLocal(vtkPolyData* local, const double origin[3]);
+
+    /** Drop one user of a shared mesh, it is forgotten once nobody uses it
+      * @param geometry is a value returned by intern()
+      */
+    void release(const PartGeometry& geometry);
+
+    /** @return the number of distinct meshes currently held
+      */
+    int uniqueCount();
+
+    /** @return the number of parts sharing the mesh of a geometry, 1 for unregistered geometry
+      */
+    int userCount(const PartGeometry& geometry);
+
+    /** @return the memory held by all distinct meshes in bytes
+      */
+    qint64 totalBytes();
+
+private:
+    GeometryRegistry() = default;
+
+    struct Entry {
+        vtkSmartPointer<vtkPolyData> polyData;
+        int users = 0;
+    };
+
+    QMutex mutex;
+    QMultiHash<uint64_t, Entry> entries;
+};
+
+#endif // VIEWER_GEOMETRYREGISTRY_H
@@ -0,0 +1,77 @@
+// Header file for this class
+#include "InstancedRenderer.h"
+#include "ModelPart.h"
+
+// VTK headers
+#include <vtkGlyph3DMapper.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedCharArray.h>
+
+// Constructor
+InstancedRenderer::InstancedRenderer(vtkRenderer* renderer)
+    : renderer(renderer) {
+}
+
+// Enables or disables instancing, the caller redraws every mesh afterwards
+void InstancedRenderer::setEnabled(bool enabled) {
+    this->enabled = enabled;
+    if (!enabled)
+        clear();
+}
+
+bool InstancedRenderer::isEnabled() const {
+    return enabled;
+}
+
+// One glyph actor for a mesh with two or more visible copies
+bool InstancedRenderer::setGroup(vtkPolyData* mesh, const QList<ModelPart*>& parts) {
+    vtkSmartPointer<vtkActor> oldActor = actors.take(mesh);
+    if (oldActor)
+        renderer->RemoveActor(oldActor);
+
+    if (!enabled || !mesh || parts.size() < 2)
+        return false;
+
+    // One glyph per copy, placed at the part origin and coloured directly
+    vtkNew<vtkPoints> positions;
+    positions->SetNumberOfPoints(parts.size());
+    vtkNew<vtkUnsignedCharArray> colours;
+    colours->SetName("Colours");
+    colours->SetNumberOfComponents(3);
+    colours->SetNumberOfTuples(parts.size());
+
+    for (int i = 0; i < parts.size(); ++i) {
+        positions->SetPoint(i, parts[i]->getGeometry().origin);
+        const unsigned char rgb[3] = { parts[i]->getColourR(), parts[i]->getColourG(), parts[i]->getColourB() };
+        colours->SetTypedTuple(i, rgb);
+    }
+
+    vtkNew<vtkPolyData> instances;
+    instances->SetPoints(positions);
+    instances->GetPointData()->SetScalars(colours);
+
+    vtkNew<vtkGlyph3DMapper> mapper;
+    mapper->SetInputData(instances);
+    // Copies share the flat mesh and so its smooth version, the first part's shading stands for the group
+    mapper->SetSourceData(parts.first()->getShadedMesh());
+    mapper->SetScaling(false);
+    mapper->SetOrient(false);
+    mapper->SetColorModeToDirectScalars();
+    mapper->ScalarVisibilityOn();
+
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    renderer->AddActor(actor);
+    actors.insert(mesh, actor);
+    return true;
+}
+
+// Removes every instanced actor
+void InstancedRenderer::clear() {
+    for (const vtkSmartPointer<vtkActor>& actor : actors)
+        renderer->RemoveActor(actor);
+    actors.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef VIEWER_INSTANCEDRENDERER_H
+#define VIEWER_INSTANCEDRENDERER_H
+
+#include <QHash>
+#include <QList>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+
+class ModelPart;
+
+/* Draws parts that share a mesh (see GeometryRegistry) through one vtkGlyph3DMapper actor per
+ * mesh instead of one actor per part. Each visible copy becomes a glyph placed at the part's
+ * origin and coloured with the part's colour, so draw calls scale with distinct geometry.
+ */
+class InstancedRenderer {
+public:
+    /** Constructor
+      * @param renderer is the renderer the instanced actors are added to
+      */
+    explicit InstancedRenderer(vtkRenderer* renderer);
+
+    /** Turn instancing on or off, when off every part keeps its own actor and the caller redraws every mesh
+      */
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    /** Rebuild the instanced actor of one mesh, or remove it if it is no longer needed
+      * @param mesh is the shared local frame mesh
+      * @param parts are the visible parts that use the mesh
+      * @return true if the parts are drawn instanced, false if they need their own actors
+      */
+    bool setGroup(vtkPolyData* mesh, const QList<ModelPart*>& parts);
+
+    /** Remove every instanced actor from the renderer
+      */
+    void clear();
+
+private:
+    vtkRenderer* renderer;
+    bool enabled = true;
+    QHash<vtkPolyData*, vtkSmartPointer<vtkActor>> actors;    /**< One actor per shared mesh with 2+ visible copies */
+};
+
+#endif // VIEWER_INSTANCEDRENDERER_H
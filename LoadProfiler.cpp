@@ -0,0 +1,220 @@
+// Header file for this class
+#include "LoadProfiler.h"
+
+// Q includes
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QPair>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+
+namespace {
+
+const char* STAGE_NAMES[LoadProfiler::StageCount] = {
+    "Stat", "Read", "Parse", "Merge", "Optimise", "Intern", "CacheLookup", "CacheStore", "Mapper", "FirstUpload"
+};
+
+// Milliseconds with one decimal for the text report
+QString ms(qint64 ns) {
+    return QString::number(ns / 1.0e6, 'f', 1);
+}
+
+} // namespace
+
+// The one profiler, created on first use
+LoadProfiler& LoadProfiler::instance() {
+    static LoadProfiler profiler;
+    return profiler;
+}
+
+// Constructor - starts the shared clock
+LoadProfiler::LoadProfiler() {
+    clock.start();
+}
+
+const char* LoadProfiler::stageName(Stage stage) {
+    return STAGE_NAMES[stage];
+}
+
+qint64 LoadProfiler::now() const {
+    return clock.nsecsElapsed();
+}
+
+// Appends an event, each thread gets a small track number the first time it records
+void LoadProfiler::record(const QString& file, Stage stage, qint64 startNs, qint64 durationNs) {
+    const quintptr threadId = reinterpret_cast<quintptr>(QThread::currentThreadId());
+
+    QMutexLocker lock(&mutex);
+    auto thread = threads.find(threadId);
+    if (thread == threads.end())
+        thread = threads.insert(threadId, threads.size() + 1);
+
+    events.append({ file, stage, startNs, durationNs, *thread });
+}
+
+void LoadProfiler::watchFirstDraw(vtkMapper* mapper, const QString& file) {
+    watches.append({ mapper, file });
+}
+
+// A mapper that has drawn reports its draw time, the event is placed to end now
+void LoadProfiler::collectFirstDraws() {
+    const qint64 end = now();
+    for (auto it = watches.begin(); it != watches.end();) {
+        if (!it->mapper) {
+            it = watches.erase(it);
+            continue;
+        }
+
+        const double seconds = it->mapper->GetTimeToDraw();
+        if (seconds > 0.0) {
+            const qint64 duration = static_cast<qint64>(seconds * 1.0e9);
+            record(it->file, FirstUpload, end - duration, duration);
+            it = watches.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void LoadProfiler::clear() {
+    QMutexLocker lock(&mutex);
+    events.clear();
+    watches.clear();
+}
+
+// Stage totals over all files, then the slowest files with their stages
+QString LoadProfiler::report(int slowestFiles) {
+    QList<Event> snapshot;
+    {
+        QMutexLocker lock(&mutex);
+        snapshot = events;
+    }
+
+    if (snapshot.isEmpty())
+        return QString("No load timings recorded yet.");
+
+    qint64 stageTotals[StageCount] = {};
+    QHash<QString, QVector<qint64>> perFile;
+    qint64 first = snapshot.first().startNs;
+    qint64 last = 0;
+
+    for (const Event& event : snapshot) {
+        stageTotals[event.stage] += event.durationNs;
+        QVector<qint64>& stages = perFile[event.file];
+        if (stages.isEmpty())
+            stages.fill(0, StageCount);
+        stages[event.stage] += event.durationNs;
+        first = std::min(first, event.startNs);
+        last = std::max(last, event.startNs + event.durationNs);
+    }
+
+    QString text;
+    QTextStream out(&text);
+    out << "Files: " << perFile.size() << ", wall time " << ms(last - first) << " ms\n\n";
+    out << "Stage totals (summed over all loader threads)\n";
+    for (int stage = 0; stage < StageCount; ++stage) {
+        if (stageTotals[stage] == 0)
+            continue;
+        out << "  " << QString(STAGE_NAMES[stage]).leftJustified(12) << ms(stageTotals[stage]).rightJustified(10)
+            << " ms   avg " << ms(stageTotals[stage] / perFile.size()) << " ms per file\n";
+    }
+
+    // Slowest files first, by the sum of their stages
+    QList<QPair<qint64, QString>> totals;
+    for (auto it = perFile.constBegin(); it != perFile.constEnd(); ++it) {
+        qint64 sum = 0;
+        for (qint64 ns : it.value())
+            sum += ns;
+        totals.append({ sum, it.key() });
+    }
+    std::sort(totals.begin(), totals.end(), [](const QPair<qint64, QString>& a, const QPair<qint64, QString>& b) {
+        return a.first > b.first;
+    });
+
+    out << "\nSlowest files\n";
+    for (int i = 0; i < std::min(slowestFiles, int(totals.size())); ++i) {
+        out << ms(totals[i].first).rightJustified(10) << " ms  " << totals[i].second << "\n           ";
+        const QVector<qint64>& stages = perFile[totals[i].second];
+        for (int stage = 0; stage < StageCount; ++stage) {
+            if (stages[stage] > 0)
+                out << " " << STAGE_NAMES[stage] << " " << ms(stages[stage]);
+        }
+        out << "\n";
+    }
+
+    return text;
+}
+
+// Complete ("X") events in microseconds, one track per thread
+QJsonArray LoadProfiler::traceEvents() {
+    QList<Event> snapshot;
+    QHash<quintptr, int> tracks;
+    {
+        QMutexLocker lock(&mutex);
+        snapshot = events;
+        tracks = threads;
+    }
+
+    QJsonArray traceEvents;
+    QJsonObject process;
+    process["name"] = "process_name";
+    process["ph"] = "M";
+    process["pid"] = 1;
+    process["args"] = QJsonObject{ { "name", "Loading" } };
+    traceEvents.append(process);
+
+    for (int track : tracks) {
+        QJsonObject name;
+        name["name"] = "thread_name";
+        name["ph"] = "M";
+        name["pid"] = 1;
+        name["tid"] = track;
+        name["args"] = QJsonObject{ { "name", QString("Loader thread %1").arg(track) } };
+        traceEvents.append(name);
+    }
+
+    for (const Event& event : snapshot) {
+        QJsonObject entry;
+        entry["name"] = STAGE_NAMES[event.stage];
+        entry["cat"] = "load";
+        entry["ph"] = "X";
+        entry["ts"] = event.startNs / 1000.0;
+        entry["dur"] = event.durationNs / 1000.0;
+        entry["pid"] = 1;
+        entry["tid"] = event.thread;
+        entry["args"] = QJsonObject{ { "file", event.file } };
+        traceEvents.append(entry);
+    }
+
+    return traceEvents;
+}
+
+// Writes the load events on their own
+bool LoadProfiler::writeChromeTrace(const QString& path) {
+    QJsonObject root;
+    root["traceEvents"] = traceEvents();
+    root["displayTimeUnit"] = "ms";
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+// Constructor - starts timing
+ScopedLoadTimer::ScopedLoadTimer(const QString& file, LoadProfiler::Stage stage)
+    : file(file), stage(stage), start(LoadProfiler::instance().now()) {
+}
+
+// Destructor - records the stage
+ScopedLoadTimer::~ScopedLoadTimer() {
+    LoadProfiler& profiler = LoadProfiler::instance();
+    profiler.record(file, stage, start, profiler.now() - start);
+}
@@ -0,0 +1,114 @@
+#ifndef VIEWER_LOADPROFILER_H
+#define VIEWER_LOADPROFILER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonArray>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include <vtkMapper.h>
+#include <vtkWeakPointer.h>
+
+/* Collects how long each stage of loading a part takes, per file, from any thread.
+ * Stages are timed with ScopedLoadTimer where the work happens (reader, welder, optimiser, registry,
+ * cache and mapper setup). The first draw of a part is taken from its mapper's own draw timer
+ * after the render that first shows it, which includes building and uploading its buffers.
+ * The events can be summarised as text or written as Chrome trace-event JSON
+ * (chrome://tracing, Perfetto) with one track per loader thread.
+ */
+class LoadProfiler {
+public:
+    enum Stage { Stat, Read, Parse, Merge, Optimise, Intern, CacheLookup, CacheStore, Mapper, FirstUpload, StageCount };
+
+    /** @return the profiler shared by every loader thread
+      */
+    static LoadProfiler& instance();
+
+    /** @return the name a stage is reported under
+      */
+    static const char* stageName(Stage stage);
+
+    /** @return nanoseconds since the profiler was created, the time base of every event
+      */
+    qint64 now() const;
+
+    /** Add a finished event, thread safe
+      * @param file is the STL file the work was for
+      * @param stage is what was done
+      * @param startNs is from now() when the work started
+      * @param durationNs is how long it took
+      */
+    void record(const QString& file, Stage stage, qint64 startNs, qint64 durationNs);
+
+    /** Remember a new mapper so the time of its first draw can be recorded, GUI thread only
+      */
+    void watchFirstDraw(vtkMapper* mapper, const QString& file);
+
+    /** Record the first draw of the watched mappers that have been drawn, call after rendering
+      */
+    void collectFirstDraws();
+
+    /** Forget every event, e.g. before a new repository is loaded
+      */
+    void clear();
+
+    /** @param slowestFiles is how many files to list individually
+      * @return stage totals and the slowest files with their breakdown, as plain text
+      */
+    QString report(int slowestFiles = 50);
+
+    /** @return every event as Chrome trace-event objects, loader threads are tracks of process 1
+      */
+    QJsonArray traceEvents();
+
+    /** Write every event as Chrome trace-event JSON
+      * @param path is the file to write
+      * @return false if the file could not be written
+      */
+    bool writeChromeTrace(const QString& path);
+
+private:
+    LoadProfiler();
+
+    struct Event {
+        QString file;
+        Stage stage;
+        qint64 startNs;
+        qint64 durationNs;
+        int thread;
+    };
+
+    struct Watch {
+        vtkWeakPointer<vtkMapper> mapper;
+        QString file;
+    };
+
+    QElapsedTimer clock;
+    QMutex mutex;
+    QList<Event> events;                    /**< Guarded by mutex */
+    QHash<quintptr, int> threads;           /**< Thread id -> small track number, guarded by mutex */
+    QList<Watch> watches;                   /**< GUI thread only */
+};
+
+/* Times the enclosing scope as one stage of loading a file */
+class ScopedLoadTimer {
+public:
+    /** Start timing
+      * @param file is the STL file the work is for
+      * @param stage is what is being done
+      */
+    ScopedLoadTimer(const QString& file, LoadProfiler::Stage stage);
+
+    /** Stop timing and record the event
+      */
+    ~ScopedLoadTimer();
+
+private:
+    QString file;
+    LoadProfiler::Stage stage;
+    qint64 start;
+};
+
+#endif // VIEWER_LOADPROFILER_H
@@ -0,0 +1,122 @@
+// Header file for this class
+#include "LodGenerator.h"
+#include "ModelPart.h"
+
+// VTK headers
+#include <vtkNew.h>
+#include <vtkQuadricDecimation.h>
+
+namespace {
+
+// Fraction of the full triangle count kept by each level, finest first
+const double LEVEL_RATIOS[] = { 0.5, 0.1, 0.02 };
+
+// Levels below this many triangles are not worth switching to
+const vtkIdType MIN_LEVEL_TRIANGLES = 64;
+
+} // namespace
+
+// Constructor
+LodGenerator::LodGenerator(QObject* parent)
+    : QObject(parent), jobs(this) {
+}
+
+// Destructor - the jobs wait for any decimation that is still running
+LodGenerator::~LodGenerator() {
+}
+
+// Levels already built keep their order, welded meshes are only reordered when they are loaded again too
+void LodGenerator::setOptimiseOrder(bool optimise) {
+    optimiseOrder = optimise;
+}
+
+// Queues a mesh for decimation, or reuses levels that were already built for it
+void LodGenerator::request(ModelPart* part) {
+    vtkPolyData* mesh = part->getGeometry().polyData;
+    if (!mesh || mesh->GetNumberOfPolys() * LEVEL_RATIOS[0] < MIN_LEVEL_TRIANGLES)
+        return;
+
+    if (const QList<vtkSmartPointer<vtkPolyData>>* levels = generated.find(mesh)) {
+        part->setLodLevels(*levels);
+        emit levelsReady({ part });
+        return;
+    }
+
+    if (!generated.addWaiting(mesh, part))
+        return;
+
+    // The decimation filter writes pipeline information into its input, so the worker gets its
+    // own shallow copy made here and the shared mesh the renderer draws is only used as the key
+    vtkSmartPointer<vtkPolyData> source = mesh;
+    vtkSmartPointer<vtkPolyData> input = vtkSmartPointer<vtkPolyData>::New();
+    input->ShallowCopy(mesh);
+    const bool optimise = optimiseOrder;
+    jobs.start([input, optimise]() { return generateLevels(input, optimise); },
+               [this, source](const QList<vtkSmartPointer<vtkPolyData>>& levels) { assignLevels(source, levels); });
+}
+
+// Drops every request, jobs already running finish but their output is ignored
+void LodGenerator::clear() {
+    jobs.cancel();
+    generated.clear();
+}
+
+bool LodGenerator::isBusy() const {
+    return generated.hasWaiting();
+}
+
+// Entries of meshes that were freed when their parts were released
+void LodGenerator::prune() {
+    generated.prune();
+}
+
+// Sum of the actual memory size of every level, VTK reports it in KiB
+qint64 LodGenerator::totalBytes() const {
+    qint64 bytes = 0;
+    for (const auto& entry : generated) {
+        for (const vtkSmartPointer<vtkPolyData>& level : entry.value)
+            bytes += qint64(level->GetActualMemorySize()) * 1024;
+    }
+    return bytes;
+}
+
+// Decimates progressively, each level starts from the previous one to keep it cheap. Decimation leaves
+// the triangles in no useful order, so a level is reordered before the next one is built from it
+QList<vtkSmartPointer<vtkPolyData>> LodGenerator::generateLevels(vtkPolyData* mesh, bool optimise) {
+    QList<vtkSmartPointer<vtkPolyData>> levels;
+    vtkSmartPointer<vtkPolyData> source = mesh;
+    const vtkIdType full = mesh->GetNumberOfPolys();
+
+    for (double ratio : LEVEL_RATIOS) {
+        const vtkIdType target = static_cast<vtkIdType>(full * ratio);
+        if (target < MIN_LEVEL_TRIANGLES)
+            break;
+
+        vtkNew<vtkQuadricDecimation> decimate;
+        decimate->SetInputData(source);
+        decimate->SetTargetReduction(1.0 - double(target) / double(source->GetNumberOfPolys()));
+        decimate->VolumePreservationOn();
+        decimate->Update();
+
+        vtkSmartPointer<vtkPolyData> level = vtkSmartPointer<vtkPolyData>::New();
+        level->ShallowCopy(decimate->GetOutput());
+        if (optimise)
+            ModelPart::optimiseOrder(level);
+        levels.append(level);
+        source = level;
+    }
+
+    return levels;
+}
+
+// Gives the finished levels to every part that shares the mesh
+void LodGenerator::assignLevels(vtkPolyData* mesh, const QList<vtkSmartPointer<vtkPolyData>>& levels) {
+    generated.insert(mesh, levels);
+
+    const QList<ModelPart*> parts = generated.takeWaiting(mesh);
+    for (ModelPart* part : parts)
+        part->setLodLevels(levels);
+
+    if (!parts.isEmpty())
+        emit levelsReady(parts);
+}
@@ -0,0 +1,76 @@
+#ifndef VIEWER_LODGENERATOR_H
+#define VIEWER_LODGENERATOR_H
+
+#include <QObject>
+#include <QList>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include "MeshJobs.h"
+
+class ModelPart;
+
+/* Builds decimated levels of detail for loaded parts on the shared background pool.
+ * Levels are generated once per distinct mesh (parts sharing geometry through GeometryRegistry
+ * share their levels too) and handed to every part waiting for that mesh on the GUI thread.
+ */
+class LodGenerator : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param parent is used by the QObject constructor
+      */
+    explicit LodGenerator(QObject* parent = nullptr);
+
+    /** Destructor - abandons queued jobs and waits for running ones
+      */
+    ~LodGenerator();
+
+    /** Reorder levels built after this call for the GPU with MeshOptimizer, as the welded meshes are
+      */
+    void setOptimiseOrder(bool optimise);
+
+    /** Queue level generation for a part, parts whose mesh already has levels get them at once
+      * @param part is a loaded part, it must stay alive until levelsReady or clear()
+      */
+    void request(ModelPart* part);
+
+    /** Forget every pending request and generated level, call before the parts are deleted
+      */
+    void clear();
+
+    /** @return true while requested levels are still being generated
+      */
+    bool isBusy() const;
+
+    /** Forget the levels of meshes that no part uses any more, so their memory is freed
+      */
+    void prune();
+
+    /** @return the memory held by every generated level in bytes
+      */
+    qint64 totalBytes() const;
+
+    /** Decimate a mesh to each of LEVEL_RATIOS, each level is built from the previous one
+      * @param mesh is the full detail mesh, it becomes the input of a filter so it must not be
+      *  shared with another thread
+      * @param optimise reorders every level with MeshOptimizer
+      * @return the levels from finest to coarsest, levels that would be too small are left out
+      */
+    static QList<vtkSmartPointer<vtkPolyData>> generateLevels(vtkPolyData* mesh, bool optimise = false);
+
+signals:
+    /** Emitted on the GUI thread once levels have been assigned to some parts */
+    void levelsReady(const QList<ModelPart*>& parts);
+
+private:
+    void assignLevels(vtkPolyData* mesh, const QList<vtkSmartPointer<vtkPolyData>>& levels);
+
+    MeshJobs jobs;
+    bool optimiseOrder = false;
+    MeshResults<QList<vtkSmartPointer<vtkPolyData>>> generated;
+};
+
+#endif // VIEWER_LODGENERATOR_H
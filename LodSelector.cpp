@@ -0,0 +1,168 @@
+// Header file for this class
+#include "LodSelector.h"
+
+// VTK headers
+#include <vtkCamera.h>
+#include <vtkMath.h>
+#include <vtkPolyDataMapper.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Triangles wanted per square pixel of projected area at full quality
+const double TRIANGLES_PER_PIXEL = 0.5;
+
+// Lowest quality the frame budget can push the selection down to
+const double MIN_QUALITY = 0.05;
+
+} // namespace
+
+// Constructor - observes the start of every render of this renderer
+LodSelector::LodSelector(vtkRenderer* renderer, double frameBudget)
+    : renderer(renderer), frameBudget(frameBudget) {
+    callback = vtkSmartPointer<vtkCallbackCommand>::New();
+    callback->SetCallback(&LodSelector::onStartRender);
+    callback->SetClientData(this);
+    observerTag = renderer->AddObserver(vtkCommand::StartEvent, callback);
+}
+
+// Destructor
+LodSelector::~LodSelector() {
+    renderer->RemoveObserver(observerTag);
+    clear();
+}
+
+// Registers (or replaces) the reduced levels of an actor
+void LodSelector::setLevels(vtkActor* actor, const QList<vtkSmartPointer<vtkPolyData>>& levels) {
+    if (!actor || !actor->GetMapper())
+        return;
+
+    // Keep the full detail mapper if the actor is already switched
+    vtkSmartPointer<vtkMapper> fullMapper = actor->GetMapper();
+    if (entries.contains(actor))
+        fullMapper = entries[actor].mappers.first();
+
+    actor->SetMapper(fullMapper);
+    if (levels.isEmpty()) {
+        entries.remove(actor);
+        return;
+    }
+
+    Entry entry;
+    entry.actor = actor;
+    entry.mappers.append(fullMapper);
+    vtkPolyData* full = vtkPolyData::SafeDownCast(fullMapper->GetInputDataObject(0, 0));
+    entry.triangles.append(full ? full->GetNumberOfPolys() : VTK_ID_MAX);
+
+    for (const vtkSmartPointer<vtkPolyData>& level : levels) {
+        entry.mappers.append(mapperFor(level));
+        entry.triangles.append(level->GetNumberOfPolys());
+    }
+
+    entries.insert(actor, entry);
+}
+
+// Restores every actor to full detail
+void LodSelector::clear() {
+    for (Entry& entry : entries)
+        entry.actor->SetMapper(entry.mappers.first());
+    entries.clear();
+}
+
+// Forgets the reduced level mappers so their GPU buffers are freed
+void LodSelector::releaseMappers() {
+    clear();
+    levelMappers.clear();
+}
+
+// A mapper only referenced by the cache belongs to levels nobody draws any more
+void LodSelector::pruneMappers() {
+    for (auto it = levelMappers.begin(); it != levelMappers.end();) {
+        if ((*it)->GetReferenceCount() == 1)
+            it = levelMappers.erase(it);
+        else
+            ++it;
+    }
+}
+
+void LodSelector::setFrameBudget(double frameBudget) {
+    this->frameBudget = frameBudget;
+}
+
+// One mapper per reduced mesh, shared by every actor drawing that mesh
+vtkMapper* LodSelector::mapperFor(vtkPolyData* level) {
+    auto it = levelMappers.find(level);
+    if (it != levelMappers.end())
+        return *it;
+
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputData(level);
+    levelMappers.insert(level, mapper);
+    return mapper;
+}
+
+// Render observer, forwards to the selector that registered it
+void LodSelector::onStartRender(vtkObject*, unsigned long, void* clientData, void*) {
+    static_cast<LodSelector*>(clientData)->selectLevels();
+}
+
+// Picks a level for every visible registered actor from its projected size
+void LodSelector::selectLevels() {
+    if (entries.isEmpty())
+        return;
+
+    // Adapt the density to the time the previous frame took
+    const double lastFrame = renderer->GetLastRenderTimeInSeconds();
+    if (frameBudget > 0.0 && lastFrame > 0.0) {
+        if (lastFrame > frameBudget)
+            quality = std::max(MIN_QUALITY, quality * 0.85);
+        else if (lastFrame < 0.6 * frameBudget)
+            quality = std::min(1.0, quality * 1.05);
+    }
+
+    vtkCamera* camera = renderer->GetActiveCamera();
+    const int* size = renderer->GetSize();
+    const double height = std::max(1, size[1]);
+    double eye[3];
+    camera->GetPosition(eye);
+
+    // Pixels covered by one unit of length at distance 1 (perspective) or anywhere (parallel)
+    const bool parallel = camera->GetParallelProjection() != 0;
+    const double pixelsPerUnit = parallel
+        ? height / (2.0 * camera->GetParallelScale())
+        : height / (2.0 * std::tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.0));
+
+    for (Entry& entry : entries) {
+        if (!entry.actor->GetVisibility())
+            continue;
+
+        // World bounds, the actor's matrix includes its user transform (the VR scene rotation)
+        double bounds[6];
+        entry.actor->GetBounds(bounds);
+        const double center[3] = { (bounds[0] + bounds[1]) / 2, (bounds[2] + bounds[3]) / 2, (bounds[4] + bounds[5]) / 2 };
+        const double radius = std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                                        (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                                        (bounds[5] - bounds[4]) * (bounds[5] - bounds[4])) / 2.0;
+
+        double pixels = radius * pixelsPerUnit;
+        if (!parallel)
+            pixels /= std::max(std::sqrt(vtkMath::Distance2BetweenPoints(center, eye)) - radius, 1.0e-6);
+
+        // Coarsest level that still has the wanted triangle density, full detail otherwise
+        const double wanted = quality * TRIANGLES_PER_PIXEL * vtkMath::Pi() * pixels * pixels;
+        int level = 0;
+        for (int i = entry.triangles.size() - 1; i > 0; --i) {
+            if (entry.triangles[i] >= wanted) {
+                level = i;
+                break;
+            }
+        }
+
+        if (level != entry.level) {
+            entry.level = level;
+            entry.actor->SetMapper(entry.mappers[level]);
+        }
+    }
+}
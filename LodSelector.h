@@ -0,0 +1,77 @@
+#ifndef VIEWER_LODSELECTOR_H
+#define VIEWER_LODSELECTOR_H
+
+#include <QHash>
+#include <QList>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkMapper.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkCallbackCommand.h>
+
+/* Switches actors between levels of detail just before each frame is rendered.
+ * For every registered actor the projected radius of its bounds is measured in pixels and the
+ * coarsest level that still has enough triangles for that screen area is drawn. The triangle
+ * density is scaled down when the previous frame went over the frame time budget and back up
+ * when there is headroom. Only the actor's mapper is swapped, so colour, visibility and
+ * position (and therefore the tree and options dialog) are unaffected.
+ * One selector is used per renderer and must only be called from that renderer's thread.
+ */
+class LodSelector {
+public:
+    /** Constructor
+      * @param renderer is observed and its actors are switched
+      * @param frameBudget is the target frame time in seconds, 0 disables the adaptation
+      */
+    LodSelector(vtkRenderer* renderer, double frameBudget);
+
+    /** Destructor - removes the render observer and restores every actor's full mapper
+      */
+    ~LodSelector();
+
+    /** Register the reduced levels of an actor, replacing any levels it had before
+      * @param actor is drawn with its own mapper at full detail
+      * @param levels are progressively coarser meshes, in the same frame as the actor's mapper input
+      */
+    void setLevels(vtkActor* actor, const QList<vtkSmartPointer<vtkPolyData>>& levels);
+
+    /** Stop switching every actor and put their full detail mappers back
+      */
+    void clear();
+
+    /** Drop the cached mappers of the reduced levels, call when the scene geometry is discarded
+      */
+    void releaseMappers();
+
+    /** Drop the cached mappers that no registered actor uses, call after parts released their levels
+      */
+    void pruneMappers();
+
+    /** @param frameBudget is the target frame time in seconds, 0 disables the adaptation
+      */
+    void setFrameBudget(double frameBudget);
+
+private:
+    struct Entry {
+        vtkSmartPointer<vtkActor> actor;
+        QList<vtkSmartPointer<vtkMapper>> mappers;     /**< [0] is the actor's own mapper */
+        QList<vtkIdType> triangles;                     /**< Triangle count of each level */
+        int level = 0;
+    };
+
+    static void onStartRender(vtkObject* caller, unsigned long eventId, void* clientData, void* callData);
+    void selectLevels();
+    vtkMapper* mapperFor(vtkPolyData* level);
+
+    vtkRenderer* renderer;
+    vtkSmartPointer<vtkCallbackCommand> callback;
+    unsigned long observerTag = 0;
+    double frameBudget;
+    double quality = 1.0;                               /**< Scales the triangle density, adapted per frame */
+    QHash<vtkActor*, Entry> entries;
+    QHash<vtkPolyData*, vtkSmartPointer<vtkMapper>> levelMappers; /**< Shared by actors using the same mesh */
+};
+
+#endif // VIEWER_LODSELECTOR_H
@@ -0,0 +1,180 @@
+// Header file for this class
+#include "MappedSTLReader.h"
+#include "LoadProfiler.h"
+#include "ContentHash.h"
+
+// Q includes
+#include <QFile>
+#include <QtEndian>
+
+// VTK headers
+#include <vtkNew.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Byte offset of the first vertex inside a triangle record (skips the facet normal)
+const qint64 VERTEX_OFFSET = 12;
+
+// Bytes of vertex data in a record, 3 corners of 3 floats
+const size_t VERTEX_BYTES = 9 * sizeof(float);
+
+// Stride used to fault the mapping in, the smallest common page size
+const qint64 PAGE_SIZE = 4096;
+
+// Returns the triangle count stored in the header, or -1 if it does not match the file size
+qint64 triangleCount(const uchar* header, qint64 fileSize) {
+    const qint64 count = qFromLittleEndian<quint32>(header + 80);
+    if (MappedSTLReader::HEADER_SIZE + MappedSTLReader::RECORD_SIZE * count != fileSize)
+        return -1;
+    return count;
+}
+
+// Every corner is its own point, so the cell arrays are simple ramps
+template <typename ArrayT>
+void fillTriangleCells(vtkCellArray* cells, vtkIdType triangles) {
+    using ValueType = typename ArrayT::ValueType;
+
+    vtkNew<ArrayT> offsets;
+    offsets->SetNumberOfValues(triangles + 1);
+    ValueType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangles; ++i)
+        offset[i] = static_cast<ValueType>(3 * i);
+
+    vtkNew<ArrayT> connectivity;
+    connectivity->SetNumberOfValues(3 * triangles);
+    ValueType* corner = connectivity->GetPointer(0);
+    for (vtkIdType i = 0; i < 3 * triangles; ++i)
+        corner[i] = static_cast<ValueType>(i);
+
+    cells->SetData(offsets, connectivity);
+}
+
+} // namespace
+
+// Reads just the header to decide whether the file is binary
+bool MappedSTLReader::isBinarySTL(const QString& fileName) {
+    return binaryTriangleCount(fileName) >= 0;
+}
+
+// The count is only trusted if it matches the file size
+qint64 MappedSTLReader::binaryTriangleCount(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    const QByteArray header = file.read(HEADER_SIZE);
+    if (header.size() != HEADER_SIZE)
+        return -1;
+
+    return triangleCount(reinterpret_cast<const uchar*>(header.constData()), file.size());
+}
+
+/* Fixed size memcpy compiles to a few unaligned vector loads/stores per record, so the
+ * loop runs at memory bandwidth. Records are 50 bytes so they cannot be read as floats directly.
+ */
+void MappedSTLReader::decodeRecords(const uchar* records, qint64 count, float* xyz) {
+    const uchar* src = records + VERTEX_OFFSET;
+    for (qint64 i = 0; i < count; ++i) {
+        std::memcpy(xyz, src, VERTEX_BYTES);
+        xyz += 9;
+        src += RECORD_SIZE;
+    }
+}
+
+// Maps the whole file and copies the vertex block of each record into the point array
+vtkSmartPointer<vtkPolyData> MappedSTLReader::read(const QString& fileName, uint64_t* contentHash) {
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Records are little endian floats, leave byte swapping to vtkSTLReader
+    return nullptr;
+#else
+    QFile file(fileName);
+    qint64 size = 0;
+    {
+        ScopedLoadTimer timer(fileName, LoadProfiler::Stat);
+        if (!file.open(QIODevice::ReadOnly))
+            return nullptr;
+
+        size = file.size();
+        if (size < HEADER_SIZE)
+            return nullptr;
+    }
+
+    uchar* data = nullptr;
+    uint64_t hash = 0;
+    {
+        // Touch every page so disk time is reported as Read rather than as part of the decode,
+        // hashing the file reads every page anyway
+        ScopedLoadTimer timer(fileName, LoadProfiler::Read);
+        data = file.map(0, size);
+        if (!data)
+            return nullptr;
+
+        if (contentHash) {
+            hash = contentHash64(data, size_t(size));
+        }
+        else {
+            volatile uchar sink = 0;
+            for (qint64 offset = 0; offset < size; offset += PAGE_SIZE)
+                sink = sink ^ data[offset];
+        }
+    }
+
+    const qint64 triangles = triangleCount(data, size);
+    if (triangles < 0) {
+        file.unmap(data);
+        return nullptr;
+    }
+
+    if (contentHash)
+        *contentHash = hash;
+
+    ScopedLoadTimer timer(fileName, LoadProfiler::Parse);
+
+    // Decode straight into the storage that the polydata will own
+    vtkNew<vtkFloatArray> coords;
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(3 * triangles);
+
+    decodeRecords(data + HEADER_SIZE, triangles, coords->GetPointer(0));
+
+    file.unmap(data);
+
+    vtkNew<vtkPoints> points;
+    points->SetData(coords);
+
+    vtkNew<vtkCellArray> cells;
+    if (3 * triangles <= std::numeric_limits<vtkTypeInt32>::max())
+        fillTriangleCells<vtkTypeInt32Array>(cells, triangles);
+    else
+        fillTriangleCells<vtkTypeInt64Array>(cells, triangles);
+
+    vtkSmartPointer<vtkPolyData> geometry = vtkSmartPointer<vtkPolyData>::New();
+    geometry->SetPoints(points);
+    geometry->SetPolys(cells);
+    return geometry;
+#endif
+}
+
+// Empty files are hashed without a map, mapping zero bytes fails
+uint64_t MappedSTLReader::hashFile(const QString& fileName) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+    if (file.size() == 0)
+        return contentHash64(nullptr, 0);
+
+    uchar* data = file.map(0, file.size());
+    if (!data)
+        return 0;
+    const uint64_t hash = contentHash64(data, size_t(file.size()));
+    file.unmap(data);
+    return hash;
+}
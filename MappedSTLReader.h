@@ -0,0 +1,59 @@
+#ifndef VIEWER_MAPPEDSTLREADER_H
+#define VIEWER_MAPPEDSTLREADER_H
+
+#include <QString>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include <cstdint>
+
+/* Reads binary STL files by memory mapping them and decoding the 50 byte triangle records
+ * straight into the arrays of a vtkPolyData. There is no stream buffering and no point
+ * locator, every triangle corner becomes its own point (a "triangle soup").
+ * ASCII files are not handled here, read() returns nullptr so the caller can fall back
+ * to vtkSTLReader.
+ */
+class MappedSTLReader {
+public:
+    /** Check the header of a file to see if it is a well formed binary STL
+      * @param fileName is the STL file
+      * @return true if read() can decode the file
+      */
+    static bool isBinarySTL(const QString& fileName);
+
+    /** Read the triangle count from the header of a binary STL
+      * @param fileName is the STL file
+      * @return the number of triangles, or -1 if the file is not a well formed binary STL
+      */
+    static qint64 binaryTriangleCount(const QString& fileName);
+
+    /** Copy the corners of consecutive triangle records into packed x,y,z floats
+      * @param records points at the first record
+      * @param count is the number of records
+      * @param xyz receives 9 floats per record
+      */
+    static void decodeRecords(const uchar* records, qint64 count, float* xyz);
+
+    /** Decode a binary STL file
+      * @param fileName is the STL file
+      * @param contentHash if not null receives the contentHash64 of the mapped file, taken from the same bytes
+      *  that were decoded. It is left alone when nullptr is returned
+      * @return the triangles as polydata, or nullptr if the file is not a binary STL
+      */
+    static vtkSmartPointer<vtkPolyData> read(const QString& fileName, uint64_t* contentHash = nullptr);
+
+    /** Hash a whole file through a memory map
+      * @param fileName is the file
+      * @return the contentHash64 of its bytes, 0 if it cannot be read
+      */
+    static uint64_t hashFile(const QString& fileName);
+
+    /** Size of the fixed header (80 byte comment + 32 bit triangle count) */
+    static const qint64 HEADER_SIZE = 84;
+
+    /** Size of one triangle record (normal, 3 vertices, attribute word) */
+    static const qint64 RECORD_SIZE = 50;
+};
+
+#endif // VIEWER_MAPPEDSTLREADER_H
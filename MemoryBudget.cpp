@@ -0,0 +1,209 @@
+// Header file for this class
+#include "MemoryBudget.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "GeometryRegistry.h"
+#include "LodGenerator.h"
+#include "LodSelector.h"
+#include "NormalGenerator.h"
+#include "PartPicker.h"
+#include "GeometryCompactor.h"
+
+// Q includes
+#include <QList>
+#include <QPair>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace {
+
+// Actual memory of a mesh and its levels, VTK reports it in KiB
+qint64 meshBytes(vtkPolyData* mesh, const QList<vtkSmartPointer<vtkPolyData>>& levels) {
+    qint64 bytes = qint64(mesh->GetActualMemorySize()) * 1024;
+    for (const vtkSmartPointer<vtkPolyData>& level : levels)
+        bytes += qint64(level->GetActualMemorySize()) * 1024;
+    return bytes;
+}
+
+} // namespace
+
+// Constructor
+MemoryBudget::MemoryBudget(ModelPartList* model, LodGenerator* lodGenerator, LodSelector* lodSelector,
+                           NormalGenerator* normalGenerator, PartPicker* partPicker, GeometryCompactor* compactor,
+                           QObject* parent)
+    : QObject(parent), model(model), lodGenerator(lodGenerator), lodSelector(lodSelector),
+      normalGenerator(normalGenerator), partPicker(partPicker), compactor(compactor) {
+    connect(model, &QAbstractItemModel::dataChanged, this, &MemoryBudget::handleDataChanged);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &MemoryBudget::handleRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &MemoryBudget::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &MemoryBudget::handleModelAboutToBeReset);
+    connect(lodGenerator, &LodGenerator::levelsReady, this, &MemoryBudget::scheduleEnforce);
+    connect(normalGenerator, &NormalGenerator::normalsReady, this, &MemoryBudget::scheduleEnforce);
+    connect(compactor, &GeometryCompactor::compacted, this, &MemoryBudget::handleCompacted);
+
+    trackSubtree(model->getRootItem());
+}
+
+// Sets the budget and applies it straight away
+void MemoryBudget::setBudget(qint64 bytes) {
+    budgetBytes = bytes;
+    enforce();
+}
+
+qint64 MemoryBudget::budget() const {
+    return budgetBytes;
+}
+
+qint64 MemoryBudget::usedBytes() const {
+    return GeometryRegistry::instance().totalBytes() + lodGenerator->totalBytes() + normalGenerator->totalBytes() +
+           partPicker->totalBytes() + compactor->totalBytes();
+}
+
+// Releases the longest hidden parts until the geometry fits, shared meshes only count once their last user goes
+int MemoryBudget::enforce() {
+    enforcePending = false;
+
+    // Copies are made in the background, the parts swap over when handleCompacted is called
+    if (compactor->isEnabled()) {
+        for (auto it = hiddenSince.constBegin(); it != hiddenSince.constEnd(); ++it) {
+            ModelPart* part = it.key();
+            if (part->getLoadState() == ModelPart::LoadState::Loaded && part->getGeometry().polyData &&
+                !part->getFilePath().isEmpty())
+                compactor->request(part);
+        }
+    }
+
+    if (budgetBytes <= 0)
+        return 0;
+
+    qint64 used = usedBytes();
+    if (used <= budgetBytes)
+        return 0;
+
+    // Only file parts can be read back, so folders and parts still loading are left alone
+    QList<QPair<quint64, ModelPart*>> candidates;
+    for (auto it = hiddenSince.constBegin(); it != hiddenSince.constEnd(); ++it) {
+        ModelPart* part = it.key();
+        const bool loaded = part->getLoadState() == ModelPart::LoadState::Loaded && part->getGeometry().polyData;
+        const bool compacted = part->getLoadState() == ModelPart::LoadState::Unloaded && part->getCompactGeometry().mesh;
+        if ((loaded || compacted) && !part->getFilePath().isEmpty())
+            candidates.append({ it.value(), part });
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    QList<ModelPart*> released;
+    for (const QPair<quint64, ModelPart*>& candidate : candidates) {
+        if (used <= budgetBytes)
+            break;
+
+        ModelPart* part = candidate.second;
+        const PartGeometry geometry = part->getGeometry();
+        if (geometry.polyData) {
+            if (GeometryRegistry::instance().userCount(geometry) <= 1) {
+                used -= meshBytes(geometry.polyData, part->getLodLevels());
+                if (vtkPolyData* smooth = part->getSmoothGeometry())
+                    used -= qint64(smooth->GetActualMemorySize()) * 1024;
+            }
+            part->releaseGeometry();
+        }
+
+        // The compact copy goes too, the part is read from its file when it is shown again
+        const std::shared_ptr<const CompactMesh>& compact = part->getCompactGeometry().mesh;
+        if (compact) {
+            if (compact.use_count() == 1)
+                used -= compact->bytes();
+            part->setCompactGeometry(CompactGeometry());
+        }
+
+        released.append(part);
+    }
+
+    if (released.isEmpty())
+        return 0;
+
+    partsReleased(released);
+    return released.size();
+}
+
+// Budget checks are merged, a batch of changes only sorts the hidden parts once
+void MemoryBudget::scheduleEnforce() {
+    if (enforcePending || (budgetBytes <= 0 && !compactor->isEnabled()))
+        return;
+
+    enforcePending = true;
+    QTimer::singleShot(0, this, &MemoryBudget::enforce);
+}
+
+void MemoryBudget::handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    if (!topLeft.isValid())
+        return;
+
+    const QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        trackSubtree(partFromIndex(model->index(row, 0, parent)));
+
+    scheduleEnforce();
+}
+
+void MemoryBudget::handleRowsInserted(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partFromIndex(parent);
+    for (int row = first; row <= last; ++row)
+        trackSubtree(parentPart->child(row));
+
+    scheduleEnforce();
+}
+
+void MemoryBudget::handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partFromIndex(parent);
+    for (int row = first; row <= last; ++row)
+        trackSubtree(parentPart->child(row), true);
+}
+
+void MemoryBudget::handleModelAboutToBeReset() {
+    hiddenSince.clear();
+}
+
+// Compacted parts hold a copy instead of their mesh, what only they used can be freed
+void MemoryBudget::handleCompacted(const QList<ModelPart*>& parts) {
+    partsReleased(parts);
+    scheduleEnforce();
+}
+
+// The root item for an invalid index, the part behind the index otherwise
+ModelPart* MemoryBudget::partFromIndex(const QModelIndex& index) const {
+    if (!index.isValid())
+        return model->getRootItem();
+    return static_cast<ModelPart*>(index.internalPointer());
+}
+
+// Visible parts are forgotten, hidden ones keep the time they were first seen hidden
+void MemoryBudget::trackSubtree(ModelPart* part, bool removing) {
+    if (!part)
+        return;
+
+    if (removing)
+        compactor->remove(part);
+
+    if (removing || part->visible())
+        hiddenSince.remove(part);
+    else if (!hiddenSince.contains(part))
+        hiddenSince.insert(part, ++clock);
+
+    for (int i = 0; i < part->childCount(); ++i)
+        trackSubtree(part->child(i), removing);
+}
+
+// Drops what released parts no longer keep alive and refreshes their rows
+void MemoryBudget::partsReleased(const QList<ModelPart*>& parts) {
+    lodGenerator->prune();
+    lodSelector->pruneMappers();
+    normalGenerator->prune();
+    partPicker->prune();
+    compactor->prune();
+
+    for (ModelPart* part : parts) {
+        const QModelIndex index = model->indexOf(part);
+        emit model->dataChanged(index, index.sibling(index.row(), ModelPartList::MEMORY_COLUMN));
+    }
+}
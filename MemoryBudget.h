@@ -0,0 +1,85 @@
+#ifndef VIEWER_MEMORYBUDGET_H
+#define VIEWER_MEMORYBUDGET_H
+
+#include <QObject>
+#include <QHash>
+#include <QModelIndex>
+
+class ModelPart;
+class ModelPartList;
+class LodGenerator;
+class GeometryCompactor;
+class LodSelector;
+class NormalGenerator;
+class PartPicker;
+
+/* Keeps the geometry held by the parts of a ModelPartList under a memory budget.
+ * The order in which parts were hidden is tracked from the model's change notifications,
+ * and when the meshes plus their levels of detail go over the budget the parts that have
+ * been hidden the longest release their geometry. Released parts become Unloaded, so the
+ * on demand path in PartLoader reads them back when they are shown again.
+ * With compaction on, hidden parts first swap their meshes for compact copies whether or not
+ * there is a budget, and going over the budget then drops the oldest copies as well.
+ */
+class MemoryBudget : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param model is observed for visibility changes
+      * @param lodGenerator holds the levels of detail, which count towards the budget
+      * @param lodSelector caches level mappers, which are dropped with their parts
+      * @param normalGenerator holds the smooth shading meshes, which count towards the budget
+      * @param partPicker holds the picking hierarchies, which count towards the budget
+      * @param compactor makes the compact copies of hidden parts, which count towards the budget
+      * @param parent is used by the QObject constructor
+      */
+    MemoryBudget(ModelPartList* model, LodGenerator* lodGenerator, LodSelector* lodSelector,
+                 NormalGenerator* normalGenerator, PartPicker* partPicker, GeometryCompactor* compactor,
+                 QObject* parent = nullptr);
+
+    /** @param bytes is the most geometry memory to keep, 0 means no limit
+      */
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+
+    /** @return the memory held by every distinct mesh, level of detail, smooth mesh, picking hierarchy
+      *  and compact copy in bytes
+      */
+    qint64 usedBytes() const;
+
+    /** Queue hidden parts for compaction if it is on, then release hidden parts, oldest first,
+      *  until the memory used fits the budget
+      * @return the number of parts released
+      */
+    int enforce();
+
+    /** Check the budget on the next pass of the event loop, several calls are merged
+      */
+    void scheduleEnforce();
+
+private slots:
+    void handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void handleRowsInserted(const QModelIndex& parent, int first, int last);
+    void handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void handleModelAboutToBeReset();
+    void handleCompacted(const QList<ModelPart*>& parts);
+
+private:
+    ModelPart* partFromIndex(const QModelIndex& index) const;
+    void trackSubtree(ModelPart* part, bool removing = false);
+    void partsReleased(const QList<ModelPart*>& parts);
+
+    ModelPartList* model;
+    LodGenerator* lodGenerator;
+    LodSelector* lodSelector;
+    NormalGenerator* normalGenerator;
+    PartPicker* partPicker;
+    GeometryCompactor* compactor;
+    qint64 budgetBytes = 0;
+    bool enforcePending = false;
+    quint64 clock = 0;
+    QHash<ModelPart*, quint64> hiddenSince;     /**< Hidden parts and when they were hidden */
+};
+
+#endif // VIEWER_MEMORYBUDGET_H
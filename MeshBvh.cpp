@@ -0,0 +1,130 @@
+// Header file for this class
+#include "MeshBvh.h"
+
+// VTK headers
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Moller-Trumbore, t is set to the distance along the direction when the ray hits the front or back
+inline bool rayTriangle(const float origin[3], const float direction[3],
+                        const float* a, const float* b, const float* c, float& t) {
+    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    const float p[3] = { direction[1] * e2[2] - direction[2] * e2[1],
+                         direction[2] * e2[0] - direction[0] * e2[2],
+                         direction[0] * e2[1] - direction[1] * e2[0] };
+    const float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (det == 0.0f)
+        return false;
+
+    const float inverse = 1.0f / det;
+    const float s[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+    const float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    const float q[3] = { s[1] * e1[2] - s[2] * e1[1],
+                         s[2] * e1[0] - s[0] * e1[2],
+                         s[0] * e1[1] - s[1] * e1[0] };
+    const float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+    return t > 0.0f;
+}
+
+} // namespace
+
+// Copies the mesh into flat arrays and builds the hierarchy over the triangle boxes
+MeshBvh::MeshBvh(vtkPolyData* mesh) {
+    vtkPoints* points = mesh->GetPoints();
+    vtkCellArray* polys = mesh->GetPolys();
+    if (!points || !polys)
+        return;
+
+    const vtkIdType pointCount = points->GetNumberOfPoints();
+    positions.resize(3 * size_t(pointCount));
+    if (vtkFloatArray* coords = vtkFloatArray::FastDownCast(points->GetData())) {
+        std::memcpy(positions.data(), coords->GetPointer(0), positions.size() * sizeof(float));
+    }
+    else {
+        double point[3];
+        for (vtkIdType i = 0; i < pointCount; ++i) {
+            points->GetPoint(i, point);
+            for (int axis = 0; axis < 3; ++axis)
+                positions[3 * size_t(i) + axis] = float(point[axis]);
+        }
+    }
+
+    // An iterator of its own keeps the traversal safe next to readers on other threads
+    std::vector<uint32_t> unordered;
+    unordered.reserve(3 * size_t(polys->GetNumberOfCells()));
+    vtkSmartPointer<vtkCellArrayIterator> cell = vtk::TakeSmartPointer(polys->NewIterator());
+    for (cell->GoToFirstCell(); !cell->IsDoneWithTraversal(); cell->GoToNextCell()) {
+        vtkIdType size;
+        const vtkIdType* ids;
+        cell->GetCurrentCell(size, ids);
+        for (vtkIdType i = 2; i < size; ++i) {
+            unordered.push_back(uint32_t(ids[0]));
+            unordered.push_back(uint32_t(ids[i - 1]));
+            unordered.push_back(uint32_t(ids[i]));
+        }
+    }
+
+    const size_t triangles = unordered.size() / 3;
+    std::vector<float> boxes(6 * triangles);
+    for (size_t t = 0; t < triangles; ++t) {
+        float* box = &boxes[6 * t];
+        const float* a = &positions[3 * size_t(unordered[3 * t])];
+        std::copy(a, a + 3, box);
+        std::copy(a, a + 3, box + 3);
+        for (int corner = 1; corner < 3; ++corner) {
+            const float* p = &positions[3 * size_t(unordered[3 * t + corner])];
+            for (int axis = 0; axis < 3; ++axis) {
+                box[axis] = std::min(box[axis], p[axis]);
+                box[3 + axis] = std::max(box[3 + axis], p[axis]);
+            }
+        }
+    }
+
+    bvh.build(boxes);
+
+    // Triangles of a leaf end up next to each other
+    const std::vector<uint32_t>& order = bvh.leafOrder();
+    corners.resize(unordered.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        std::copy(&unordered[3 * size_t(order[i])], &unordered[3 * size_t(order[i])] + 3, &corners[3 * i]);
+    bvh.releaseLeafOrder();
+}
+
+// Walks the leaves nearest first, each hit shortens the ray so farther leaves are skipped
+bool MeshBvh::intersect(const float origin[3], const float direction[3], float& distance) const {
+    bool hit = false;
+    bvh.traverse(origin, direction, distance, [&](uint32_t position, float& tMax) {
+        const uint32_t* triangle = &corners[3 * size_t(position)];
+        float t;
+        if (rayTriangle(origin, direction, &positions[3 * size_t(triangle[0])], &positions[3 * size_t(triangle[1])],
+                        &positions[3 * size_t(triangle[2])], t) && t < tMax) {
+            tMax = t;
+            hit = true;
+        }
+    });
+    return hit;
+}
+
+qint64 MeshBvh::memoryBytes() const {
+    return qint64(bvh.memoryBytes() + positions.capacity() * sizeof(float) + corners.capacity() * sizeof(uint32_t));
+}
+
+qint64 MeshBvh::triangleCount() const {
+    return qint64(corners.size() / 3);
+}
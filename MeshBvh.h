@@ -0,0 +1,48 @@
+#ifndef VIEWER_MESHBVH_H
+#define VIEWER_MESHBVH_H
+
+#include "Bvh.h"
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <vector>
+
+#include <vtkPolyData.h>
+
+/* Triangle hierarchy of one mesh, used to find where a ray first hits it.
+ * The positions are copied as floats and the triangles are stored in the hierarchy's leaf order,
+ * so a query never touches the VTK arrays and the structure stays valid (and can be shared by
+ * every part using the mesh) independently of the polydata. Polygons with more than three
+ * corners are split into fans.
+ */
+class MeshBvh {
+public:
+    /** Build the hierarchy, safe to call on a worker thread while the mesh is not modified
+      * @param mesh is in the frame the rays will be given in
+      */
+    explicit MeshBvh(vtkPolyData* mesh);
+
+    /** Find the nearest intersection along a ray
+      * @param origin, direction define the ray in the mesh's frame, the direction need not be normalised
+      * @param distance is the furthest distance to look on input, in units of the direction's length,
+      *        and is lowered to the nearest hit
+      * @return true if the ray hits a triangle closer than the distance given
+      */
+    bool intersect(const float origin[3], const float direction[3], float& distance) const;
+
+    /** @return the memory held by the hierarchy, positions and triangles in bytes
+      */
+    qint64 memoryBytes() const;
+
+    /** @return the number of triangles
+      */
+    qint64 triangleCount() const;
+
+private:
+    Bvh bvh;
+    std::vector<float> positions;       /**< xyz per vertex */
+    std::vector<uint32_t> corners;      /**< Three vertex indices per triangle, in leaf order */
+};
+
+#endif // VIEWER_MESHBVH_H
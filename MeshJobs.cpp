@@ -0,0 +1,38 @@
+// Header file for this class
+#include "MeshJobs.h"
+
+// Q includes
+#include <QThread>
+
+#include <algorithm>
+
+// Constructor
+MeshJobs::MeshJobs(QObject* context)
+    : context(context), state(std::make_shared<State>()), cancelled(std::make_shared<std::atomic<bool>>(false)) {
+}
+
+// Destructor - jobs still queued find the state stopped and return without touching the context
+MeshJobs::~MeshJobs() {
+    *cancelled = true;
+
+    QMutexLocker lock(&state->mutex);
+    state->stopped = true;
+    while (state->running > 0)
+        state->idle.wait(&state->mutex);
+}
+
+// Jobs keep the token they were started with, later jobs get a fresh one
+void MeshJobs::cancel() {
+    *cancelled = true;
+    cancelled = std::make_shared<std::atomic<bool>>(false);
+}
+
+// One core is left free for the GUI thread. The pool is never destroyed, so no generator can outlive it
+QThreadPool* MeshJobs::pool() {
+    static QThreadPool* shared = []() {
+        QThreadPool* pool = new QThreadPool();
+        pool->setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+        return pool;
+    }();
+    return shared;
+}
@@ -0,0 +1,185 @@
+#ifndef VIEWER_MESHJOBS_H
+#define VIEWER_MESHJOBS_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include <vtkPolyData.h>
+#include <vtkWeakPointer.h>
+
+class ModelPart;
+
+/* Runs the background jobs of one generator (levels of detail, picking hierarchies, smooth meshes,
+ * compact copies) on the pool that all of them share. The pool has a thread per core but one, so
+ * however many generators are busy at once their jobs never take more cores than that. PartLoader
+ * reads files on pools of its own, which these jobs share the cores with while a folder loads.
+ * Each job's result is handed back on the GUI thread unless cancel() was called after the job was
+ * started. Cancelled jobs are not taken out of the shared pool, they skip their work when they start.
+ */
+class MeshJobs {
+public:
+    /** Constructor
+      * @param context receives the results, on its own thread
+      */
+    explicit MeshJobs(QObject* context);
+
+    /** Destructor - cancels every job and waits for the ones already running
+      */
+    ~MeshJobs();
+
+    /** Queue a job
+      * @param work is called on the pool and returns the result
+      * @param deliver is called with the result on the context's thread, not at all if cancelled first
+      */
+    template <typename Work, typename Deliver>
+    void start(Work work, Deliver deliver);
+
+    /** Drop the output of every job started so far, jobs that have not begun are skipped
+      */
+    void cancel();
+
+    /** @return the pool shared by every generator
+      */
+    static QThreadPool* pool();
+
+private:
+    /* Jobs in progress, so the destructor can wait for them without waiting on the whole pool */
+    struct State {
+        QMutex mutex;
+        QWaitCondition idle;
+        int running = 0;
+        bool stopped = false;
+    };
+
+    QObject* context;
+    std::shared_ptr<State> state;
+    std::shared_ptr<std::atomic<bool>> cancelled;
+};
+
+/* What a generator knows about each distinct mesh: the parts waiting for its job and the finished
+ * result. Results are keyed by mesh address and hold the mesh weakly, so they never keep a
+ * released mesh alive; a dead mesh means its address may have been reused and the entry is stale.
+ * GUI thread only.
+ */
+template <typename T>
+class MeshResults {
+public:
+    struct Entry {
+        vtkWeakPointer<vtkPolyData> mesh;
+        T value;
+    };
+
+    /** Add a part to those waiting for a mesh
+      * @return true if nothing waited for the mesh yet, so its job has to be started
+      */
+    bool addWaiting(vtkPolyData* mesh, ModelPart* part) {
+        const bool first = !waiting.contains(mesh);
+        waiting[mesh].append(part);
+        return first;
+    }
+
+    /** @return the parts waiting for a mesh
+      */
+    QList<ModelPart*> waitingFor(vtkPolyData* mesh) const { return waiting.value(mesh); }
+
+    /** Remove and return the parts waiting for a mesh, usually when its result arrives
+      */
+    QList<ModelPart*> takeWaiting(vtkPolyData* mesh) { return waiting.take(mesh); }
+
+    /** Forget a part that is about to be deleted, in whichever list it waits
+      */
+    void removeWaiting(ModelPart* part) {
+        for (QList<ModelPart*>& parts : waiting)
+            parts.removeAll(part);
+    }
+
+    bool hasWaiting() const { return !waiting.isEmpty(); }
+
+    /** @return the result for a mesh, null if there is none or the mesh it was made for is gone
+      */
+    const T* find(vtkPolyData* mesh) {
+        auto it = results.find(mesh);
+        if (it == results.end())
+            return nullptr;
+        if (!it->mesh) {
+            results.erase(it);
+            return nullptr;
+        }
+        return &it->value;
+    }
+
+    void insert(vtkPolyData* mesh, const T& value) {
+        results.insert(mesh, Entry{ mesh, value });
+    }
+
+    /** Drop the results whose mesh is gone, and those the predicate picks
+      */
+    template <typename Pred>
+    void prune(Pred stale) {
+        for (auto it = results.begin(); it != results.end();) {
+            if (!it->mesh || stale(it->value))
+                it = results.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void prune() {
+        prune([](const T&) { return false; });
+    }
+
+    /** Drop the results, the waiting parts stay
+      */
+    void clearResults() { results.clear(); }
+
+    void clear() {
+        waiting.clear();
+        results.clear();
+    }
+
+    typename QHash<vtkPolyData*, Entry>::const_iterator begin() const { return results.constBegin(); }
+    typename QHash<vtkPolyData*, Entry>::const_iterator end() const { return results.constEnd(); }
+
+private:
+    QHash<vtkPolyData*, QList<ModelPart*>> waiting;
+    QHash<vtkPolyData*, Entry> results;
+};
+
+// The job counts itself as running only once it is past the cancel check, so a cancelled job that
+// starts late never touches the context
+template <typename Work, typename Deliver>
+void MeshJobs::start(Work work, Deliver deliver) {
+    std::shared_ptr<State> jobState = state;
+    std::shared_ptr<std::atomic<bool>> token = cancelled;
+    QObject* target = context;
+    pool()->start([jobState, token, target, work, deliver]() mutable {
+        {
+            QMutexLocker lock(&jobState->mutex);
+            if (jobState->stopped || *token)
+                return;
+            ++jobState->running;
+        }
+
+        auto result = work();
+
+        // Hand the result back to the GUI thread, dropped if the jobs were cancelled by then
+        QMetaObject::invokeMethod(target, [token, deliver, result]() mutable {
+            if (!*token)
+                deliver(std::move(result));
+        }, Qt::QueuedConnection);
+
+        QMutexLocker lock(&jobState->mutex);
+        if (--jobState->running == 0)
+            jobState->idle.wakeAll();
+    });
+}
+
+#endif // VIEWER_MESHJOBS_H
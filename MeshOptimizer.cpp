@@ -0,0 +1,274 @@
+// Header file for this class
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Forsyth's scoring constants, from "Linear-Speed Vertex Cache Optimisation"
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+// Valences above this all get the boost of this one, it is already close to nothing
+const uint32_t MAX_SCORED_VALENCE = 64;
+
+/* Vertex scores only depend on the cache position and the triangles left, so they are looked up */
+class ScoreTable {
+public:
+    ScoreTable() {
+        for (int position = 0; position < MeshOptimizer::CACHE_SIZE; ++position) {
+            if (position < 3)
+                cacheScores[position] = LAST_TRIANGLE_SCORE;
+            else
+                cacheScores[position] = std::pow(1.0f - float(position - 3) / float(MeshOptimizer::CACHE_SIZE - 3),
+                                                 CACHE_DECAY_POWER);
+        }
+        valenceScores[0] = 0.0f;
+        for (uint32_t valence = 1; valence <= MAX_SCORED_VALENCE; ++valence)
+            valenceScores[valence] = VALENCE_BOOST_SCALE * std::pow(float(valence), -VALENCE_BOOST_POWER);
+    }
+
+    // A vertex with no triangles left scores below every other so it leaves the cache first
+    float score(int cachePosition, uint32_t remaining) const {
+        if (remaining == 0)
+            return -1.0f;
+        const float cache = cachePosition >= 0 ? cacheScores[cachePosition] : 0.0f;
+        return cache + valenceScores[std::min(remaining, MAX_SCORED_VALENCE)];
+    }
+
+private:
+    float cacheScores[MeshOptimizer::CACHE_SIZE];
+    float valenceScores[MAX_SCORED_VALENCE + 1];
+};
+
+// Greedy triangle order: always the best scoring triangle touching the cache, the next unused one at dead ends
+std::vector<uint32_t> vertexCacheOrder(const uint32_t* indices, size_t triangleCount, size_t vertexCount) {
+    static const ScoreTable table;
+    const size_t corners = 3 * triangleCount;
+
+    // Triangles of each vertex, the live ones are kept at the front of each vertex's range
+    std::vector<uint32_t> first(vertexCount + 1, 0);
+    for (size_t i = 0; i < corners; ++i)
+        ++first[indices[i] + 1];
+    for (size_t v = 0; v < vertexCount; ++v)
+        first[v + 1] += first[v];
+
+    std::vector<uint32_t> adjacency(corners);
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < corners; ++i) {
+        const uint32_t v = indices[i];
+        adjacency[first[v] + remaining[v]++] = uint32_t(i / 3);
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScore[v] = table.score(-1, remaining[v]);
+
+    std::vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<uint32_t> order;
+    order.reserve(corners);
+
+    std::vector<uint32_t> cache, nextCache;
+    cache.reserve(MeshOptimizer::CACHE_SIZE + 3);
+    nextCache.reserve(MeshOptimizer::CACHE_SIZE + 3);
+    size_t cursor = 0;
+    size_t best = 0;
+    bool haveBest = false;
+
+    for (size_t count = 0; count < triangleCount; ++count) {
+        if (!haveBest) {
+            while (emitted[cursor])
+                ++cursor;
+            best = cursor;
+        }
+
+        emitted[best] = 1;
+        const uint32_t* corner = indices + 3 * best;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = corner[k];
+            order.push_back(v);
+
+            // Swap the triangle out of the vertex's live range
+            uint32_t* live = &adjacency[first[v]];
+            for (uint32_t i = 0; i < remaining[v]; ++i) {
+                if (live[i] == best) {
+                    std::swap(live[i], live[remaining[v] - 1]);
+                    --remaining[v];
+                    break;
+                }
+            }
+        }
+
+        // The triangle's vertices move to the front, the oldest entries fall off the end
+        nextCache.assign(corner, corner + 3);
+        for (uint32_t v : cache) {
+            if (v != corner[0] && v != corner[1] && v != corner[2])
+                nextCache.push_back(v);
+        }
+
+        for (size_t i = 0; i < nextCache.size(); ++i) {
+            const uint32_t v = nextCache[i];
+            cachePosition[v] = i < size_t(MeshOptimizer::CACHE_SIZE) ? int(i) : -1;
+
+            const float score = table.score(cachePosition[v], remaining[v]);
+            const float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+            for (uint32_t j = 0; j < remaining[v]; ++j)
+                triangleScore[adjacency[first[v] + j]] += delta;
+        }
+        if (nextCache.size() > size_t(MeshOptimizer::CACHE_SIZE))
+            nextCache.resize(MeshOptimizer::CACHE_SIZE);
+        cache.swap(nextCache);
+
+        // Only triangles of cached vertices changed, the best next one is among them
+        haveBest = false;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (uint32_t v : cache) {
+            for (uint32_t j = 0; j < remaining[v]; ++j) {
+                const uint32_t t = adjacency[first[v] + j];
+                if (triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    best = t;
+                    haveBest = true;
+                }
+            }
+        }
+    }
+
+    return order;
+}
+
+// Cuts the cache order where the cache starts over and draws the outward facing clusters first
+std::vector<uint32_t> overdrawOrder(const std::vector<uint32_t>& order, const float* xyz, size_t vertexCount) {
+    const size_t triangleCount = order.size() / 3;
+
+    // Same FIFO as cacheMissRatio(), a vertex is cached while fewer than CACHE_SIZE misses followed it
+    std::vector<uint32_t> clusterStart;
+    std::vector<uint64_t> missedAt(vertexCount, 0);
+    uint64_t misses = MeshOptimizer::CACHE_SIZE + 1;
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int triangleMisses = 0;
+        for (int k = 0; k < 3; ++k) {
+            const uint32_t v = order[3 * t + k];
+            if (misses - missedAt[v] > uint64_t(MeshOptimizer::CACHE_SIZE)) {
+                missedAt[v] = misses++;
+                ++triangleMisses;
+            }
+        }
+        if (t == 0 || triangleMisses == 3)
+            clusterStart.push_back(uint32_t(t));
+    }
+    clusterStart.push_back(uint32_t(triangleCount));
+
+    // Area weighted centroid and normal of every cluster and of the whole mesh
+    const size_t clusterCount = clusterStart.size() - 1;
+    std::vector<double> clusterCentroid(3 * clusterCount, 0.0);
+    std::vector<double> clusterNormal(3 * clusterCount, 0.0);
+    double meshCentroid[3] = { 0.0, 0.0, 0.0 };
+    double meshArea = 0.0;
+    for (size_t c = 0; c < clusterCount; ++c) {
+        double area = 0.0;
+        for (uint32_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            const float* a = xyz + 3 * size_t(order[3 * t]);
+            const float* b = xyz + 3 * size_t(order[3 * t + 1]);
+            const float* p = xyz + 3 * size_t(order[3 * t + 2]);
+            const double u[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+            const double w[3] = { double(p[0]) - a[0], double(p[1]) - a[1], double(p[2]) - a[2] };
+            const double n[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+            const double twiceArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; ++k) {
+                clusterCentroid[3 * c + k] += twiceArea * (double(a[k]) + b[k] + p[k]) / 3.0;
+                clusterNormal[3 * c + k] += n[k];
+            }
+            area += twiceArea;
+        }
+
+        for (int k = 0; k < 3; ++k)
+            meshCentroid[k] += clusterCentroid[3 * c + k];
+        meshArea += area;
+        if (area > 0.0) {
+            for (int k = 0; k < 3; ++k)
+                clusterCentroid[3 * c + k] /= area;
+        }
+    }
+    if (meshArea > 0.0) {
+        for (int k = 0; k < 3; ++k)
+            meshCentroid[k] /= meshArea;
+    }
+
+    // How far a cluster faces away from the centre, the larger the sooner it is drawn
+    std::vector<double> facing(clusterCount, 0.0);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        const double* n = &clusterNormal[3 * c];
+        const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0) {
+            for (int k = 0; k < 3; ++k)
+                facing[c] += (clusterCentroid[3 * c + k] - meshCentroid[k]) * n[k] / length;
+        }
+    }
+
+    std::vector<uint32_t> clusters(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+        clusters[c] = uint32_t(c);
+    std::stable_sort(clusters.begin(), clusters.end(), [&](uint32_t a, uint32_t b) { return facing[a] > facing[b]; });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(order.size());
+    for (uint32_t c : clusters)
+        sorted.insert(sorted.end(), order.begin() + 3 * size_t(clusterStart[c]), order.begin() + 3 * size_t(clusterStart[c + 1]));
+    return sorted;
+}
+
+} // namespace
+
+// Cache order, then cluster order, then vertices renumbered by first use
+MeshOptimizer::Result MeshOptimizer::optimise(const uint32_t* indices, size_t triangleCount, const float* xyz,
+                                              size_t vertexCount) {
+    Result result;
+    result.indices = overdrawOrder(vertexCacheOrder(indices, triangleCount, vertexCount), xyz, vertexCount);
+
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> newIndex(vertexCount, unused);
+    result.vertexOrder.reserve(vertexCount);
+    for (uint32_t& corner : result.indices) {
+        if (newIndex[corner] == unused) {
+            newIndex[corner] = uint32_t(result.vertexOrder.size());
+            result.vertexOrder.push_back(corner);
+        }
+        corner = newIndex[corner];
+    }
+
+    for (size_t v = 0; v < vertexCount; ++v) {
+        if (newIndex[v] == unused)
+            result.vertexOrder.push_back(uint32_t(v));
+    }
+
+    return result;
+}
+
+// FIFO replacement, as in the usual ACMR figures
+double MeshOptimizer::cacheMissRatio(const uint32_t* indices, size_t triangleCount, size_t vertexCount, int cacheSize) {
+    if (triangleCount == 0)
+        return 0.0;
+
+    std::vector<uint64_t> missedAt(vertexCount, 0);
+    uint64_t misses = uint64_t(cacheSize) + 1;
+    const uint64_t start = misses;
+    for (size_t i = 0; i < 3 * triangleCount; ++i) {
+        const uint32_t v = indices[i];
+        if (misses - missedAt[v] > uint64_t(cacheSize))
+            missedAt[v] = misses++;
+    }
+
+    return double(misses - start) / double(triangleCount);
+}
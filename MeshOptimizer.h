@@ -0,0 +1,53 @@
+#ifndef VIEWER_MESHOPTIMIZER_H
+#define VIEWER_MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Reorders an indexed triangle mesh so the GPU draws it with less work. STL files list their
+ * triangles in whatever order the exporter produced, which reuses few transformed vertices and
+ * draws hidden faces before the ones covering them.
+ * Three passes run one after the other:
+ *  - triangles are ordered for the post-transform vertex cache with Forsyth's greedy scoring,
+ *    which prefers triangles whose vertices were used recently and vertices with few triangles left
+ *  - the result is cut into clusters where the simulated cache starts over (a triangle with three
+ *    new vertices), and clusters facing away from the mesh centre are drawn first so they hide
+ *    the inner ones, which keeps the cache order inside each cluster
+ *  - vertices are renumbered in the order the triangles first use them, so vertex fetches walk
+ *    memory forwards
+ * The output depends only on the input, so identical parts still produce identical meshes.
+ */
+class MeshOptimizer {
+public:
+    /** Entries of the simulated post-transform cache, about what current GPUs keep per batch */
+    static const int CACHE_SIZE = 32;
+
+    /** Reordered mesh */
+    struct Result {
+        std::vector<uint32_t> indices;      /**< Triangle corners in the new order, using the new vertex numbers */
+        std::vector<uint32_t> vertexOrder;  /**< New vertex -> old vertex, unused vertices are kept at the end */
+    };
+
+    /** Reorder a triangle mesh
+      * @param indices points at triangleCount x 3 corner indices
+      * @param triangleCount is the number of triangles
+      * @param xyz points at vertexCount packed x,y,z float triples, used to order the clusters
+      * @param vertexCount is the number of vertices, must be below 2^32
+      * @return the new triangle list and vertex order
+      */
+    static Result optimise(const uint32_t* indices, size_t triangleCount, const float* xyz, size_t vertexCount);
+
+    /** Average cache miss ratio of a triangle order, the number of vertices transformed per triangle
+      *  with a FIFO cache. 3 means no reuse, about 0.5 to 0.7 is the best a closed mesh allows
+      * @param indices points at triangleCount x 3 corner indices
+      * @param triangleCount is the number of triangles
+      * @param vertexCount is one more than the largest index
+      * @param cacheSize is the number of cache entries
+      * @return the misses divided by the triangle count, 0 for an empty mesh
+      */
+    static double cacheMissRatio(const uint32_t* indices, size_t triangleCount, size_t vertexCount,
+                                 int cacheSize = CACHE_SIZE);
+};
+
+#endif // VIEWER_MESHOPTIMIZER_H
@@ -0,0 +1,317 @@
+// Header file for this class
+#include "MeshWelder.h"
+#include "ParallelFor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace {
+
+// Below this many vertices per thread the welding runs on the calling thread only
+const size_t MIN_VERTICES_PER_CHUNK = 1 << 16;
+
+// Marks an empty slot in a shard's hash table
+const uint32_t EMPTY_SLOT = 0xFFFFFFFFu;
+
+// Position key of a vertex, float bit patterns or grid cell coordinates
+struct Key {
+    int64_t x, y, z;
+
+    bool operator==(const Key& other) const {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+// Bit pattern of a float with -0 folded onto +0 so they weld together
+int64_t floatBits(float value) {
+    if (value == 0.0f)
+        value = 0.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Builds the exact key of a soup vertex
+struct KeyFunction {
+    const float* xyz;
+
+    Key operator()(size_t vertex) const {
+        const float* p = xyz + 3 * vertex;
+        return { floatBits(p[0]), floatBits(p[1]), floatBits(p[2]) };
+    }
+};
+
+// Cell coordinates are clamped to +-2^62 so the cast is defined and a neighbouring cell cannot overflow.
+// Points past the limit share the edge cells, which only costs extra distance tests
+const double CELL_LIMIT = 4611686018427387904.0;
+
+// Grid cell along one axis, NaN goes to cell 0 where its distance test never passes
+int64_t cellCoordinate(double scaled) {
+    if (std::isnan(scaled))
+        return 0;
+    return static_cast<int64_t>(std::floor(std::min(std::max(scaled, -CELL_LIMIT), CELL_LIMIT)));
+}
+
+// Grid cell of a position
+Key cellOf(const float* p, double inverseCell) {
+    return { cellCoordinate(p[0] * inverseCell),
+             cellCoordinate(p[1] * inverseCell),
+             cellCoordinate(p[2] * inverseCell) };
+}
+
+// 64 bit mix of the three key components (splitmix64 finaliser)
+uint64_t hashKey(const Key& key) {
+    uint64_t h = static_cast<uint64_t>(key.x) * 0x9E3779B97F4A7C15ull;
+    h ^= static_cast<uint64_t>(key.y) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2);
+    h ^= static_cast<uint64_t>(key.z) + 0x85EBCA77C2B2AE63ull + (h << 6) + (h >> 2);
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+size_t nextPowerOfTwo(size_t value) {
+    size_t power = 1;
+    while (power < value)
+        power <<= 1;
+    return power;
+}
+
+/* Merges distinct positions that lie within the tolerance of an earlier kept one, in file order.
+ * Cells are twice the tolerance wide, so a point within the tolerance lies in the point's own
+ * cell or, along each axis, in the neighbour on the side of the cell half the point is in: eight
+ * cells in all. Points on either side of a cell boundary still merge and points further apart never do.
+ * Positions are sorted by cell hash so each cell is a run of the sorted list found through a
+ * small open addressing table, and runs are in file order so the earliest kept match comes first.
+ * Returns the kept position of each input position and fills kept with their sources.
+ */
+std::vector<uint32_t> mergeWithinTolerance(const float* xyz, const std::vector<uint32_t>& sources, double tolerance,
+                                           std::vector<uint32_t>& kept) {
+    const size_t count = sources.size();
+    const double inverseCell = 0.5 / tolerance;
+    const double squaredTolerance = tolerance * tolerance;
+
+    std::vector<Key> cells(count);
+    std::vector<uint64_t> cellHashes(count);
+    for (size_t i = 0; i < count; ++i) {
+        cells[i] = cellOf(xyz + 3 * size_t(sources[i]), inverseCell);
+        cellHashes[i] = hashKey(cells[i]);
+    }
+
+    std::vector<uint32_t> byCell(count);
+    std::iota(byCell.begin(), byCell.end(), 0u);
+    std::sort(byCell.begin(), byCell.end(), [&](uint32_t a, uint32_t b) {
+        return cellHashes[a] != cellHashes[b] ? cellHashes[a] < cellHashes[b] : a < b;
+    });
+
+    // Start of each hash run in byCell
+    const size_t mask = nextPowerOfTwo(count * 2) - 1;
+    std::vector<uint32_t> runStart(mask + 1, EMPTY_SLOT);
+    for (size_t k = 0; k < count; ++k) {
+        const uint64_t hash = cellHashes[byCell[k]];
+        if (k > 0 && cellHashes[byCell[k - 1]] == hash)
+            continue;
+        size_t slot = hash & mask;
+        while (runStart[slot] != EMPTY_SLOT)
+            slot = (slot + 1) & mask;
+        runStart[slot] = static_cast<uint32_t>(k);
+    }
+
+    std::vector<uint32_t> mergedInto(count, EMPTY_SLOT);
+    std::vector<uint32_t> keptId(count, EMPTY_SLOT);
+    kept.clear();
+    for (size_t i = 0; i < count; ++i) {
+        const float* p = xyz + 3 * size_t(sources[i]);
+        const Key& cell = cells[i];
+        int64_t side[3];
+        for (int k = 0; k < 3; ++k) {
+            const double scaled = p[k] * inverseCell;
+            side[k] = scaled - std::floor(scaled) < 0.5 ? -1 : 1;
+        }
+
+        uint32_t match = EMPTY_SLOT;
+        for (int64_t dx = 0; dx != 2 * side[0]; dx += side[0]) {
+            for (int64_t dy = 0; dy != 2 * side[1]; dy += side[1]) {
+                for (int64_t dz = 0; dz != 2 * side[2]; dz += side[2]) {
+                    const Key neighbour = { cell.x + dx, cell.y + dy, cell.z + dz };
+                    const uint64_t hash = hashKey(neighbour);
+                    size_t slot = hash & mask;
+                    while (runStart[slot] != EMPTY_SLOT && cellHashes[byCell[runStart[slot]]] != hash)
+                        slot = (slot + 1) & mask;
+                    if (runStart[slot] == EMPTY_SLOT)
+                        continue;
+
+                    // Only positions before this one can have been kept, the first in range is the earliest
+                    for (size_t k = runStart[slot]; k < count && cellHashes[byCell[k]] == hash; ++k) {
+                        const uint32_t candidate = byCell[k];
+                        if (candidate >= i)
+                            break;
+                        if (keptId[candidate] == EMPTY_SLOT || !(cells[candidate] == neighbour))
+                            continue;
+
+                        const float* q = xyz + 3 * size_t(sources[candidate]);
+                        const double ex = double(p[0]) - q[0], ey = double(p[1]) - q[1], ez = double(p[2]) - q[2];
+                        if (ex * ex + ey * ey + ez * ez <= squaredTolerance) {
+                            match = std::min(match, keptId[candidate]);
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+
+        if (match == EMPTY_SLOT) {
+            match = static_cast<uint32_t>(kept.size());
+            keptId[i] = match;
+            kept.push_back(sources[i]);
+        }
+        mergedInto[i] = match;
+    }
+
+    return mergedInto;
+}
+
+} // namespace
+
+// Welds the soup in four parallel passes: hash, bucket by shard, resolve shards, number vertices
+MeshWelder::Result MeshWelder::weld(const float* xyz, size_t vertexCount, const Options& options) {
+    Result result;
+    const size_t n = vertexCount;
+    if (n == 0)
+        return result;
+
+    if (options.mode == Mode::Off) {
+        result.remap.resize(n);
+        std::iota(result.remap.begin(), result.remap.end(), 0u);
+        result.uniqueSource = result.remap;
+        return result;
+    }
+
+    // Identical corners are merged first in parallel, only the distinct positions are compared by distance.
+    // A tolerance that is not positive, or too small to size the grid cells with, welds exactly
+    const bool usableTolerance = options.tolerance > 0.0 && std::isfinite(0.5 / options.tolerance);
+    if (options.mode == Mode::Tolerance && usableTolerance) {
+        Options exact;
+        exact.mode = Mode::Exact;
+        Result exactResult = weld(xyz, n, exact);
+
+        std::vector<uint32_t> kept;
+        const std::vector<uint32_t> mergedInto = mergeWithinTolerance(xyz, exactResult.uniqueSource, options.tolerance, kept);
+        const size_t chunks = parallelChunkCount(n, MIN_VERTICES_PER_CHUNK);
+        parallelFor(n, chunks, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                exactResult.remap[i] = mergedInto[exactResult.remap[i]];
+        });
+        exactResult.uniqueSource.swap(kept);
+        return exactResult;
+    }
+
+    const KeyFunction key{ xyz };
+    const size_t chunks = parallelChunkCount(n, MIN_VERTICES_PER_CHUNK);
+    const size_t shards = chunks > 1 ? nextPowerOfTwo(chunks * 8) : 1;
+
+    // Shards come from the high hash bits, table slots from the low bits
+    auto shardOf = [shards](uint64_t hash) { return static_cast<size_t>(hash >> 40) & (shards - 1); };
+
+    // Pass 1: hash every vertex and count how many land in each shard per chunk
+    std::vector<uint64_t> hashes(n);
+    std::vector<size_t> counts(chunks * shards, 0);
+    parallelFor(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        size_t* count = &counts[chunk * shards];
+        for (size_t i = begin; i < end; ++i) {
+            hashes[i] = hashKey(key(i));
+            ++count[shardOf(hashes[i])];
+        }
+    });
+
+    // Turn counts into write positions, chunks are laid out in order inside each shard
+    std::vector<size_t> shardStart(shards + 1, 0);
+    size_t position = 0;
+    for (size_t shard = 0; shard < shards; ++shard) {
+        shardStart[shard] = position;
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            const size_t count = counts[chunk * shards + shard];
+            counts[chunk * shards + shard] = position;
+            position += count;
+        }
+    }
+    shardStart[shards] = position;
+
+    // Pass 2: bucket vertex indices by shard, each shard stays in ascending file order
+    std::vector<uint32_t> order(n);
+    parallelFor(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        size_t* write = &counts[chunk * shards];
+        for (size_t i = begin; i < end; ++i)
+            order[write[shardOf(hashes[i])]++] = static_cast<uint32_t>(i);
+    });
+
+    // Pass 3: resolve each shard with its own open addressing table, remap holds the representative
+    result.remap.resize(n);
+    parallelFor(shards, chunks, [&](size_t, size_t firstShard, size_t lastShard) {
+        std::vector<uint32_t> table;
+        for (size_t shard = firstShard; shard < lastShard; ++shard) {
+            const size_t size = shardStart[shard + 1] - shardStart[shard];
+            const size_t mask = nextPowerOfTwo(size * 2) - 1;
+            table.assign(mask + 1, EMPTY_SLOT);
+
+            for (size_t k = shardStart[shard]; k < shardStart[shard + 1]; ++k) {
+                const uint32_t vertex = order[k];
+                const uint64_t hash = hashes[vertex];
+                size_t slot = hash & mask;
+
+                while (true) {
+                    const uint32_t stored = table[slot];
+                    if (stored == EMPTY_SLOT) {
+                        table[slot] = vertex;
+                        result.remap[vertex] = vertex;
+                        break;
+                    }
+                    if (hashes[stored] == hash && key(stored) == key(vertex)) {
+                        result.remap[vertex] = stored;
+                        break;
+                    }
+                    slot = (slot + 1) & mask;
+                }
+            }
+        }
+    });
+
+    order.clear();
+    order.shrink_to_fit();
+    hashes.clear();
+    hashes.shrink_to_fit();
+
+    // Pass 4: number the representatives in file order, then point every vertex at its number
+    std::vector<size_t> firstId(chunks + 1, 0);
+    parallelFor(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        size_t unique = 0;
+        for (size_t i = begin; i < end; ++i)
+            unique += result.remap[i] == i;
+        firstId[chunk + 1] = unique;
+    });
+    std::partial_sum(firstId.begin(), firstId.end(), firstId.begin());
+
+    std::vector<uint32_t> ids(n);
+    result.uniqueSource.resize(firstId[chunks]);
+    parallelFor(n, chunks, [&](size_t chunk, size_t begin, size_t end) {
+        size_t id = firstId[chunk];
+        for (size_t i = begin; i < end; ++i) {
+            if (result.remap[i] == i) {
+                ids[i] = static_cast<uint32_t>(id);
+                result.uniqueSource[id] = static_cast<uint32_t>(i);
+                ++id;
+            }
+        }
+    });
+
+    parallelFor(n, chunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            result.remap[i] = ids[result.remap[i]];
+    });
+
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef VIEWER_MESHWELDER_H
+#define VIEWER_MESHWELDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Merges the duplicated corners of an STL triangle soup into shared vertices.
+ * Vertices are hashed on the exact bit pattern of their position and the hash space is split
+ * into shards that are resolved on separate threads. The first vertex (in file order) that lands
+ * on a key becomes the shared vertex, so the output is the same whatever the thread count.
+ * Tolerance welding then merges the distinct positions in file order: each one joins the
+ * earliest kept position within the tolerance, found through a grid of cells twice the
+ * tolerance wide, or is kept itself. Every merged corner is within the tolerance of its shared
+ * vertex, whichever side of a cell boundary it is on. This last pass runs on one thread.
+ */
+class MeshWelder {
+public:
+    /** How vertices are compared */
+    enum class Mode {
+        Off,            /**< Keep every corner as its own vertex */
+        Exact,          /**< Merge corners with bitwise identical coordinates */
+        Tolerance       /**< Merge corners within the tolerance of an earlier kept corner */
+    };
+
+    /** User selectable welding settings */
+    struct Options {
+        Mode mode = Mode::Exact;
+        double tolerance = 1.0e-4;  /**< Largest merge distance in model units, used by Mode::Tolerance. Mode::Exact is used if it is not positive */
+        bool optimiseOrder = false; /**< Reorder the welded mesh for the GPU afterwards, see MeshOptimizer */
+    };
+
+    /** Mapping from the soup to the welded vertex set */
+    struct Result {
+        std::vector<uint32_t> remap;        /**< Soup vertex -> welded vertex */
+        std::vector<uint32_t> uniqueSource; /**< Welded vertex -> first soup vertex with that key */
+    };
+
+    /** Weld a triangle soup
+      * @param xyz points at vertexCount packed x,y,z float triples
+      * @param vertexCount is the number of soup vertices, must be below 2^32
+      * @param options selects exact or tolerance welding, Mode::Off returns an identity mapping
+      * @return the remap table and the source vertex of each welded vertex
+      */
+    static Result weld(const float* xyz, size_t vertexCount, const Options& options);
+};
+
+#endif // VIEWER_MESHWELDER_H
@@ -1,5 +1,12 @@
 // Header file for this class
 #include "ModelPart.h"
+#include "MappedSTLReader.h"
+#include "MeshOptimizer.h"
+#include "LoadProfiler.h"
+#include "VRRenderThread.h"
+
+// Q includes
+#include <QMutex>
 
 // Include VTK headers 
 #include <vtkSTLReader.h>
@@ -7,22 +14,197 @@
 #include <vtkActor.h>
 #include <vtkProperty.h>
 #include <vtkPolyData.h>
-#include <vtkDataSetMapper.h>
+#include <vtkNew.h>
+#include <vtkFloatArray.h>
+#include <vtkPoints.h>
+#include <vtkCellArray.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkBoundingBox.h>
+#include <vtkMath.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+
+/* Fixed size slots for parts, carved out of large blocks. Parts created together (a folder load
+ * creates them in tree order) end up next to each other, so walks over the tree touch far fewer
+ * cache lines and pages than nodes scattered over the heap. Freed slots are reused by the next
+ * part; the blocks themselves are kept until exit. Parts are only built on the GUI thread today,
+ * the lock keeps that from becoming a requirement.
+ */
+class PartArena {
+public:
+    void* allocate() {
+        QMutexLocker lock(&mutex);
+        if (!freeSlots)
+            grow();
+        Slot* slot = freeSlots;
+        freeSlots = slot->next;
+        return slot;
+    }
+
+    void release(void* pointer) {
+        QMutexLocker lock(&mutex);
+        Slot* slot = static_cast<Slot*>(pointer);
+        slot->next = freeSlots;
+        freeSlots = slot;
+    }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(ModelPart) unsigned char storage[sizeof(ModelPart)];
+    };
+
+    // Slots of a new block are handed out in address order
+    void grow() {
+        blocks.emplace_back(new Slot[BLOCK_SLOTS]);
+        Slot* block = blocks.back().get();
+        for (int i = BLOCK_SLOTS - 1; i >= 0; --i) {
+            block[i].next = freeSlots;
+            freeSlots = &block[i];
+        }
+    }
+
+    static const int BLOCK_SLOTS = 256;
+
+    QMutex mutex;
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    Slot* freeSlots = nullptr;
+};
+
+PartArena& partArena() {
+    static PartArena arena;
+    return arena;
+}
+
+// Builds triangle cells from the welded corner indices, triangles that collapse are dropped
+template <typename ArrayT>
+void buildWeldedTriangles(vtkCellArray* cells, const std::vector<uint32_t>& remap) {
+    using ValueType = typename ArrayT::ValueType;
+    const vtkIdType corners = static_cast<vtkIdType>(remap.size()) / 3 * 3;
+
+    vtkNew<ArrayT> connectivity;
+    connectivity->SetNumberOfValues(corners);
+    ValueType* corner = connectivity->GetPointer(0);
+    vtkIdType kept = 0;
+    for (vtkIdType i = 0; i < corners; i += 3) {
+        const uint32_t a = remap[i], b = remap[i + 1], c = remap[i + 2];
+        if (a == b || b == c || a == c)
+            continue;
+        corner[kept++] = static_cast<ValueType>(a);
+        corner[kept++] = static_cast<ValueType>(b);
+        corner[kept++] = static_cast<ValueType>(c);
+    }
+    connectivity->SetNumberOfValues(kept);
+
+    vtkNew<ArrayT> offsets;
+    offsets->SetNumberOfValues(kept / 3 + 1);
+    ValueType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= kept / 3; ++i)
+        offset[i] = static_cast<ValueType>(3 * i);
+
+    cells->SetData(offsets, connectivity);
+}
+
+// Turns a triangle soup (corner i of triangle t is point 3t + i) into an indexed mesh
+vtkSmartPointer<vtkPolyData> weldSoup(vtkPolyData* soup, const MeshWelder::Options& options) {
+    if (options.mode == MeshWelder::Mode::Off || !soup->GetPoints())
+        return soup;
+
+    vtkFloatArray* coords = vtkFloatArray::FastDownCast(soup->GetPoints()->GetData());
+    if (!coords)
+        return soup;
+
+    const MeshWelder::Result weld = MeshWelder::weld(coords->GetPointer(0), soup->GetNumberOfPoints(), options);
+
+    // Shared vertices take the position of the first corner that was merged into them
+    vtkNew<vtkFloatArray> weldedCoords;
+    weldedCoords->SetNumberOfComponents(3);
+    weldedCoords->SetNumberOfTuples(static_cast<vtkIdType>(weld.uniqueSource.size()));
+    float* dst = weldedCoords->GetPointer(0);
+    const float* src = coords->GetPointer(0);
+    for (size_t v = 0; v < weld.uniqueSource.size(); ++v)
+        std::memcpy(dst + 3 * v, src + 3 * size_t(weld.uniqueSource[v]), 3 * sizeof(float));
+
+    vtkNew<vtkPoints> points;
+    points->SetData(weldedCoords);
+
+    vtkNew<vtkCellArray> cells;
+    if (weld.remap.size() <= size_t(std::numeric_limits<vtkTypeInt32>::max()))
+        buildWeldedTriangles<vtkTypeInt32Array>(cells, weld.remap);
+    else
+        buildWeldedTriangles<vtkTypeInt64Array>(cells, weld.remap);
+
+    vtkSmartPointer<vtkPolyData> geometry = vtkSmartPointer<vtkPolyData>::New();
+    geometry->SetPoints(points);
+    geometry->SetPolys(cells);
+    return geometry;
+}
+
+// Copies 32 or 64 bit triangle corners into a flat index list
+template <typename ArrayT>
+void copyCorners(ArrayT* connectivity, std::vector<uint32_t>& corners) {
+    corners.resize(size_t(connectivity->GetNumberOfValues()));
+    const typename ArrayT::ValueType* corner = connectivity->GetPointer(0);
+    for (size_t i = 0; i < corners.size(); ++i)
+        corners[i] = uint32_t(corner[i]);
+}
+
+} // namespace
 
 // Constructor
 ModelPart::ModelPart(const QList<QVariant>& data, ModelPart* parent)
-    : m_itemData(data), m_parentItem(parent) {
+    : m_name(data.value(0).toString()), m_parentItem(parent) {
 }
 
 // Destructor
 ModelPart::~ModelPart() {
     qDeleteAll(m_childItems);
+    GeometryRegistry::instance().release(geometry);
+}
+
+// Parts that are not the size of a ModelPart can only come from a derived class, they use the heap
+void* ModelPart::operator new(size_t size) {
+    if (size != sizeof(ModelPart))
+        return ::operator new(size);
+    return partArena().allocate();
+}
+
+void ModelPart::operator delete(void* pointer, size_t size) {
+    if (!pointer)
+        return;
+    if (size != sizeof(ModelPart))
+        ::operator delete(pointer);
+    else
+        partArena().release(pointer);
 }
 
 // Adds a child part and sets the parent
 void ModelPart::appendChild(ModelPart* item) {
     item->m_parentItem = this;
+    item->m_row = m_childItems.size();
     m_childItems.append(item);
+    invalidateBounds();
+}
+
+// Detaches a child, its subtree no longer counts towards this part's bounds
+ModelPart* ModelPart::takeChild(int row) {
+    if (row < 0 || row >= m_childItems.size())
+        return nullptr;
+
+    ModelPart* item = m_childItems.takeAt(row);
+    item->m_parentItem = nullptr;
+    item->m_row = 0;
+    for (int i = row; i < m_childItems.size(); ++i)
+        m_childItems[i]->m_row = i;
+    invalidateBounds();
+    return item;
 }
 
 // Returns a pointer or null
@@ -39,21 +221,24 @@ int ModelPart::childCount() const {
 
 // Returns the number of columns in the item data
 int ModelPart::columnCount() const {
-    return m_itemData.count();
+    return COLUMN_COUNT;
 }
 
-// Retrieves the data at the specified column
+// Retrieves the name or the visibility flag
 QVariant ModelPart::data(int column) const {
-    if (column < 0 || column >= m_itemData.size())
-        return QVariant();
-    return m_itemData.at(column);
+    if (column == 0)
+        return m_name;
+    if (column == 1)
+        return isVisible;
+    return QVariant();
 }
 
-// Sets the data at a specific column
+// Sets the name or the visibility flag
 void ModelPart::setData(int column, const QVariant& value) {
-    if (column < 0 || column >= m_itemData.size())
-        return;
-    m_itemData.replace(column, value);
+    if (column == 0)
+        m_name = value.toString();
+    else if (column == 1)
+        setVisible(value.toBool());
 }
 
 // Returns the parent of this model part
@@ -61,11 +246,9 @@ ModelPart* ModelPart::parentItem() {
     return m_parentItem;
 }
 
-// Returns the index of this item in the parent's child list
+// Returns the index of this item in the parent's child list, stored so the view never searches for it
 int ModelPart::row() const {
-    if (m_parentItem)
-        return m_parentItem->m_childItems.indexOf(const_cast<ModelPart*>(this));
-    return 0;
+    return m_row;
 }
 
 // Sets the RGB color of the part and updates the actor's visual appearance
@@ -98,20 +281,267 @@ bool ModelPart::visible() const {
 }
 
 // Loads an STL file and creates a corresponding VTK actor
-void ModelPart::loadSTL(QString fileName) {
-    stlReader = vtkSmartPointer<vtkSTLReader>::New();
-    stlReader->SetFileName(fileName.toStdString().c_str());
-    stlReader->Update();
+void ModelPart::loadSTL(QString fileName, const MeshWelder::Options& weldOptions) {
+    filePath = fileName;
+    vtkSmartPointer<vtkPolyData> mesh = readSTL(fileName, weldOptions);
 
-    stlMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    stlMapper->SetInputConnection(stlReader->GetOutputPort());
+    PartGeometry interned;
+    {
+        ScopedLoadTimer timer(fileName, LoadProfiler::Intern);
+        interned = GeometryRegistry::instance().intern(mesh);
+    }
 
+    setGeometry(interned);
+    loadState = LoadState::Loaded;
+}
+
+// Reads an STL file into a standalone polydata, the reader is released once the output is detached
+vtkSmartPointer<vtkPolyData> ModelPart::readSTL(const QString& fileName, const MeshWelder::Options& weldOptions,
+                                               uint64_t* contentHash) {
+    // Binary files are memory mapped and decoded directly, ASCII files go through VTK
+    vtkSmartPointer<vtkPolyData> soup = MappedSTLReader::read(fileName, contentHash);
+    if (!soup) {
+        // VTK reads the file itself, so it is hashed first. A change in between leaves a hash that no longer matches
+        if (contentHash)
+            *contentHash = MappedSTLReader::hashFile(fileName);
+
+        // Reading and parsing happen together inside the VTK reader, both count as Parse
+        ScopedLoadTimer timer(fileName, LoadProfiler::Parse);
+
+        // Point merging is left to the welder, which is much faster than the reader's locator
+        vtkSmartPointer<vtkSTLReader> reader = vtkSmartPointer<vtkSTLReader>::New();
+        reader->SetFileName(fileName.toStdString().c_str());
+        reader->MergingOff();
+        reader->Update();
+
+        // The reader's output keeps the reader alive through its pipeline, a shallow copy shares the arrays without it
+        soup = vtkSmartPointer<vtkPolyData>::New();
+        soup->ShallowCopy(reader->GetOutput());
+    }
+
+    return weld(soup, weldOptions, fileName);
+}
+
+// Welds on the calling thread (the file's Merge stage), then reorders the result if asked (its Optimise stage)
+vtkSmartPointer<vtkPolyData> ModelPart::weld(vtkPolyData* soup, const MeshWelder::Options& weldOptions, const QString& fileName) {
+    vtkSmartPointer<vtkPolyData> mesh;
+    {
+        ScopedLoadTimer timer(fileName, LoadProfiler::Merge);
+        mesh = weldSoup(soup, weldOptions);
+    }
+
+    // A soup shares no vertices between triangles, so reordering it gains nothing
+    if (weldOptions.optimiseOrder && weldOptions.mode != MeshWelder::Mode::Off && mesh != soup) {
+        ScopedLoadTimer timer(fileName, LoadProfiler::Optimise);
+        optimiseOrder(mesh);
+    }
+    return mesh;
+}
+
+// Puts the triangles and points of a welded mesh in the order MeshOptimizer picks
+void ModelPart::optimiseOrder(vtkPolyData* mesh) {
+    vtkFloatArray* coords = mesh->GetPoints() ? vtkFloatArray::FastDownCast(mesh->GetPoints()->GetData()) : nullptr;
+    vtkCellArray* polys = mesh->GetPolys();
+    if (!coords || !polys || polys->GetNumberOfCells() == 0 || polys->IsHomogeneous() != 3)
+        return;
+
+    std::vector<uint32_t> corners;
+    if (vtkTypeInt32Array* corners32 = vtkTypeInt32Array::FastDownCast(polys->GetConnectivityArray()))
+        copyCorners(corners32, corners);
+    else if (vtkTypeInt64Array* corners64 = vtkTypeInt64Array::FastDownCast(polys->GetConnectivityArray()))
+        copyCorners(corners64, corners);
+    else
+        return;
+
+    const size_t vertexCount = size_t(mesh->GetNumberOfPoints());
+    const MeshOptimizer::Result order = MeshOptimizer::optimise(corners.data(), corners.size() / 3,
+                                                                coords->GetPointer(0), vertexCount);
+
+    vtkNew<vtkFloatArray> orderedCoords;
+    orderedCoords->SetNumberOfComponents(3);
+    orderedCoords->SetNumberOfTuples(vtkIdType(vertexCount));
+    float* dst = orderedCoords->GetPointer(0);
+    const float* src = coords->GetPointer(0);
+    for (size_t v = 0; v < vertexCount; ++v)
+        std::memcpy(dst + 3 * v, src + 3 * size_t(order.vertexOrder[v]), 3 * sizeof(float));
+    mesh->GetPoints()->SetData(orderedCoords);
+
+    vtkNew<vtkCellArray> cells;
+    if (order.indices.size() <= size_t(std::numeric_limits<vtkTypeInt32>::max()))
+        buildWeldedTriangles<vtkTypeInt32Array>(cells, order.indices);
+    else
+        buildWeldedTriangles<vtkTypeInt64Array>(cells, order.indices);
+    mesh->SetPolys(cells);
+}
+
+// Builds the mapper and actor for the given geometry and applies the current colour and visibility
+void ModelPart::setGeometry(const PartGeometry& newGeometry) {
+    GeometryRegistry::instance().release(geometry);
+    geometry = newGeometry;
+    compactGeometry = CompactGeometry();
+    lodLevels.clear();
+    smoothMesh = nullptr;
+
+    ScopedLoadTimer timer(filePath, LoadProfiler::Mapper);
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputData(getShadedMesh());
+    stlMapper = mapper;
+    LoadProfiler::instance().watchFirstDraw(mapper, filePath);
+
+    // The mesh is in its local frame, the actor places it back in the assembly
     vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
     actor->SetMapper(stlMapper);
+    actor->SetPosition(geometry.origin);
+    actor->GetProperty()->SetColor(colourR / 255.0, colourG / 255.0, colourB / 255.0);
+    actor->SetVisibility(isVisible);
 
     this->stlActor = actor;
 }
 
+// Returns the (possibly shared) geometry of this part
+const PartGeometry& ModelPart::getGeometry() const {
+    return geometry;
+}
+
+// Releases the geometry so its memory can be freed, getActor() returns null until it is loaded again
+void ModelPart::releaseGeometry() {
+    GeometryRegistry::instance().release(geometry);
+    geometry = PartGeometry();
+    lodLevels.clear();
+    smoothMesh = nullptr;
+
+    stlMapper = nullptr;
+    stlActor = nullptr;
+    loadState = LoadState::Unloaded;
+}
+
+// Sets the compact copy, usually right before the geometry is released
+void ModelPart::setCompactGeometry(const CompactGeometry& compact) {
+    compactGeometry = compact;
+}
+
+// Returns the compact copy, its mesh is null if there is none
+const CompactGeometry& ModelPart::getCompactGeometry() const {
+    return compactGeometry;
+}
+
+// Mesh and level of detail sizes divided by the number of parts sharing them, VTK reports KiB
+qint64 ModelPart::memoryBytes() const {
+    if (!geometry.polyData) {
+        if (compactGeometry.mesh)
+            return compactGeometry.mesh->bytes() / qint64(compactGeometry.mesh.use_count());
+        return 0;
+    }
+
+    qint64 bytes = qint64(geometry.polyData->GetActualMemorySize()) * 1024;
+    for (const vtkSmartPointer<vtkPolyData>& level : lodLevels)
+        bytes += qint64(level->GetActualMemorySize()) * 1024;
+    if (smoothMesh)
+        bytes += qint64(smoothMesh->GetActualMemorySize()) * 1024;
+    if (compactGeometry.mesh)
+        bytes += compactGeometry.mesh->bytes() / qint64(compactGeometry.mesh.use_count());
+
+    return bytes / std::max(1, GeometryRegistry::instance().userCount(geometry));
+}
+
+// Own geometry bounds moved to the part's origin, joined with the bounds of every child
+bool ModelPart::getSubtreeBounds(double bounds[6]) {
+    if (!subtreeBoundsValid) {
+        vtkBoundingBox box;
+        if (geometry.polyData && geometry.polyData->GetNumberOfPoints() > 0) {
+            double local[6];
+            geometry.polyData->GetBounds(local);
+            box.AddPoint(local[0] + geometry.origin[0], local[2] + geometry.origin[1], local[4] + geometry.origin[2]);
+            box.AddPoint(local[1] + geometry.origin[0], local[3] + geometry.origin[1], local[5] + geometry.origin[2]);
+        }
+
+        double childBounds[6];
+        for (ModelPart* child : m_childItems) {
+            if (child->getSubtreeBounds(childBounds))
+                box.AddBounds(childBounds);
+        }
+
+        if (box.IsValid())
+            box.GetBounds(subtreeBounds);
+        else
+            vtkMath::UninitializeBounds(subtreeBounds);
+        subtreeBoundsValid = true;
+    }
+
+    std::copy(subtreeBounds, subtreeBounds + 6, bounds);
+    return vtkMath::AreBoundsInitialized(subtreeBounds);
+}
+
+// Stops at the first stale part, its ancestors are already stale
+void ModelPart::invalidateBounds() {
+    for (ModelPart* part = this; part && part->subtreeBoundsValid; part = part->m_parentItem)
+        part->subtreeBoundsValid = false;
+}
+
+ModelPart::CullState& ModelPart::cullState() {
+    return culling;
+}
+
+// Sets the STL file behind this part
+void ModelPart::setFilePath(const QString& filePath) {
+    this->filePath = filePath;
+}
+
+// Returns the STL file behind this part, empty for folders
+QString ModelPart::getFilePath() const {
+    return filePath;
+}
+
+// Sets whether the geometry has been read yet
+void ModelPart::setLoadState(LoadState state) {
+    loadState = state;
+}
+
+// Returns whether the geometry has been read yet
+ModelPart::LoadState ModelPart::getLoadState() const {
+    return loadState;
+}
+
+// Sets the reduced levels of detail built in the background
+void ModelPart::setLodLevels(const QList<vtkSmartPointer<vtkPolyData>>& levels) {
+    lodLevels = levels;
+}
+
+// Returns the reduced levels of detail, empty until they have been generated
+QList<vtkSmartPointer<vtkPolyData>> ModelPart::getLodLevels() const {
+    return lodLevels;
+}
+
+// Sets the smooth shading mesh built in the background, it is drawn straight away in smooth mode
+void ModelPart::setSmoothGeometry(vtkPolyData* smooth) {
+    smoothMesh = smooth;
+    if (stlMapper)
+        stlMapper->SetInputDataObject(getShadedMesh());
+}
+
+// Returns the smooth shading mesh, null until it has been generated
+vtkSmartPointer<vtkPolyData> ModelPart::getSmoothGeometry() const {
+    return smoothMesh;
+}
+
+// Switches the part's own mapper between the flat and smooth mesh, level of detail mappers stay flat
+void ModelPart::setSmoothShading(bool smooth) {
+    useSmoothShading = smooth;
+    if (stlMapper)
+        stlMapper->SetInputDataObject(getShadedMesh());
+}
+
+bool ModelPart::smoothShading() const {
+    return useSmoothShading;
+}
+
+// The smooth mesh when it is wanted and available, the flat mesh otherwise
+vtkPolyData* ModelPart::getShadedMesh() const {
+    if (useSmoothShading && smoothMesh)
+        return smoothMesh;
+    return geometry.polyData;
+}
+
 // Returns the existing VTK actor associated with this model part
 vtkSmartPointer<vtkActor> ModelPart::getActor() {
     return this->stlActor;
@@ -121,6 +551,7 @@ vtkSmartPointer<vtkActor> ModelPart::getActor() {
 void ModelPart::removeAllChildren() {
     qDeleteAll(m_childItems);
     m_childItems.clear();
+    invalidateBounds();
 }
 
 // Returns the color of the part as a QColor object
@@ -133,20 +564,28 @@ void ModelPart::setColor(const QColor& color) {
     setColour(color.red(), color.green(), color.blue());
 }
 
-// Creates and returns a new actor with the same properties, needed for the VR thread to work
-vtkActor* ModelPart::getNewActor() {
+/* Creates a new actor for the VR thread. Its mapper reads a shallow copy of the part's mesh, so the
+ * arrays are shared but the data object whose pipeline state the mapper updates is the VR thread's
+ * own; the VR context uploads the arrays to its own buffers. The arrays must not be edited
+ * afterwards, a part that changes mesh sends the new one with setActorMesh().
+ * The property is copied rather than shared, later colour and visibility edits reach the VR thread
+ * as commands so it never reads state the GUI thread is writing.
+ */
+vtkSmartPointer<vtkActor> ModelPart::getNewActor() {
     if (!this->stlActor) {
         return nullptr;
     }
 
-    newMapper = vtkSmartPointer<vtkDataSetMapper>::New();
-    newMapper->SetInputConnection(stlReader->GetOutputPort());
-
-    newActor = vtkSmartPointer<vtkActor>::New();
-    newActor->SetMapper(newMapper);
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputData(VRRenderThread::copyForVR(getShadedMesh()));
 
-    // Copy visual properties from the original actor
-    newActor->SetProperty(this->stlActor->GetProperty());
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    actor->SetPosition(geometry.origin);
+    // DeepCopy still hands over the texture objects themselves, and the VR context must not bind those
+    actor->GetProperty()->DeepCopy(this->stlActor->GetProperty());
+    actor->GetProperty()->RemoveAllTextures();
+    actor->SetVisibility(isVisible);
 
-    return newActor;
+    return actor;
 }
@@ -5,24 +5,43 @@
 #include <QList>
 #include <QVariant>
 #include <QColor>
-#include <vtkSTLReader.h>
 #include <vtkMapper.h>
 #include <vtkActor.h>
-#include <vtkDataSetMapper.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include "MeshWelder.h"
+#include "GeometryRegistry.h"
+#include "CompactMesh.h"
 
 class ModelPart {
 public:
+    // Whether the geometry of a file part has been read, folder parts are always Loaded
+    enum class LoadState { Unloaded, Loading, Loaded, Failed };
+
+    // Columns shown in the tree, the name and the visibility flag
+    static const int COLUMN_COUNT = 2;
+
+    // Column 0 of data is the name, the visibility column follows the part's own flag
     ModelPart(const QList<QVariant>& data, ModelPart* parent = nullptr);
     ~ModelPart();
 
+    // Parts are allocated from a shared arena so walking the tree stays within a few blocks of memory
+    static void* operator new(size_t size);
+    static void operator delete(void* pointer, size_t size);
+
     void appendChild(ModelPart* item);
+    // Removes a child without deleting it, the caller owns it afterwards
+    ModelPart* takeChild(int row);
     ModelPart* child(int row);
     int childCount() const;
     int columnCount() const;
     QVariant data(int column) const;
     void setData(int column, const QVariant& value);
-    vtkActor* getNewActor();
+    // A separate actor for the VR renderer that draws the same mesh, with a copy of the current appearance
+    vtkSmartPointer<vtkActor> getNewActor();
     ModelPart* parentItem();
+    // Position under the parent, kept up to date as children are added and removed
     int row() const;
 
     // Visibility
@@ -30,7 +49,56 @@ public:
     bool visible() const;
 
     // STL loading and actor
-    void loadSTL(QString fileName);
+    void loadSTL(QString fileName, const MeshWelder::Options& weldOptions = MeshWelder::Options());
+    // Reads an STL file into welded geometry only, safe to call from worker threads. contentHash, if given,
+    // receives the contentHash64 of the file as it was read
+    static vtkSmartPointer<vtkPolyData> readSTL(const QString& fileName, const MeshWelder::Options& weldOptions = MeshWelder::Options(),
+                                                uint64_t* contentHash = nullptr);
+    // Merges the corners of a triangle soup read from fileName into shared vertices, reordered for the GPU when
+    // weldOptions.optimiseOrder is set. Safe to call from worker threads
+    static vtkSmartPointer<vtkPolyData> weld(vtkPolyData* soup, const MeshWelder::Options& weldOptions, const QString& fileName);
+    // Puts the triangles and points of an indexed triangle mesh in the order MeshOptimizer picks, other meshes are
+    // left alone. Safe to call from worker threads
+    static void optimiseOrder(vtkPolyData* mesh);
+    // Attaches already loaded (and interned) geometry and builds the mapper/actor (GUI thread)
+    void setGeometry(const PartGeometry& geometry);
+    const PartGeometry& getGeometry() const;
+    // STL file the part was (or will be) read from, empty for folders
+    void setFilePath(const QString& filePath);
+    QString getFilePath() const;
+    void setLoadState(LoadState state);
+    LoadState getLoadState() const;
+    // Reduced levels of detail, finest first, shared with parts that use the same mesh
+    void setLodLevels(const QList<vtkSmartPointer<vtkPolyData>>& levels);
+    QList<vtkSmartPointer<vtkPolyData>> getLodLevels() const;
+    // Mesh with split vertices and smooth point normals, shared with parts that use the same mesh
+    void setSmoothGeometry(vtkPolyData* smooth);
+    vtkSmartPointer<vtkPolyData> getSmoothGeometry() const;
+    // Draws the smooth mesh once it has been set, the flat facets until then and when off
+    void setSmoothShading(bool smooth);
+    bool smoothShading() const;
+    // The mesh the part is drawn with in the current shading mode
+    vtkPolyData* getShadedMesh() const;
+    // Drops the geometry, levels and actors of a file part, it is Unloaded and can be read again.
+    // A compact copy is kept, loading the part decodes it instead of reading the file
+    void releaseGeometry();
+    // Quantised copy of the mesh kept while the part is released, cleared when geometry is set again.
+    // A part whose geometry was decoded from the copy keeps it, so it is not encoded a second time
+    void setCompactGeometry(const CompactGeometry& compact);
+    const CompactGeometry& getCompactGeometry() const;
+    // Bytes of geometry kept alive by this part, shared meshes are split between their users
+    qint64 memoryBytes() const;
+    // World bounds of the loaded geometry of this part and everything below it, cached (GUI thread).
+    // Returns false if nothing in the subtree is loaded
+    bool getSubtreeBounds(double bounds[6]);
+    // Marks the cached bounds of this part and its ancestors as stale, call when geometry changes
+    void invalidateBounds();
+    // Per render state of the tree culler (GUI thread)
+    struct CullState {
+        quint64 acceptedFrame = 0;  // Last render in which this part's subtree passed the culler
+        int drawnActors = 0;        // Own actors of this part and every part below it in the renderer
+    };
+    CullState& cullState();
     vtkSmartPointer<vtkActor> getActor();
     void removeAllChildren();
 
@@ -44,19 +112,28 @@ public:
     QColor getColor() const;
     void setColor(const QColor& color);
 
-    vtkSmartPointer<vtkPolyData> polyData;
-
 private:
     QList<ModelPart*> m_childItems;
-    QList<QVariant> m_itemData;
+    QString m_name;
     ModelPart* m_parentItem;
+    int m_row = 0;
     bool isVisible = true;
+    QString filePath;
+    LoadState loadState = LoadState::Loaded;
+
+    PartGeometry geometry;
+    CompactGeometry compactGeometry;
+    QList<vtkSmartPointer<vtkPolyData>> lodLevels;
+    vtkSmartPointer<vtkPolyData> smoothMesh;
+    bool useSmoothShading = false;
+
+    // Cached subtree bounds, a valid part only has valid children
+    double subtreeBounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+    bool subtreeBoundsValid = false;
+    CullState culling;
 
-    vtkSmartPointer<vtkSTLReader> stlReader;
     vtkSmartPointer<vtkMapper> stlMapper;
     vtkSmartPointer<vtkActor> stlActor;
-    vtkSmartPointer<vtkDataSetMapper> newMapper;
-    vtkSmartPointer<vtkActor> newActor;
 
     unsigned char colourR = 255;  // Default color: white
     unsigned char colourG = 255;
@@ -10,11 +10,34 @@
 #include "ModelPartList.h"
 #include "ModelPart.h"
 
+#include <QColor>
+#include <QFont>
+#include <QLocale>
+#include <QSet>
+
+namespace {
+
+// Applies a change to a part and everything below it
+template <typename Change>
+void forSubtree(ModelPart* item, const Change& change) {
+    change(item);
+    for (int i = 0; i < item->childCount(); ++i)
+        forSubtree(item->child(i), change);
+}
+
+} // namespace
+
 ModelPartList::ModelPartList( const QString& data, QObject* parent ) : QAbstractItemModel(parent) {
-    /* Have option to specify number of visible properties for each item in tree - the root item
-     * acts as the column headers
+    /* The root item's name is the header of the first column, the other headers are fixed
      */
-    rootItem = new ModelPart( { tr("Part"), tr("Visible?") } );
+    rootItem = new ModelPart( { tr("Part") } );
+
+    /* Folder memory totals are kept until a change notification says a part below them changed */
+    connect( this, &QAbstractItemModel::dataChanged, this, &ModelPartList::handleDataChanged );
+    connect( this, &QAbstractItemModel::rowsInserted, this, &ModelPartList::handleRowsInserted );
+    connect( this, &QAbstractItemModel::rowsAboutToBeRemoved, this, &ModelPartList::clearMemoryTotals );
+    connect( this, &QAbstractItemModel::modelReset, this, &ModelPartList::clearMemoryTotals );
+    connect( this, &QAbstractItemModel::layoutChanged, this, &ModelPartList::clearMemoryTotals );
 }
 
 
@@ -27,7 +50,7 @@ ModelPartList::~ModelPartList() {
 int ModelPartList::columnCount( const QModelIndex& parent ) const {
     Q_UNUSED(parent);
 
-    return rootItem->columnCount();
+    return rootItem->columnCount() + 1;
 }
 
 
@@ -40,12 +63,37 @@ QVariant ModelPartList::data( const QModelIndex& index, int role ) const {
     /* Role represents what this data will be used for, we only need deal with the case
      * when QT is asking for data to create and display the treeview. Return a new,
      * empty QVariant if any other request comes through. */
-    if (role != Qt::DisplayRole)
-        return QVariant();
-
     /* Get a a pointer to the item referred to by the QModelIndex */
     ModelPart* item = static_cast<ModelPart*>( index.internalPointer() );
 
+    /* Parts whose geometry has not been read yet are shown in italics, with a note while
+     * they are loading or if reading failed */
+    if (role == Qt::FontRole) {
+        QFont font;
+        font.setItalic(item->getLoadState() != ModelPart::LoadState::Loaded);
+        return font;
+    }
+
+    if (role == Qt::TextAlignmentRole && index.column() == MEMORY_COLUMN)
+        return int(Qt::AlignRight | Qt::AlignVCenter);
+
+    if (role == Qt::CheckStateRole && index.column() == VISIBLE_COLUMN)
+        return item->visible() ? Qt::Checked : Qt::Unchecked;
+
+    /* The visible column is only a check box */
+    if (role != Qt::DisplayRole || index.column() == VISIBLE_COLUMN)
+        return QVariant();
+
+    if (index.column() == MEMORY_COLUMN) {
+        const qint64 bytes = subtreeBytes(item);
+        return bytes > 0 ? QLocale().formattedDataSize(bytes) : QString();
+    }
+
+    if (index.column() == 0 && item->getLoadState() == ModelPart::LoadState::Loading)
+        return item->data(0).toString() + tr(" (loading...)");
+    if (index.column() == 0 && item->getLoadState() == ModelPart::LoadState::Failed)
+        return item->data(0).toString() + tr(" (failed to load)");
+
     /* Each item in the tree has a number of columns ("Part" and "Visible" in this 
      * initial example) return the column requested by the QModelIndex */
     return item->data( index.column() );
@@ -56,11 +104,30 @@ Qt::ItemFlags ModelPartList::flags( const QModelIndex& index ) const {
     if( !index.isValid() )
         return Qt::NoItemFlags;
 
+    if( index.column() == VISIBLE_COLUMN )
+        return QAbstractItemModel::flags( index ) | Qt::ItemIsUserCheckable;
+
     return QAbstractItemModel::flags( index );
 }
 
 
+bool ModelPartList::setData( const QModelIndex& index, const QVariant& value, int role ) {
+    if( !index.isValid() || index.column() != VISIBLE_COLUMN || role != Qt::CheckStateRole )
+        return false;
+
+    ModelPart* item = static_cast<ModelPart*>( index.internalPointer() );
+    setSubtreesVisible( { item }, value.toInt() == Qt::Checked );
+    return true;
+}
+
+
 QVariant ModelPartList::headerData( int section, Qt::Orientation orientation, int role ) const {
+    if( orientation == Qt::Horizontal && role == Qt::DisplayRole && section == MEMORY_COLUMN )
+        return tr("Memory");
+
+    if( orientation == Qt::Horizontal && role == Qt::DisplayRole && section == 1 )
+        return tr("Visible?");
+
     if( orientation == Qt::Horizontal && role == Qt::DisplayRole )
         return rootItem->data( section );
 
@@ -144,6 +211,203 @@ QModelIndex ModelPartList::appendChild(QModelIndex& parent, const QList<QVariant
     return child;
 }
 
+QModelIndex ModelPartList::indexOf( ModelPart* part ) const {
+    if( !part || part == rootItem )
+        return QModelIndex();
+
+    return createIndex( part->row(), 0, part );
+}
+
+
+void ModelPartList::appendParts( ModelPart* parent, const QList<ModelPart*>& parts ) {
+    if( parts.isEmpty() )
+        return;
+
+    if( !parent )
+        parent = rootItem;
+
+    /* One insertion notification for the whole batch keeps the view from relayouting per part */
+    int first = parent->childCount();
+    beginInsertRows( indexOf( parent ), first, first + parts.size() - 1 );
+
+    for( ModelPart* part : parts )
+        parent->appendChild( part );
+
+    endInsertRows();
+}
+
+void ModelPartList::removePart( ModelPart* part ) {
+    ModelPart* parent = part ? part->parentItem() : nullptr;
+    if( !parent )
+        return;
+
+    int row = part->row();
+    beginRemoveRows( indexOf( parent ), row, row );
+    delete parent->takeChild( row );
+    endRemoveRows();
+}
+
+void ModelPartList::setSubtreesVisible( const QList<ModelPart*>& parts, bool visible ) {
+    for( ModelPart* part : parts )
+        forSubtree( part, [visible]( ModelPart* item ) { item->setVisible( visible ); } );
+
+    emitSubtreesChanged( parts );
+}
+
+
+void ModelPartList::setSubtreesColour( const QList<ModelPart*>& parts, const QColor& colour ) {
+    for( ModelPart* part : parts )
+        forSubtree( part, [&colour]( ModelPart* item ) { item->setColor( colour ); } );
+
+    emitSubtreesChanged( parts );
+}
+
+
+void ModelPartList::isolate( const QList<ModelPart*>& parts ) {
+    if( rootItem->childCount() == 0 )
+        return;
+
+    QSet<ModelPart*> kept;
+    for( ModelPart* part : parts )
+        kept.insert( part );
+
+    /* A part is shown if it or a folder above it was picked, folders above a picked part stay ticked */
+    QSet<ModelPart*> above;
+    for( ModelPart* part : parts ) {
+        for( ModelPart* item = part ? part->parentItem() : nullptr; item && item != rootItem; item = item->parentItem() )
+            above.insert( item );
+    }
+
+    for( int i = 0; i < rootItem->childCount(); ++i ) {
+        forSubtree( rootItem->child( i ), [&kept, &above]( ModelPart* item ) {
+            bool show = above.contains( item );
+            for( ModelPart* ancestor = item; ancestor && !show; ancestor = ancestor->parentItem() )
+                show = kept.contains( ancestor );
+            item->setVisible( show );
+        } );
+    }
+
+    /* Every top level row may have changed, which covers the whole tree in one range */
+    emit dataChanged( index( 0, 0, QModelIndex() ), index( rootItem->childCount() - 1, VISIBLE_COLUMN, QModelIndex() ) );
+}
+
+
+/* One dataChanged for the rows under the deepest item that holds every changed part. The scene and the
+ * views re-check the whole subtree of each row in the range, so the parts below them are covered too.
+ * The range spans two columns, which makes the views repaint once rather than row by row.
+ */
+void ModelPartList::emitSubtreesChanged( const QList<ModelPart*>& parts ) {
+    if( parts.isEmpty() )
+        return;
+
+    /* Ancestors of the first part, nearest first, cut back to the deepest one shared with every other part */
+    QList<ModelPart*> chain;
+    for( ModelPart* item = parts.first(); item; item = item->parentItem() )
+        chain.append( item );
+    for( ModelPart* part : parts ) {
+        ModelPart* item = part;
+        while( item && !chain.contains( item ) )
+            item = item->parentItem();
+        if( item )
+            chain = chain.mid( chain.indexOf( item ) );
+    }
+    if( chain.isEmpty() )
+        return;
+
+    ModelPart* common = chain.first();
+    if( common != rootItem && parts.contains( common ) ) {
+        QModelIndex changed = indexOf( common );
+        emit dataChanged( changed, changed.sibling( changed.row(), VISIBLE_COLUMN ) );
+        return;
+    }
+
+    /* The rows of the common item that lead down to the parts */
+    int first = common->childCount();
+    int last = -1;
+    for( ModelPart* part : parts ) {
+        ModelPart* item = part;
+        while( item && item->parentItem() != common )
+            item = item->parentItem();
+        if( item ) {
+            first = qMin( first, item->row() );
+            last = qMax( last, item->row() );
+        }
+    }
+    if( last < first )
+        return;
+
+    QModelIndex parent = indexOf( common );
+    emit dataChanged( index( first, 0, parent ), index( last, VISIBLE_COLUMN, parent ) );
+}
+
+
+void ModelPartList::memoryChanged( const QList<ModelPart*>& parts ) {
+    for( ModelPart* part : parts )
+        forgetMemoryTotals( part );
+}
+
+
+void ModelPartList::partsChanged( const QList<ModelPart*>& parts ) {
+    emitSubtreesChanged( parts );
+}
+
+
+/* Parts are summed on every call, folders once until something below them changes */
+qint64 ModelPartList::subtreeBytes( ModelPart* item ) const {
+    if( item->childCount() == 0 )
+        return item->memoryBytes();
+
+    auto cached = folderBytes.constFind( item );
+    if( cached != folderBytes.constEnd() )
+        return *cached;
+
+    qint64 bytes = item->memoryBytes();
+    for( int i = 0; i < item->childCount(); ++i )
+        bytes += subtreeBytes( item->child( i ) );
+    folderBytes.insert( item, bytes );
+    return bytes;
+}
+
+
+/* The folder totals above a part include it */
+void ModelPartList::forgetMemoryTotals( ModelPart* part ) {
+    for( ModelPart* item = part; item; item = item->parentItem() )
+        folderBytes.remove( item );
+}
+
+
+/* A changed row stands for its whole subtree, so the folders inside it are forgotten as well as those above */
+void ModelPartList::handleDataChanged( const QModelIndex& topLeft, const QModelIndex& bottomRight ) {
+    if( folderBytes.isEmpty() )
+        return;
+    if( !topLeft.isValid() ) {
+        clearMemoryTotals();
+        return;
+    }
+
+    ModelPart* parent = topLeft.parent().isValid() ? static_cast<ModelPart*>( topLeft.parent().internalPointer() ) : rootItem;
+    forgetMemoryTotals( parent );
+    for( int row = topLeft.row(); row <= bottomRight.row() && row < parent->childCount(); ++row )
+        forSubtree( parent->child( row ), [this]( ModelPart* item ) {
+            if( item->childCount() > 0 )
+                folderBytes.remove( item );
+        } );
+}
+
+
+void ModelPartList::handleRowsInserted( const QModelIndex& parent, int first, int last ) {
+    Q_UNUSED(first);
+    Q_UNUSED(last);
+
+    forgetMemoryTotals( parent.isValid() ? static_cast<ModelPart*>( parent.internalPointer() ) : rootItem );
+}
+
+
+void ModelPartList::clearMemoryTotals() {
+    folderBytes.clear();
+}
+
+
 void ModelPartList::clear()
 {
     beginResetModel(); // Notify Qt that we're about to reset the model
@@ -153,16 +417,15 @@ void ModelPartList::clear()
     endResetModel(); // Notify Qt that the model has been reset
 }
 
-void ModelPartList::addPart(const QString& name, const QString& filePath)
+void ModelPartList::addPart(const QString& name, const QString& filePath, const MeshWelder::Options& weldOptions)
 {
+    // Load first so views see a complete part when the row is announced
+    ModelPart* part = new ModelPart({ name, 0 }, rootItem);
+    part->loadSTL(filePath, weldOptions);
+    part->setVisible(false);
+
     int row = rootItem->childCount();
     beginInsertRows(QModelIndex(), row, row);
-
-    ModelPart* part = new ModelPart({ name, 0 }, rootItem);
     rootItem->appendChild(part);
-
     endInsertRows();
-
-    part->loadSTL(filePath);
-    part->setVisible(false);
 }
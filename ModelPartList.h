@@ -14,6 +14,7 @@
 #include "ModelPart.h"
 
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QModelIndex>
 #include <QVariant>
 #include <QString>
@@ -30,7 +31,16 @@ public:
       * @param parent is used by the parent class constructor
       */
     ModelPartList( const QString& data, QObject* parent = NULL );
-    void addPart(const QString& name, const QString& filePath);
+
+    /** Column that shows the memory used by each part (and the total under each folder),
+      *  views hide it unless the user asks for it
+      */
+    static const int MEMORY_COLUMN = 2;
+
+    /** Column with a check box that shows or hides a part and everything below it
+      */
+    static const int VISIBLE_COLUMN = 1;
+    void addPart(const QString& name, const QString& filePath, const MeshWelder::Options& weldOptions = MeshWelder::Options());
     /** Destructor
       *  Frees root item allocated in constructor
       */
@@ -40,7 +50,7 @@ public:
 
     /** Return column count
       * @param parent is not used
-      * @return number of columns in the tree view - "Part" and "Visible", i.e. 2 in this case
+      * @return number of columns in the tree view - "Part", "Visible" and "Memory"
       */
     int columnCount( const QModelIndex& parent ) const;
 
@@ -59,6 +69,14 @@ public:
       */
     Qt::ItemFlags flags( const QModelIndex& index ) const;
 
+    /** Standard function used by Qt internally, ticking the visible column shows or hides a subtree
+      * @param index is the item, only the visible column with Qt::CheckStateRole is editable
+      * @param value is a Qt::CheckState
+      * @param role is how Qt specifies what is being changed
+      * @return true if the value was set
+      */
+    bool setData( const QModelIndex& index, const QVariant& value, int role );
+
 
     /** Standard function used by Qt internally.
       */
@@ -97,9 +115,65 @@ public:
       */
     QModelIndex appendChild( QModelIndex& parent, const QList<QVariant>& data );
 
+    /** Get the QModelIndex (column 0) that refers to a part in the tree
+      * @param part is the item to look up, the root item maps to an invalid index
+      * @return the QModelIndex structure
+      */
+    QModelIndex indexOf( ModelPart* part ) const;
+
+    /** Append a batch of already constructed parts under a single parent, the view is
+      *  notified with one insertion covering the whole batch. Ownership passes to the tree.
+      * @param parent is the item the parts are added under
+      * @param parts are the new children, in the order they should appear
+      */
+    void appendParts( ModelPart* parent, const QList<ModelPart*>& parts );
+
+    /** Remove a part and everything below it from the tree and delete them
+      * @param part is any item except the root
+      */
+    void removePart( ModelPart* part );
+
+    /** Show or hide some parts and everything below them. Views and the scene are told once,
+      *  with a single dataChanged covering every changed row.
+      * @param parts are the items to change, parts below another one in the list are covered by it
+      * @param visible is the new visibility
+      */
+    void setSubtreesVisible( const QList<ModelPart*>& parts, bool visible );
+
+    /** Give some parts and everything below them one colour, with a single dataChanged
+      * @param parts are the items to change
+      * @param colour is the new colour
+      */
+    void setSubtreesColour( const QList<ModelPart*>& parts, const QColor& colour );
+
+    /** Show some parts and everything below them and hide every other part, with a single
+      *  dataChanged. The folders above the parts are marked visible as well.
+      * @param parts are the items to keep, an empty list hides everything
+      */
+    void isolate( const QList<ModelPart*>& parts );
+
+    /** Forget the memory totals of the folders above some parts whose memory changed without
+      *  a change notification, such as when their levels of detail arrive
+      * @param parts are the items whose memory changed
+      */
+    void memoryChanged( const QList<ModelPart*>& parts );
+
+    /** Tell the views and the scene that some parts changed, with a single dataChanged
+      * @param parts are the items that changed, with everything below them
+      */
+    void partsChanged( const QList<ModelPart*>& parts );
+
 
 private:
+    void emitSubtreesChanged( const QList<ModelPart*>& parts );
+    qint64 subtreeBytes( ModelPart* item ) const;
+    void forgetMemoryTotals( ModelPart* part );
+    void handleDataChanged( const QModelIndex& topLeft, const QModelIndex& bottomRight );
+    void handleRowsInserted( const QModelIndex& parent, int first, int last );
+    void clearMemoryTotals();
+
     ModelPart *rootItem;    /**< This is a pointer to the item at the base of the tree */
+    mutable QHash<ModelPart*, qint64> folderBytes;  /**< Memory of each folder and everything below it, filled as rows are painted */
 };
 #endif
 
@@ -0,0 +1,320 @@
+// Header file for this class
+#include "NormalGenerator.h"
+#include "ModelPart.h"
+#include "ParallelFor.h"
+
+// Q includes
+#include <QTimer>
+
+// VTK headers
+#include <vtkCellArray.h>
+#include <vtkCellArrayIterator.h>
+#include <vtkFloatArray.h>
+#include <vtkMath.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace {
+
+// Smallest share of a mesh worth handing to another thread
+const size_t MIN_TRIANGLES_PER_CHUNK = 1 << 16;
+const size_t MIN_VERTICES_PER_CHUNK = 1 << 15;
+
+// Corners of one vertex whose normals are closer than this (as a cosine) share a copy of the vertex
+const float SAME_NORMAL = 0.9999f;
+
+// Triangle cells from uint32 corner indices
+template <typename ArrayT>
+void buildTriangles(vtkCellArray* cells, const std::vector<uint32_t>& corners) {
+    using ValueType = typename ArrayT::ValueType;
+    const vtkIdType triangles = vtkIdType(corners.size() / 3);
+
+    vtkNew<ArrayT> connectivity;
+    connectivity->SetNumberOfValues(3 * triangles);
+    std::copy(corners.begin(), corners.end(), connectivity->GetPointer(0));
+
+    vtkNew<ArrayT> offsets;
+    offsets->SetNumberOfValues(triangles + 1);
+    ValueType* offset = offsets->GetPointer(0);
+    for (vtkIdType i = 0; i <= triangles; ++i)
+        offset[i] = static_cast<ValueType>(3 * i);
+
+    cells->SetData(offsets, connectivity);
+}
+
+inline float dot(const float* a, const float* b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+} // namespace
+
+// Constructor
+NormalGenerator::NormalGenerator(QObject* parent)
+    : QObject(parent), jobs(this) {
+}
+
+// Destructor - the jobs wait for any mesh that is still being smoothed
+NormalGenerator::~NormalGenerator() {
+}
+
+// Queues a mesh for smoothing, or reuses the smooth mesh that was already built for it
+void NormalGenerator::request(ModelPart* part) {
+    vtkPolyData* mesh = part->getGeometry().polyData;
+    if (!mesh || mesh->GetNumberOfPolys() == 0)
+        return;
+
+    // A whole tree switching to smooth shading mostly hits here, one signal covers all of it
+    if (const vtkSmartPointer<vtkPolyData>* smooth = generated.find(mesh)) {
+        part->setSmoothGeometry(*smooth);
+        reused.append(part);
+        if (!reusedPending) {
+            reusedPending = true;
+            QTimer::singleShot(0, this, &NormalGenerator::emitReused);
+        }
+        return;
+    }
+
+    if (!generated.addWaiting(mesh, part))
+        return;
+
+    vtkSmartPointer<vtkPolyData> source = mesh;
+    const QString filePath = part->getFilePath();
+    const double featureAngle = angle;
+    const GeometryCache geometryCache = cache;
+    const MeshWelder::Options options = weldOptions;
+    jobs.start([source, filePath, featureAngle, geometryCache, options]() {
+        // Parts added on their own have no cache entry, both calls then do nothing
+        vtkSmartPointer<vtkPolyData> smooth = geometryCache.loadSmooth(filePath, options, featureAngle);
+        if (!smooth) {
+            smooth = generateSmooth(source, featureAngle);
+            geometryCache.storeSmooth(filePath, options, featureAngle, smooth);
+        }
+        return smooth;
+    }, [this, source](const vtkSmartPointer<vtkPolyData>& smooth) { assignSmooth(source, smooth); });
+}
+
+// Drops every request, jobs already running finish but their output is ignored
+void NormalGenerator::clear() {
+    jobs.cancel();
+    generated.clear();
+    reused.clear();
+}
+
+// Entries of meshes that were freed when their parts were released
+void NormalGenerator::prune() {
+    generated.prune();
+}
+
+// Sum of the actual memory size of every smooth mesh, VTK reports it in KiB
+qint64 NormalGenerator::totalBytes() const {
+    qint64 bytes = 0;
+    for (const auto& entry : generated)
+        bytes += qint64(entry.value->GetActualMemorySize()) * 1024;
+    return bytes;
+}
+
+void NormalGenerator::setCache(const GeometryCache& cache, const MeshWelder::Options& weldOptions) {
+    this->cache = cache;
+    this->weldOptions = weldOptions;
+}
+
+// Meshes split at another angle are no use any more, pending requests go with them
+void NormalGenerator::setFeatureAngle(double degrees) {
+    if (degrees == angle)
+        return;
+    angle = degrees;
+    clear();
+}
+
+double NormalGenerator::featureAngle() const {
+    return angle;
+}
+
+// Face normals, then one normal per group of corners around each vertex, then the split mesh
+vtkSmartPointer<vtkPolyData> NormalGenerator::generateSmooth(vtkPolyData* mesh, double featureAngle) {
+    vtkSmartPointer<vtkPolyData> smooth = vtkSmartPointer<vtkPolyData>::New();
+    vtkPoints* points = mesh->GetPoints();
+    vtkCellArray* polys = mesh->GetPolys();
+    if (!points || !polys)
+        return smooth;
+
+    const size_t vertexCount = size_t(points->GetNumberOfPoints());
+    std::vector<float> positions(3 * vertexCount);
+    if (vtkFloatArray* coords = vtkFloatArray::FastDownCast(points->GetData())) {
+        std::memcpy(positions.data(), coords->GetPointer(0), positions.size() * sizeof(float));
+    }
+    else {
+        double point[3];
+        for (size_t i = 0; i < vertexCount; ++i) {
+            points->GetPoint(vtkIdType(i), point);
+            for (int axis = 0; axis < 3; ++axis)
+                positions[3 * i + axis] = float(point[axis]);
+        }
+    }
+
+    // An iterator of its own keeps the traversal safe next to readers on other threads
+    std::vector<uint32_t> corners;
+    corners.reserve(3 * size_t(polys->GetNumberOfCells()));
+    vtkSmartPointer<vtkCellArrayIterator> cell = vtk::TakeSmartPointer(polys->NewIterator());
+    for (cell->GoToFirstCell(); !cell->IsDoneWithTraversal(); cell->GoToNextCell()) {
+        vtkIdType size;
+        const vtkIdType* ids;
+        cell->GetCurrentCell(size, ids);
+        for (vtkIdType i = 2; i < size; ++i) {
+            corners.push_back(uint32_t(ids[0]));
+            corners.push_back(uint32_t(ids[i - 1]));
+            corners.push_back(uint32_t(ids[i]));
+        }
+    }
+    const size_t triangleCount = corners.size() / 3;
+    const size_t triangleChunks = parallelChunkCount(triangleCount, MIN_TRIANGLES_PER_CHUNK);
+    const size_t vertexChunks = parallelChunkCount(vertexCount, MIN_VERTICES_PER_CHUNK);
+
+    // Face normals, area weighted for summing and unit length for the angle test
+    std::vector<float> weighted(3 * triangleCount);
+    std::vector<float> unit(3 * triangleCount);
+    parallelFor(triangleCount, triangleChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            const float* a = &positions[3 * size_t(corners[3 * t])];
+            const float* b = &positions[3 * size_t(corners[3 * t + 1])];
+            const float* c = &positions[3 * size_t(corners[3 * t + 2])];
+            const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+            float* n = &weighted[3 * t];
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+            const float length = std::sqrt(dot(n, n));
+            const float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            for (int axis = 0; axis < 3; ++axis)
+                unit[3 * t + axis] = n[axis] * scale;
+        }
+    });
+
+    // Corners around each vertex as compressed rows, in triangle order so the result is deterministic
+    std::vector<uint32_t> firstCorner(vertexCount + 1, 0);
+    for (uint32_t v : corners)
+        ++firstCorner[size_t(v) + 1];
+    for (size_t v = 0; v < vertexCount; ++v)
+        firstCorner[v + 1] += firstCorner[v];
+    std::vector<uint32_t> vertexCorners(corners.size());
+    {
+        std::vector<uint32_t> next(firstCorner.begin(), firstCorner.end() - 1);
+        for (size_t c = 0; c < corners.size(); ++c)
+            vertexCorners[next[corners[c]]++] = uint32_t(c);
+    }
+
+    // Each corner sums the faces around its vertex that are within the feature angle of its own face,
+    // corners that end up with the same normal share one output vertex
+    const float cosAngle = float(std::cos(vtkMath::RadiansFromDegrees(featureAngle)));
+    std::vector<uint32_t> cornerGroup(corners.size());      // Group of each slot of vertexCorners
+    std::vector<float> groupNormals(3 * corners.size());    // Group g of vertex v sits at slot firstCorner[v] + g
+    std::vector<uint32_t> firstOutput(vertexCount + 1, 0);  // Group counts, then the first output vertex of each vertex
+    parallelFor(vertexCount, vertexChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            const uint32_t first = firstCorner[v];
+            const uint32_t last = firstCorner[v + 1];
+            uint32_t groups = 0;
+
+            for (uint32_t i = first; i < last; ++i) {
+                const float* own = &unit[3 * size_t(vertexCorners[i] / 3)];
+                // A degenerate face has no direction of its own and takes the average of all its neighbours
+                const bool degenerate = dot(own, own) == 0.0f;
+                float sum[3] = { 0.0f, 0.0f, 0.0f };
+                for (uint32_t j = first; j < last; ++j) {
+                    const size_t other = vertexCorners[j] / 3;
+                    if (degenerate || dot(own, &unit[3 * other]) >= cosAngle) {
+                        for (int axis = 0; axis < 3; ++axis)
+                            sum[axis] += weighted[3 * other + axis];
+                    }
+                }
+
+                const float length = std::sqrt(dot(sum, sum));
+                for (int axis = 0; axis < 3; ++axis)
+                    sum[axis] = length > 0.0f ? sum[axis] / length : own[axis];
+
+                uint32_t group = 0;
+                while (group < groups && dot(&groupNormals[3 * size_t(first + group)], sum) < SAME_NORMAL)
+                    ++group;
+                if (group == groups) {
+                    std::copy(sum, sum + 3, &groupNormals[3 * size_t(first + group)]);
+                    ++groups;
+                }
+                cornerGroup[i] = group;
+            }
+            firstOutput[v + 1] = groups;
+        }
+    });
+    for (size_t v = 0; v < vertexCount; ++v)
+        firstOutput[v + 1] += firstOutput[v];
+    const size_t outputCount = firstOutput[vertexCount];
+
+    // Every vertex writes its own copies and its own corners, so the chunks never overlap
+    vtkNew<vtkFloatArray> outputCoords;
+    outputCoords->SetNumberOfComponents(3);
+    outputCoords->SetNumberOfTuples(vtkIdType(outputCount));
+    vtkNew<vtkFloatArray> normals;
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(vtkIdType(outputCount));
+    float* outputPosition = outputCoords->GetPointer(0);
+    float* outputNormal = normals->GetPointer(0);
+    std::vector<uint32_t> outputCorners(corners.size());
+
+    parallelFor(vertexCount, vertexChunks, [&](size_t, size_t begin, size_t end) {
+        for (size_t v = begin; v < end; ++v) {
+            const uint32_t first = firstCorner[v];
+            for (uint32_t copy = firstOutput[v]; copy < firstOutput[v + 1]; ++copy) {
+                std::memcpy(outputPosition + 3 * size_t(copy), &positions[3 * v], 3 * sizeof(float));
+                std::memcpy(outputNormal + 3 * size_t(copy), &groupNormals[3 * size_t(first + copy - firstOutput[v])],
+                            3 * sizeof(float));
+            }
+            for (uint32_t i = first; i < firstCorner[v + 1]; ++i)
+                outputCorners[vertexCorners[i]] = firstOutput[v] + cornerGroup[i];
+        }
+    });
+
+    vtkNew<vtkPoints> outputPoints;
+    outputPoints->SetData(outputCoords);
+
+    vtkNew<vtkCellArray> cells;
+    if (outputCorners.size() <= size_t(std::numeric_limits<vtkTypeInt32>::max()))
+        buildTriangles<vtkTypeInt32Array>(cells, outputCorners);
+    else
+        buildTriangles<vtkTypeInt64Array>(cells, outputCorners);
+
+    smooth->SetPoints(outputPoints);
+    smooth->SetPolys(cells);
+    smooth->GetPointData()->SetNormals(normals);
+    return smooth;
+}
+
+void NormalGenerator::emitReused() {
+    reusedPending = false;
+    const QList<ModelPart*> parts = std::move(reused);
+    reused.clear();
+    if (!parts.isEmpty())
+        emit normalsReady(parts);
+}
+
+// Gives the finished smooth mesh to every part that shares the flat mesh
+void NormalGenerator::assignSmooth(vtkPolyData* mesh, vtkPolyData* smooth) {
+    generated.insert(mesh, smooth);
+
+    const QList<ModelPart*> parts = generated.takeWaiting(mesh);
+    for (ModelPart* part : parts)
+        part->setSmoothGeometry(smooth);
+
+    if (!parts.isEmpty())
+        emit normalsReady(parts);
+}
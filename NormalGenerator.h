@@ -0,0 +1,93 @@
+#ifndef VIEWER_NORMALGENERATOR_H
+#define VIEWER_NORMALGENERATOR_H
+
+#include <QObject>
+#include <QList>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include "GeometryCache.h"
+#include "MeshJobs.h"
+#include "MeshWelder.h"
+
+class ModelPart;
+
+/* Builds smooth shading meshes for loaded parts on the shared background pool.
+ * Each vertex gets one normal per group of its triangles that meet at less than the feature
+ * angle, so rounded surfaces shade smoothly while sharp CAD edges stay crisp; a vertex on such
+ * an edge is split into one copy per side. Meshes are processed once per distinct mesh, several
+ * at a time, and the work inside a large mesh is spread across cores as well. Finished meshes
+ * are added to the part's .stlcache entry, so they are read back instead of rebuilt next time.
+ */
+class NormalGenerator : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param parent is used by the QObject constructor
+      */
+    explicit NormalGenerator(QObject* parent = nullptr);
+
+    /** Destructor - abandons queued jobs and waits for running ones
+      */
+    ~NormalGenerator();
+
+    /** Queue a smooth mesh for a part, parts whose mesh already has one get it at once
+      * @param part is a loaded part, it must stay alive until normalsReady or clear()
+      */
+    void request(ModelPart* part);
+
+    /** Forget every pending request and generated mesh, call before the parts are deleted
+      */
+    void clear();
+
+    /** Forget the smooth meshes of meshes that no part uses any more, so their memory is freed
+      */
+    void prune();
+
+    /** @return the memory held by every smooth mesh in bytes
+      */
+    qint64 totalBytes() const;
+
+    /** Set where smooth meshes are looked up and stored, used by requests made after this call
+      * @param cache is the geometry cache of the repository, a cache without a directory is skipped
+      * @param weldOptions are the options the parts were loaded with
+      */
+    void setCache(const GeometryCache& cache, const MeshWelder::Options& weldOptions);
+
+    /** Change the feature angle, meshes built with another angle are forgotten
+      * @param degrees is the largest angle between two triangles that is still shaded smoothly
+      */
+    void setFeatureAngle(double degrees);
+    double featureAngle() const;
+
+    /** Compute per vertex normals, splitting vertices along edges sharper than the feature angle
+      * @param mesh is the flat mesh, polygons with more than three corners are split into fans
+      * @param featureAngle is in degrees
+      * @return a triangle mesh in the same frame with float point normals
+      */
+    static vtkSmartPointer<vtkPolyData> generateSmooth(vtkPolyData* mesh, double featureAngle);
+
+signals:
+    /** Emitted on the GUI thread once smooth meshes have been assigned to some parts */
+    void normalsReady(const QList<ModelPart*>& parts);
+
+private:
+    void assignSmooth(vtkPolyData* mesh, vtkPolyData* smooth);
+    void emitReused();
+
+    MeshJobs jobs;
+    double angle = 30.0;
+    GeometryCache cache;
+    MeshWelder::Options weldOptions;
+
+    /* Smooth mesh of each flat mesh */
+    MeshResults<vtkSmartPointer<vtkPolyData>> generated;
+
+    /* Parts given an existing smooth mesh since the last pass of the event loop, announced together */
+    QList<ModelPart*> reused;
+    bool reusedPending = false;
+};
+
+#endif // VIEWER_NORMALGENERATOR_H
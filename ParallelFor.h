@@ -0,0 +1,85 @@
+#ifndef VIEWER_PARALLELFOR_H
+#define VIEWER_PARALLELFOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/* Small helpers for splitting array work across cores inside a single part. Loading already
+ * runs one part per pool thread, so these only spread out once a range is large enough that
+ * a single mesh would otherwise keep one core busy on its own. The helper threads of every
+ * parallelFor() in the process share one budget of hardware threads - 1, so pool workers that
+ * all split a large part at once do not start cores x cores threads between them; a call that
+ * finds the budget used up runs its chunks on the calling thread.
+ */
+
+/** Number of chunks to split a range into
+  * @param count is the number of items in the range
+  * @param minPerChunk is the smallest amount of work worth giving a thread
+  * @return a chunk count between 1 and the number of hardware threads
+  */
+inline size_t parallelChunkCount(size_t count, size_t minPerChunk) {
+    size_t threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    size_t chunks = minPerChunk > 0 ? count / minPerChunk : threads;
+    return std::max<size_t>(1, std::min(threads, chunks));
+}
+
+/** Helper threads that may still be started, shared by every parallelFor() call */
+inline std::atomic<size_t>& parallelHelperBudget() {
+    static std::atomic<size_t> budget(std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+    return budget;
+}
+
+/** Take up to wanted helper threads from the shared budget
+  * @return the number taken, hand them back with releaseParallelHelpers()
+  */
+inline size_t reserveParallelHelpers(size_t wanted) {
+    std::atomic<size_t>& budget = parallelHelperBudget();
+    size_t available = budget.load();
+    size_t taken;
+    do {
+        taken = std::min(wanted, available);
+    } while (!budget.compare_exchange_weak(available, available - taken));
+    return taken;
+}
+
+inline void releaseParallelHelpers(size_t count) {
+    parallelHelperBudget() += count;
+}
+
+/** Run body(chunk, begin, end) over [0, count) split into contiguous chunks. Chunk i always
+  *  covers a lower range than chunk i + 1, so per chunk results can be combined in order.
+  * @param count is the number of items in the range
+  * @param chunks is the number of pieces, usually from parallelChunkCount()
+  * @param body is called once per chunk, concurrently when chunks > 1 and helpers are free
+  */
+template <typename Body>
+void parallelFor(size_t count, size_t chunks, Body body) {
+    if (chunks <= 1 || count == 0) {
+        body(size_t(0), size_t(0), count);
+        return;
+    }
+
+    // Chunks are claimed in order by whichever thread is free, the caller included
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t chunk = next++; chunk < chunks; chunk = next++)
+            body(chunk, count * chunk / chunks, count * (chunk + 1) / chunks);
+    };
+
+    const size_t helpers = reserveParallelHelpers(chunks - 1);
+    std::vector<std::thread> threads;
+    threads.reserve(helpers);
+    for (size_t i = 0; i < helpers; ++i)
+        threads.emplace_back(work);
+
+    work();
+
+    for (std::thread& thread : threads)
+        thread.join();
+    releaseParallelHelpers(helpers);
+}
+
+#endif // VIEWER_PARALLELFOR_H
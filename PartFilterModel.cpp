@@ -0,0 +1,167 @@
+// Header file for this class
+#include "PartFilterModel.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+// Q includes
+#include <QHash>
+#include <QIdentityProxyModel>
+#include <QVector>
+
+#include <algorithm>
+
+/* Passes the parts list through unchanged, so the proxy can be told that rows changed without the
+ * parts list itself announcing it to everything else connected to it
+ */
+class FilterRelay : public QIdentityProxyModel {
+public:
+    using QIdentityProxyModel::QIdentityProxyModel;
+
+    void rowsChanged(const QModelIndex& parent, int first, int last, int role) {
+        emit dataChanged(index(first, 0, parent), index(last, 0, parent), { role });
+    }
+};
+
+namespace {
+
+// Adds every part below a folder
+void addDescendants(ModelPart* folder, QSet<ModelPart*>& parts) {
+    for (int i = 0; i < folder->childCount(); ++i) {
+        ModelPart* child = folder->child(i);
+        parts.insert(child);
+        addDescendants(child, parts);
+    }
+}
+
+// Number of folders above a part
+int depthOf(ModelPart* part) {
+    int depth = 0;
+    for (ModelPart* item = part->parentItem(); item; item = item->parentItem())
+        ++depth;
+    return depth;
+}
+
+} // namespace
+
+// Constructor
+PartFilterModel::PartFilterModel(QObject* parent)
+    : QSortFilterProxyModel(parent), relay(new FilterRelay(this)) {
+}
+
+// The proxy filters the relay, which shows the parts list with the same internal pointers
+void PartFilterModel::setPartList(ModelPartList* list) {
+    partList = list;
+    relay->setSourceModel(list);
+    setSourceModel(relay);
+}
+
+// Walks up from each match until it reaches a folder that is already shown. Only rows that entered
+// or left the shown set, or sit below a match that came or went, can change while filtering
+void PartFilterModel::setMatches(const QSet<ModelPart*>& parts) {
+    const QSet<ModelPart*> oldMatches = matches;
+    const QSet<ModelPart*> oldShown = shown;
+
+    matches = parts;
+    shown.clear();
+    shown.reserve(parts.size());
+    for (ModelPart* part : parts) {
+        for (ModelPart* item = part; item && !shown.contains(item); item = item->parentItem())
+            shown.insert(item);
+    }
+
+    if (!filtering) {
+        filtering = true;
+        invalidateFilter();
+        return;
+    }
+
+    QSet<ModelPart*> changed;
+    for (ModelPart* part : oldShown) {
+        if (!shown.contains(part))
+            changed.insert(part);
+    }
+    for (ModelPart* part : shown) {
+        if (!oldShown.contains(part))
+            changed.insert(part);
+    }
+    for (ModelPart* part : oldMatches) {
+        if (!matches.contains(part))
+            addDescendants(part, changed);
+    }
+    for (ModelPart* part : matches) {
+        if (!oldMatches.contains(part))
+            addDescendants(part, changed);
+    }
+    refilter(changed);
+}
+
+void PartFilterModel::clearMatches() {
+    if (!filtering)
+        return;
+
+    filtering = false;
+    matches.clear();
+    shown.clear();
+    invalidateFilter();
+}
+
+bool PartFilterModel::isFiltering() const {
+    return filtering;
+}
+
+// Proxy indices carry the proxy's own pointers, the part comes from the source index
+ModelPart* PartFilterModel::partFromIndex(const QModelIndex& index) const {
+    if (!index.isValid())
+        return nullptr;
+    return static_cast<ModelPart*>(mapToSource(index).internalPointer());
+}
+
+QModelIndex PartFilterModel::indexFromPartList(const QModelIndex& index) const {
+    return mapFromSource(relay->mapFromSource(index));
+}
+
+// Folders go before the rows below them, the proxy decides a row only once its parent is mapped
+void PartFilterModel::refilter(const QSet<ModelPart*>& parts) {
+    QHash<ModelPart*, QVector<int>> rows;
+    for (ModelPart* part : parts) {
+        if (part && part->parentItem())
+            rows[part->parentItem()].append(part->row());
+    }
+
+    QVector<QPair<int, ModelPart*>> folders;
+    folders.reserve(rows.size());
+    for (auto it = rows.cbegin(); it != rows.cend(); ++it)
+        folders.append({ depthOf(it.key()), it.key() });
+    std::sort(folders.begin(), folders.end());
+
+    // One notification per run of neighbouring rows
+    for (const QPair<int, ModelPart*>& folder : folders) {
+        QVector<int>& folderRows = rows[folder.second];
+        std::sort(folderRows.begin(), folderRows.end());
+        const QModelIndex parent = relay->mapFromSource(partList->indexOf(folder.second));
+        int first = folderRows.front();
+        for (int i = 1; i <= folderRows.size(); ++i) {
+            if (i < folderRows.size() && folderRows[i] == folderRows[i - 1] + 1)
+                continue;
+            relay->rowsChanged(parent, first, folderRows[i - 1], filterRole());
+            if (i < folderRows.size())
+                first = folderRows[i];
+        }
+    }
+}
+
+// Matches and the folders above them are in the shown set, rows below a matching folder are found by walking up
+bool PartFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const {
+    if (!filtering)
+        return true;
+
+    ModelPart* part = static_cast<ModelPart*>(sourceModel()->index(sourceRow, 0, sourceParent).internalPointer());
+    if (shown.contains(part))
+        return true;
+
+    for (ModelPart* item = part ? part->parentItem() : nullptr; item; item = item->parentItem()) {
+        if (matches.contains(item))
+            return true;
+    }
+    return false;
+}
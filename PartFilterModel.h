@@ -0,0 +1,71 @@
+#ifndef VIEWER_PARTFILTERMODEL_H
+#define VIEWER_PARTFILTERMODEL_H
+
+#include <QSortFilterProxyModel>
+#include <QSet>
+
+class ModelPart;
+class ModelPartList;
+class FilterRelay;
+
+/* Shows the parts tree narrowed to a set of matching parts, as found by PartSearch.
+ * A row stays if it matches, if it is a folder above a match, or if it is below a matching
+ * folder, so searching for a folder name shows what is in it. The sets are filled once per
+ * query and each row is then decided with a hash lookup and a walk up its ancestors, so the
+ * proxy never compares names itself. A new query only reports the rows whose answer may have
+ * changed, through an identity model sitting between the parts list and the proxy, so typing
+ * does not refilter the whole tree.
+ */
+class PartFilterModel : public QSortFilterProxyModel {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param parent is used by the QObject constructor
+      */
+    explicit PartFilterModel(QObject* parent = nullptr);
+
+    /** Show a parts list, use this instead of setSourceModel()
+      * @param list is the model whose rows are filtered
+      */
+    void setPartList(ModelPartList* list);
+
+    /** Narrow the tree to some parts and the folders above them
+      * @param parts are the matches, an empty set hides every row
+      */
+    void setMatches(const QSet<ModelPart*>& parts);
+
+    /** Show every row again
+      */
+    void clearMatches();
+
+    /** @return true while the tree is narrowed to matches
+      */
+    bool isFiltering() const;
+
+    /** Get the part behind an index of this model
+      * @param index is an index of the proxy, as handed out by a view showing it
+      * @return the part, or nullptr for an invalid index
+      */
+    ModelPart* partFromIndex(const QModelIndex& index) const;
+
+    /** Get the index of this model showing a row of the parts list
+      * @param index is an index of the parts list
+      * @return the proxy index, invalid if the row is filtered out
+      */
+    QModelIndex indexFromPartList(const QModelIndex& index) const;
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex& sourceParent) const override;
+
+private:
+    void refilter(const QSet<ModelPart*>& parts);
+
+    ModelPartList* partList = nullptr;
+    FilterRelay* relay;
+    bool filtering = false;
+    QSet<ModelPart*> matches;
+    QSet<ModelPart*> shown;     /**< Matches and every folder above them */
+};
+
+#endif // VIEWER_PARTFILTERMODEL_H
@@ -0,0 +1,365 @@
+// Header file for this class
+#include "PartLoader.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "LoadProfiler.h"
+
+// Q includes
+#include <QFileInfo>
+#include <QFileInfoList>
+#include <QMutexLocker>
+#include <QThread>
+
+// How often finished parts are moved from the workers into the tree
+static const int FLUSH_INTERVAL_MS = 100;
+
+// Constructor
+PartLoader::PartLoader(ModelPartList* partList, QObject* parent)
+    : QObject(parent), partList(partList), partsCancelled(std::make_shared<std::atomic<bool>>(false)) {
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    partPool.setMaxThreadCount(QThread::idealThreadCount());
+
+    flushTimer.setInterval(FLUSH_INTERVAL_MS);
+    connect(&flushTimer, &QTimer::timeout, this, &PartLoader::flushResults);
+}
+
+// Destructor - the pool destructor waits for any jobs that are still running
+PartLoader::~PartLoader() {
+    cancel();
+    cancelParts();
+}
+
+// Starts scanning the folder on the pool, parse jobs are queued by the scan as files are found
+void PartLoader::loadFolder(const QString& folderPath) {
+    cancel();
+
+    session = std::make_shared<Session>();
+    session->deferred = deferred;
+    session->weldOptions = weldOptions;
+    if (cacheEnabled)
+        session->cache = GeometryCache(GeometryCache::directoryFor(folderPath));
+    partWeldOptions = session->weldOptions;
+    partCache = session->cache;
+    folderItems.clear();
+    folderItems.insert(QString(), partList->getRootItem());
+    pendingRows.clear();
+    loaded = 0;
+    total = 0;
+
+    std::shared_ptr<Session> s = session;
+    QThreadPool* p = &pool;
+    pool.start([s, p, folderPath]() {
+        scanFolder(s, p, QDir(folderPath), QString());
+        s->scanDone = true;
+    });
+
+    flushTimer.start();
+    emit progress(0, 0);
+}
+
+// Stops the current load, queued jobs are dropped and running jobs discard their output
+void PartLoader::cancel() {
+    if (!session)
+        return;
+
+    session->cancelled = true;
+    session.reset();
+    pool.clear();
+    flushTimer.stop();
+    discardPendingRows();
+
+    emit finished(loaded, total, true);
+}
+
+// Returns true while a load is in progress
+bool PartLoader::isLoading() const {
+    return session != nullptr;
+}
+
+// Sets the welding used by the next load
+void PartLoader::setWeldOptions(const MeshWelder::Options& options) {
+    weldOptions = options;
+}
+
+// Enables or disables the disk cache for the next load
+void PartLoader::setCacheEnabled(bool enabled) {
+    cacheEnabled = enabled;
+}
+
+// Enables or disables on demand geometry for the next load
+void PartLoader::setDeferred(bool deferred) {
+    this->deferred = deferred;
+}
+
+GeometryCache PartLoader::currentCache() const {
+    return partCache;
+}
+
+MeshWelder::Options PartLoader::currentWeldOptions() const {
+    return partWeldOptions;
+}
+
+// Reads one deferred part on the pool and attaches its geometry on the GUI thread
+void PartLoader::loadPart(ModelPart* part) {
+    if (!part || part->getLoadState() != ModelPart::LoadState::Unloaded)
+        return;
+
+    part->setLoadState(ModelPart::LoadState::Loading);
+    const QModelIndex index = partList->indexOf(part);
+    emit partList->dataChanged(index, index);
+    ++pending;
+
+    const QString filePath = part->getFilePath();
+    const MeshWelder::Options options = partWeldOptions;
+    const GeometryCache cache = partCache;
+    const CompactGeometry compact = part->getCompactGeometry();
+    std::shared_ptr<std::atomic<bool>> token = partsCancelled;
+    partPool.start([this, part, filePath, options, cache, compact, token]() {
+        if (*token)
+            return;
+
+        // A part released to a compact copy takes the exact mesh from the disk cache when it is there,
+        // otherwise the copy is decoded in memory. The file is not parsed again either way
+        PartGeometry geometry;
+        bool decoded = false;
+        if (compact.mesh) {
+            PartGeometry cached;
+            {
+                ScopedLoadTimer timer(filePath, LoadProfiler::CacheLookup);
+                cached = cache.load(filePath, options);
+            }
+
+            ScopedLoadTimer timer(filePath, LoadProfiler::Intern);
+            if (cached.polyData) {
+                geometry = GeometryRegistry::instance().internLocal(cached.polyData, cached.origin);
+            }
+            else {
+                geometry = GeometryRegistry::instance().internLocal(compact.mesh->decode(), compact.origin);
+                decoded = true;
+            }
+        }
+        else {
+            geometry = loadPartGeometry(filePath, options, cache);
+        }
+
+        QMetaObject::invokeMethod(this, [this, part, geometry, compact, decoded, token]() {
+            if (*token) {
+                GeometryRegistry::instance().release(geometry);
+                return;
+            }
+            --pending;
+
+            if (geometry.polyData && geometry.polyData->GetNumberOfPoints() > 0) {
+                part->setGeometry(geometry);
+                part->setLoadState(ModelPart::LoadState::Loaded);
+                // A decoded mesh keeps the copy it came from, hiding the part again reuses that copy
+                // rather than encoding the decode and measuring its error against the wrong mesh
+                if (decoded)
+                    part->setCompactGeometry(compact);
+            }
+            else {
+                GeometryRegistry::instance().release(geometry);
+                part->setLoadState(ModelPart::LoadState::Failed);
+            }
+
+            const QModelIndex index = partList->indexOf(part);
+            emit partList->dataChanged(index, index);
+            emit partLoaded(part);
+        }, Qt::QueuedConnection);
+    });
+}
+
+// Drops every on demand load, the parts waiting for them may be deleted next
+void PartLoader::cancelParts() {
+    *partsCancelled = true;
+    partsCancelled = std::make_shared<std::atomic<bool>>(false);
+    partPool.clear();
+    pending = 0;
+}
+
+// Returns the number of on demand loads still in flight
+int PartLoader::pendingParts() const {
+    return pending;
+}
+
+// Reads one part, preferring the disk cache over parsing the STL file
+PartGeometry PartLoader::loadPartGeometry(const QString& filePath, const MeshWelder::Options& weldOptions,
+                                          const GeometryCache& cache) {
+    PartGeometry cached;
+    {
+        ScopedLoadTimer timer(filePath, LoadProfiler::CacheLookup);
+        cached = cache.load(filePath, weldOptions);
+    }
+    if (cached.polyData) {
+        ScopedLoadTimer timer(filePath, LoadProfiler::Intern);
+        return GeometryRegistry::instance().internLocal(cached.polyData, cached.origin);
+    }
+
+    // The stamp is taken before the read so an entry can never claim newer contents than it holds
+    GeometryCache::FileStamp stamp = GeometryCache::stamp(filePath);
+
+    // Duplicates are dropped by the registry, so only distinct meshes stay in memory
+    vtkSmartPointer<vtkPolyData> mesh = ModelPart::readSTL(filePath, weldOptions, &stamp.hash);
+    PartGeometry geometry;
+    {
+        ScopedLoadTimer timer(filePath, LoadProfiler::Intern);
+        geometry = GeometryRegistry::instance().intern(mesh);
+    }
+
+    ScopedLoadTimer timer(filePath, LoadProfiler::CacheStore);
+    cache.store(filePath, weldOptions, stamp, geometry);
+    return geometry;
+}
+
+// Recursively walks a directory, queuing a parse job per STL file and recording folder nodes
+void PartLoader::scanFolder(const std::shared_ptr<Session>& session, QThreadPool* pool,
+                            const QDir& dir, const QString& relativePath) {
+    QStringList filters;
+    filters << "*.stl" << "*.STL";
+
+    // Entries keep the sorted order of the listing, files before folders, however the jobs finish
+    int position = 0;
+
+    // Queue the STL files in this directory
+    const QFileInfoList fileList = dir.entryInfoList(filters, QDir::Files);
+    for (const QFileInfo& fileInfo : fileList) {
+        if (session->cancelled)
+            return;
+
+        Result result;
+        result.folder = relativePath;
+        result.position = position++;
+        result.name = fileInfo.fileName();
+        result.path = fileInfo.absoluteFilePath();
+
+        ++session->total;
+
+        // Deferred parts only need their path, they are complete as soon as they are found
+        if (session->deferred) {
+            result.deferred = true;
+            QMutexLocker lock(&session->mutex);
+            session->results.append(result);
+            ++session->completed;
+            continue;
+        }
+
+        pool->start([session, result]() mutable {
+            if (session->cancelled)
+                return;
+
+            result.geometry = loadPartGeometry(result.path, session->weldOptions, session->cache);
+
+            QMutexLocker lock(&session->mutex);
+            session->results.append(result);
+            ++session->completed;
+        });
+    }
+
+    // Now handle subdirectories, the folder entry is queued before any of its contents
+    const QFileInfoList dirList = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QFileInfo& subdirInfo : dirList) {
+        if (session->cancelled)
+            return;
+
+        Result folder;
+        folder.isFolder = true;
+        folder.folder = relativePath;
+        folder.position = position++;
+        folder.name = subdirInfo.fileName();
+        folder.path = relativePath.isEmpty() ? folder.name : relativePath + "/" + folder.name;
+
+        {
+            QMutexLocker lock(&session->mutex);
+            session->results.append(folder);
+        }
+
+        scanFolder(session, pool, QDir(subdirInfo.absoluteFilePath()), folder.path);
+    }
+}
+
+// Moves everything the workers have finished into the tree in scan order, one insertion per parent
+// folder. An entry that finished before an earlier sibling waits for it, so rows never depend on
+// which job was quickest
+void PartLoader::flushResults() {
+    if (!session)
+        return;
+
+    QList<Result> batch;
+    bool done;
+    {
+        QMutexLocker lock(&session->mutex);
+        batch.swap(session->results);
+        total = session->total;
+        done = session->scanDone && session->completed == total;
+    }
+
+    // Parents are always seen before their own children
+    QList<ModelPart*> parents;
+
+    for (const Result& result : batch) {
+        ModelPart* parentItem = folderItems.value(result.folder, partList->getRootItem());
+        ModelPart* item = new ModelPart({ result.name, 0 });
+
+        if (result.isFolder) {
+            folderItems.insert(result.path, item);
+        }
+        else {
+            item->setVisible(false);  // Default invisible
+            item->setFilePath(result.path);
+            if (result.deferred) {
+                item->setLoadState(ModelPart::LoadState::Unloaded);
+            }
+            else if (result.geometry.polyData && result.geometry.polyData->GetNumberOfPoints() > 0) {
+                item->setGeometry(result.geometry);
+            }
+            else {
+                // Unreadable files stay in the tree styled as failures, the same as an on demand load
+                GeometryRegistry::instance().release(result.geometry);
+                item->setLoadState(ModelPart::LoadState::Failed);
+            }
+            ++loaded;
+        }
+
+        if (!parents.contains(parentItem))
+            parents.append(parentItem);
+        pendingRows[parentItem].parts.insert(result.position, item);
+    }
+
+    for (ModelPart* parentItem : parents) {
+        PendingRows& pending = pendingRows[parentItem];
+        QList<ModelPart*> rows;
+        for (auto it = pending.parts.begin(); it != pending.parts.end() && it.key() == pending.next;) {
+            rows.append(it.value());
+            it = pending.parts.erase(it);
+            ++pending.next;
+        }
+
+        // A folder that is itself still held takes its rows directly, they join the tree with it
+        ModelPart* top = parentItem;
+        while (top->parentItem())
+            top = top->parentItem();
+        if (top == partList->getRootItem()) {
+            partList->appendParts(parentItem, rows);
+        }
+        else {
+            for (ModelPart* row : rows)
+                parentItem->appendChild(row);
+        }
+    }
+
+    emit progress(loaded, total);
+
+    if (done) {
+        session.reset();
+        flushTimer.stop();
+        pendingRows.clear();
+        emit finished(loaded, total, false);
+    }
+}
+
+// Entries held for an earlier sibling are not in the tree, so nothing else deletes them
+void PartLoader::discardPendingRows() {
+    for (const PendingRows& pending : pendingRows)
+        qDeleteAll(pending.parts);
+    pendingRows.clear();
+}
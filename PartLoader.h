@@ -0,0 +1,182 @@
+#ifndef VIEWER_PARTLOADER_H
+#define VIEWER_PARTLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QMap>
+#include <QDir>
+#include <QMutex>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+
+#include <vtkSmartPointer.h>
+#include <vtkPolyData.h>
+
+#include "MeshWelder.h"
+#include "GeometryRegistry.h"
+#include "GeometryCache.h"
+
+class ModelPart;
+class ModelPartList;
+
+/* Loads a folder of STL files into a ModelPartList without blocking the GUI thread.
+ * The folder tree is scanned by a worker, each STL file is parsed as its own job on a
+ * thread pool, and finished parts are handed back to the GUI thread in batches by a timer
+ * so the tree fills in progressively while the window stays responsive.
+ * In deferred mode the scan only creates file nodes and the geometry of a part is read
+ * later, when loadPart() is called for it.
+ */
+class PartLoader : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param partList is the tree that loaded parts are added to
+      * @param parent is used by the QObject constructor
+      */
+    explicit PartLoader(ModelPartList* partList, QObject* parent = nullptr);
+
+    /** Destructor - cancels any load in progress and waits for the workers to stop
+      */
+    ~PartLoader();
+
+    /** Start loading every STL file below a folder, any load already in progress is cancelled first
+      * @param folderPath is the repository folder to load
+      */
+    void loadFolder(const QString& folderPath);
+
+    /** Abandon the current load, parts that have already been added stay in the tree
+      */
+    void cancel();
+
+    /** Read the geometry of a part that was added without it, does nothing for other parts.
+      *  A part holding a compact copy of its mesh takes it from the disk cache, or decodes the copy when
+      *  the cache has no entry, instead of parsing its file
+      * @param part is an Unloaded part, it is Loading until partLoaded is emitted
+      */
+    void loadPart(ModelPart* part);
+
+    /** Abandon every loadPart() call that has not finished, call before the parts are deleted
+      */
+    void cancelParts();
+
+    /** @return the number of loadPart() calls that have not finished yet
+      */
+    int pendingParts() const;
+
+    /** @return true while a folder is being loaded
+      */
+    bool isLoading() const;
+
+    /** Set how vertices are welded for loads started after this call
+      * @param options is the welding mode and tolerance
+      */
+    void setWeldOptions(const MeshWelder::Options& options);
+
+    /** Turn the on disk geometry cache on or off for loads started after this call
+      */
+    void setCacheEnabled(bool enabled);
+
+    /** Only create file nodes when a folder is loaded, their geometry is read on demand.
+      *  Applies to loads started after this call.
+      */
+    void setDeferred(bool deferred);
+
+    /** @return the geometry cache used by the last folder load and by loadPart()
+      */
+    GeometryCache currentCache() const;
+
+    /** @return the welding options used by the last folder load and by loadPart()
+      */
+    MeshWelder::Options currentWeldOptions() const;
+
+    /** Load the geometry of one STL file, from the disk cache if it holds a valid entry,
+      *  otherwise by parsing and welding the file and then filling the cache. Thread safe.
+      * @param filePath is the STL file
+      * @param weldOptions selects how vertices are merged
+      * @param cache is the cache to use, a cache without a directory is skipped
+      * @return the interned geometry
+      */
+    static PartGeometry loadPartGeometry(const QString& filePath, const MeshWelder::Options& weldOptions,
+                                         const GeometryCache& cache);
+
+signals:
+    /** Emitted after every batch, total grows while the folder tree is still being scanned */
+    void progress(int loaded, int total);
+
+    /** Emitted once when the load completes or is cancelled */
+    void finished(int loaded, int total, bool cancelled);
+
+    /** Emitted when a loadPart() call completes, the part is then Loaded or Failed */
+    void partLoaded(ModelPart* part);
+
+private slots:
+    void flushResults();
+
+private:
+    /* One entry produced by the workers, either a folder or a parsed STL file */
+    struct Result {
+        QString folder;                             /**< Relative path of the folder the entry lives in */
+        QString name;                               /**< Name shown in the tree */
+        QString path;                               /**< Absolute file path, or relative path for folders */
+        int position = 0;                           /**< Row among the folder's entries in scan order, files first */
+        bool isFolder = false;
+        bool deferred = false;                      /**< Geometry is read later by loadPart() */
+        PartGeometry geometry;
+    };
+
+    /* State shared with the worker jobs, it is kept alive by the jobs themselves so a
+     * cancelled load can drain in the background while a new one starts
+     */
+    struct Session {
+        std::atomic<bool> cancelled{ false };
+        std::atomic<bool> scanDone{ false };
+        std::atomic<int> total{ 0 };
+        bool deferred = false;                      /**< Fixed for the whole session */
+        MeshWelder::Options weldOptions;            /**< Fixed for the whole session */
+        GeometryCache cache;                        /**< Fixed for the whole session */
+        int completed = 0;                          /**< Guarded by mutex */
+        QMutex mutex;
+        QList<Result> results;                      /**< Guarded by mutex */
+
+        // Geometry that was never handed to a part still holds a registry reference
+        ~Session() {
+            for (const Result& result : results)
+                GeometryRegistry::instance().release(result.geometry);
+        }
+    };
+
+    /* Entries of one folder that finished ahead of an earlier sibling, held until the rows before them are in */
+    struct PendingRows {
+        int next = 0;                               /**< Position of the next row to add */
+        QMap<int, ModelPart*> parts;                /**< Finished entries by position */
+    };
+
+    static void scanFolder(const std::shared_ptr<Session>& session, QThreadPool* pool,
+                           const QDir& dir, const QString& relativePath);
+    void discardPendingRows();
+
+    ModelPartList* partList;
+    QThreadPool pool;
+    QThreadPool partPool;                           /**< loadPart() jobs, kept apart so cancel() leaves them running */
+    QTimer flushTimer;
+    std::shared_ptr<Session> session;
+    MeshWelder::Options weldOptions;
+    bool cacheEnabled = true;
+    bool deferred = false;
+    MeshWelder::Options partWeldOptions;            /**< Used by loadPart(), taken from the last folder load */
+    GeometryCache partCache;                        /**< Used by loadPart(), taken from the last folder load */
+    std::shared_ptr<std::atomic<bool>> partsCancelled;
+    int pending = 0;
+    QHash<QString, ModelPart*> folderItems;         /**< Relative folder path -> tree node */
+    QHash<ModelPart*, PendingRows> pendingRows;     /**< Held entries per parent folder node */
+    int loaded = 0;
+    int total = 0;
+};
+
+#endif // VIEWER_PARTLOADER_H
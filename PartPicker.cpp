@@ -0,0 +1,210 @@
+// Header file for this class
+#include "PartPicker.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "SceneSync.h"
+
+// Q includes
+#include <QElapsedTimer>
+
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+// A press and release further apart than this is a camera drag, not a click
+const int CLICK_TOLERANCE = 3;
+
+} // namespace
+
+// Constructor - the top level is rebuilt lazily after any change to the tree
+PartPicker::PartPicker(ModelPartList* model, vtkRenderer* renderer, QObject* parent)
+    : QObject(parent), model(model), renderer(renderer), jobs(this) {
+    connect(model, &QAbstractItemModel::dataChanged, this, &PartPicker::markDirty);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &PartPicker::markDirty);
+    connect(model, &QAbstractItemModel::rowsRemoved, this, &PartPicker::markDirty);
+    connect(model, &QAbstractItemModel::modelReset, this, &PartPicker::markDirty);
+}
+
+// Destructor - the jobs wait for any hierarchy that is still being built
+PartPicker::~PartPicker() {
+    if (interactor)
+        interactor->RemoveObserver(mouseCallback);
+}
+
+// Builds the hierarchy of the part's mesh on the pool unless it exists or is being built
+void PartPicker::request(ModelPart* part) {
+    vtkPolyData* mesh = part->getGeometry().polyData;
+    if (!mesh || meshes.find(mesh) || !meshes.addWaiting(mesh, part))
+        return;
+
+    vtkSmartPointer<vtkPolyData> source = mesh;
+    jobs.start([source]() { return std::make_shared<const MeshBvh>(source); },
+               [this, source](const std::shared_ptr<const MeshBvh>& bvh) {
+        meshes.takeWaiting(source);
+        meshes.insert(source, bvh);
+        dirty = true;
+    });
+}
+
+// Drops every hierarchy, builds already running finish but their output is ignored
+void PartPicker::clear() {
+    jobs.cancel();
+    meshes.clear();
+    instances.clear();
+    topLevel = Bvh();
+    dirty = true;
+}
+
+// Entries of meshes that were freed when their parts were released
+void PartPicker::prune() {
+    meshes.prune();
+    dirty = true;
+}
+
+qint64 PartPicker::totalBytes() const {
+    qint64 bytes = 0;
+    for (const auto& entry : meshes)
+        bytes += entry.value->memoryBytes();
+    return bytes;
+}
+
+// The top level is rebuilt when the isolated set changes, the model does not report that
+void PartPicker::setScene(SceneSync* scene) {
+    if (this->scene)
+        disconnect(this->scene, nullptr, this, nullptr);
+    this->scene = scene;
+    if (scene)
+        connect(scene, &SceneSync::isolationChanged, this, &PartPicker::markDirty);
+    dirty = true;
+}
+
+// Observes the left button, ahead of the interactor style so camera interaction is unchanged
+void PartPicker::attach(vtkRenderWindowInteractor* interactor) {
+    this->interactor = interactor;
+    mouseCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+    mouseCallback->SetCallback(&PartPicker::onMouse);
+    mouseCallback->SetClientData(this);
+    interactor->AddObserver(vtkCommand::LeftButtonPressEvent, mouseCallback);
+    interactor->AddObserver(vtkCommand::LeftButtonReleaseEvent, mouseCallback);
+}
+
+// A release close to its press is a click
+void PartPicker::onMouse(vtkObject* caller, unsigned long eventId, void* clientData, void*) {
+    PartPicker* self = static_cast<PartPicker*>(clientData);
+    const int* position = static_cast<vtkRenderWindowInteractor*>(caller)->GetEventPosition();
+
+    if (eventId == vtkCommand::LeftButtonPressEvent) {
+        self->pressPosition[0] = position[0];
+        self->pressPosition[1] = position[1];
+        return;
+    }
+
+    if (std::abs(position[0] - self->pressPosition[0]) > CLICK_TOLERANCE ||
+        std::abs(position[1] - self->pressPosition[1]) > CLICK_TOLERANCE)
+        return;
+
+    emit self->partPicked(self->pickAt(position[0], position[1]));
+}
+
+// Turns the pixel into a ray from the near to the far clipping plane
+ModelPart* PartPicker::pickAt(int x, int y) {
+    double ends[2][3];
+    for (int i = 0; i < 2; ++i) {
+        double world[4];
+        renderer->SetDisplayPoint(x, y, double(i));
+        renderer->DisplayToWorld();
+        renderer->GetWorldPoint(world);
+        if (world[3] == 0.0)
+            return nullptr;
+        for (int axis = 0; axis < 3; ++axis)
+            ends[i][axis] = world[axis] / world[3];
+    }
+
+    const double direction[3] = { ends[1][0] - ends[0][0], ends[1][1] - ends[0][1], ends[1][2] - ends[0][2] };
+    return pick(ends[0], direction);
+}
+
+// Top level first, then the triangles of each part the ray reaches, nearest parts first
+ModelPart* PartPicker::pick(const double origin[3], const double direction[3]) {
+    QElapsedTimer timer;
+    timer.start();
+
+    if (dirty)
+        rebuildTopLevel();
+
+    const float worldOrigin[3] = { float(origin[0]), float(origin[1]), float(origin[2]) };
+    const float ray[3] = { float(direction[0]), float(direction[1]), float(direction[2]) };
+
+    ModelPart* nearest = nullptr;
+    float distance = std::numeric_limits<float>::max();
+
+    topLevel.traverse(worldOrigin, ray, distance, [&](uint32_t position, float& tMax) {
+        const Instance& instance = instances[position];
+        // Meshes are in the part's local frame, which the part's origin translates into the world
+        const float local[3] = { float(origin[0] - instance.origin[0]),
+                                 float(origin[1] - instance.origin[1]),
+                                 float(origin[2] - instance.origin[2]) };
+        if (instance.bvh->intersect(local, ray, tMax))
+            nearest = instance.part;
+    });
+
+    lastPickMs = timer.nsecsElapsed() / 1.0e6;
+    return nearest;
+}
+
+double PartPicker::lastPickTime() const {
+    return lastPickMs;
+}
+
+// Visibility, loading and release all reach the picker through the model
+void PartPicker::markDirty() {
+    dirty = true;
+}
+
+// Collects the visible parts that can be picked and builds the hierarchy over their world bounds
+void PartPicker::rebuildTopLevel() {
+    instances.clear();
+    collectInstances(model->getRootItem());
+
+    std::vector<float> boxes;
+    boxes.reserve(6 * size_t(instances.size()));
+    for (const Instance& instance : instances) {
+        double bounds[6];
+        instance.part->getGeometry().polyData->GetBounds(bounds);
+        for (int axis = 0; axis < 3; ++axis)
+            boxes.push_back(float(bounds[2 * axis] + instance.origin[axis]));
+        for (int axis = 0; axis < 3; ++axis)
+            boxes.push_back(float(bounds[2 * axis + 1] + instance.origin[axis]));
+    }
+
+    topLevel.build(boxes);
+
+    // Store the instances in leaf order so a leaf's parts sit together
+    QVector<Instance> ordered;
+    ordered.reserve(instances.size());
+    for (uint32_t index : topLevel.leafOrder())
+        ordered.append(instances[int(index)]);
+    instances = ordered;
+    topLevel.releaseLeafOrder();
+
+    dirty = false;
+}
+
+// Recursively adds the drawn loaded parts whose mesh hierarchy is ready, the same parts SceneSync shows
+void PartPicker::collectInstances(ModelPart* part) {
+    if (!part)
+        return;
+
+    vtkPolyData* mesh = part->getGeometry().polyData;
+    if (mesh && part->visible() && part->getLoadState() == ModelPart::LoadState::Loaded
+        && (!scene || scene->isIsolated(part))) {
+        if (const std::shared_ptr<const MeshBvh>* bvh = meshes.find(mesh)) {
+            const PartGeometry& geometry = part->getGeometry();
+            instances.append(Instance{ part, *bvh, { geometry.origin[0], geometry.origin[1], geometry.origin[2] } });
+        }
+    }
+
+    for (int i = 0; i < part->childCount(); ++i)
+        collectInstances(part->child(i));
+}
@@ -0,0 +1,125 @@
+#ifndef VIEWER_PARTPICKER_H
+#define VIEWER_PARTPICKER_H
+
+#include "Bvh.h"
+#include "MeshBvh.h"
+#include "MeshJobs.h"
+
+#include <QObject>
+#include <QVector>
+
+#include <memory>
+
+#include <vtkSmartPointer.h>
+#include <vtkCallbackCommand.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkWeakPointer.h>
+
+class ModelPart;
+class ModelPartList;
+class SceneSync;
+
+/* Finds the part under the mouse by casting a ray through two levels of bounding volume hierarchy.
+ * A triangle hierarchy (MeshBvh) is built on the shared background pool for every distinct mesh
+ * once its parts are loaded, and shared by every part that uses the mesh. A top level hierarchy
+ * over the world bounds of the visible parts is rebuilt on the next pick after the tree changes.
+ * Parts are placed by their origin only, so a ray is taken into a mesh's frame by a translation.
+ * Parts whose triangle hierarchy is still being built cannot be picked yet.
+ */
+class PartPicker : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param model is walked for the visible parts, and observed to know when to rebuild the top level
+      * @param renderer provides the camera that clicks are turned into rays with
+      * @param parent is used by the QObject constructor
+      */
+    PartPicker(ModelPartList* model, vtkRenderer* renderer, QObject* parent = nullptr);
+
+    /** Destructor - stops observing clicks, abandons queued builds and waits for running ones
+      */
+    ~PartPicker();
+
+    /** Queue the triangle hierarchy of a part's mesh, meshes that already have one are skipped
+      * @param part is a loaded part
+      */
+    void request(ModelPart* part);
+
+    /** Forget every hierarchy, call before the parts are deleted
+      */
+    void clear();
+
+    /** Forget the hierarchies of meshes that no part uses any more, so their memory is freed
+      */
+    void prune();
+
+    /** @return the memory held by every triangle hierarchy in bytes
+      */
+    qint64 totalBytes() const;
+
+    /** Leave out the parts the scene does not draw while it isolates some
+      * @param scene decides which visible parts are drawn, null picks every visible part
+      */
+    void setScene(SceneSync* scene);
+
+    /** Pick with the left mouse button, a press and release without a drag selects
+      * @param interactor is the interactor of the renderer's window
+      */
+    void attach(vtkRenderWindowInteractor* interactor);
+
+    /** Find the nearest visible part along a ray in world coordinates
+      * @param origin, direction define the ray, the direction need not be normalised
+      * @return the part hit first, or null
+      */
+    ModelPart* pick(const double origin[3], const double direction[3]);
+
+    /** Find the visible part drawn at a pixel
+      * @param x, y are display coordinates, with the origin at the bottom left
+      * @return the part hit first, or null
+      */
+    ModelPart* pickAt(int x, int y);
+
+    /** @return how long the last pick took in milliseconds, including any top level rebuild
+      */
+    double lastPickTime() const;
+
+signals:
+    /** Emitted on a click in the view, part is null when the click hit nothing */
+    void partPicked(ModelPart* part);
+
+private slots:
+    void markDirty();
+
+private:
+    /* A visible part in the top level, with what is needed to test it without touching the part */
+    struct Instance {
+        ModelPart* part;
+        std::shared_ptr<const MeshBvh> bvh;
+        double origin[3];
+    };
+
+    void rebuildTopLevel();
+    void collectInstances(ModelPart* part);
+
+    static void onMouse(vtkObject* caller, unsigned long eventId, void* clientData, void* callData);
+
+    ModelPartList* model;
+    vtkRenderer* renderer;
+    SceneSync* scene = nullptr;
+    MeshJobs jobs;
+    MeshResults<std::shared_ptr<const MeshBvh>> meshes;     /**< Triangle hierarchy of each mesh */
+
+    bool dirty = true;
+    Bvh topLevel;
+    QVector<Instance> instances;        /**< Visible parts in the top level's leaf order */
+    double lastPickMs = 0.0;
+
+    vtkWeakPointer<vtkRenderWindowInteractor> interactor;
+    vtkSmartPointer<vtkCallbackCommand> mouseCallback;
+    int pressPosition[2] = { 0, 0 };
+};
+
+#endif // VIEWER_PARTPICKER_H
@@ -0,0 +1,251 @@
+// Header file for this class
+#include "PartSearch.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+
+// Q includes
+#include <QElapsedTimer>
+#include <QTimer>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Three UTF-16 code units packed into one key
+inline quint64 trigramKey(const QChar* c) {
+    return (quint64(c[0].unicode()) << 32) | (quint64(c[1].unicode()) << 16) | quint64(c[2].unicode());
+}
+
+} // namespace
+
+// Constructor - parts that are already in the tree are indexed straight away
+PartSearch::PartSearch(ModelPartList* model, QObject* parent)
+    : QObject(parent), model(model) {
+    connect(model, &QAbstractItemModel::rowsInserted, this, &PartSearch::handleRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &PartSearch::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::dataChanged, this, &PartSearch::handleDataChanged);
+    connect(model, &QAbstractItemModel::modelReset, this, &PartSearch::handleModelReset);
+
+    handleModelReset();
+}
+
+// Candidates come from the previous matches or the trigram lists, their names are then compared
+QVector<ModelPart*> PartSearch::find(const QString& text) {
+    QElapsedTimer timer;
+    timer.start();
+
+    const QString query = text.toCaseFolded();
+    QVector<int> matches;
+    if (!query.isEmpty()) {
+        QVector<int> candidates;
+        bool everyPart = false;
+
+        if (!lastQuery.isEmpty() && lastGeneration == generation && query.contains(lastQuery)) {
+            candidates = lastMatches;
+        }
+        else if (query.size() >= 3) {
+            // Shortest list first, so every intersection is at most that long
+            QVector<const QVector<int>*> lists;
+            for (int i = 0; i + 3 <= query.size(); ++i) {
+                auto it = trigrams.constFind(trigramKey(query.constData() + i));
+                if (it == trigrams.constEnd()) {
+                    lists.clear();
+                    break;
+                }
+                lists.append(&it.value());
+            }
+            std::sort(lists.begin(), lists.end(),
+                      [](const QVector<int>* a, const QVector<int>* b) { return a->size() < b->size(); });
+
+            if (!lists.isEmpty()) {
+                candidates = *lists.first();
+                for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i) {
+                    QVector<int> common;
+                    std::set_intersection(candidates.constBegin(), candidates.constEnd(),
+                                          lists[i]->constBegin(), lists[i]->constEnd(), std::back_inserter(common));
+                    candidates.swap(common);
+                }
+            }
+        }
+        else {
+            everyPart = true;
+        }
+
+        // Sharing every trigram does not mean they appear in order, so each candidate is confirmed
+        if (everyPart) {
+            for (int id = 0; id < parts.size(); ++id) {
+                if (parts[id] && names[id].contains(query))
+                    matches.append(id);
+            }
+        }
+        else {
+            for (int id : candidates) {
+                if (parts[id] && names[id].contains(query))
+                    matches.append(id);
+            }
+        }
+    }
+
+    lastQuery = query;
+    lastMatches = matches;
+    lastGeneration = generation;
+
+    QVector<ModelPart*> found;
+    found.reserve(matches.size());
+    for (int id : matches)
+        found.append(parts[id]);
+
+    findTime = timer.nsecsElapsed() / 1.0e6;
+    return found;
+}
+
+double PartSearch::lastFindTime() const {
+    return findTime;
+}
+
+int PartSearch::partCount() const {
+    return idOf.size();
+}
+
+void PartSearch::handleRowsInserted(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partFromIndex(parent);
+    for (int row = first; row <= last; ++row)
+        addSubtree(parentPart->child(row));
+
+    scheduleChanged();
+}
+
+// The parts are deleted right after this, so they leave the index now
+void PartSearch::handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partFromIndex(parent);
+    for (int row = first; row <= last; ++row)
+        removeSubtree(parentPart->child(row));
+
+    if (removed > 1024 && removed > parts.size() / 2)
+        compact();
+    scheduleChanged();
+}
+
+// Only renamed parts are indexed again, the rows also change for loading and colour edits
+void PartSearch::handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    if (!topLeft.isValid() || topLeft.column() > 0)
+        return;
+
+    bool renamed = false;
+    const QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        ModelPart* part = partFromIndex(model->index(row, 0, parent));
+        const int id = idOf.value(part, -1);
+        if (id >= 0 && names[id] != part->data(0).toString().toCaseFolded()) {
+            removePart(part);
+            addPart(part);
+            renamed = true;
+        }
+    }
+
+    if (renamed)
+        scheduleChanged();
+}
+
+// Starts over from whatever the tree holds now
+void PartSearch::handleModelReset() {
+    parts.clear();
+    names.clear();
+    idOf.clear();
+    trigrams.clear();
+    removed = 0;
+    ++generation;
+
+    ModelPart* root = model->getRootItem();
+    for (int i = 0; i < root->childCount(); ++i)
+        addSubtree(root->child(i));
+
+    scheduleChanged();
+}
+
+// The root item for an invalid index, the part behind the index otherwise
+ModelPart* PartSearch::partFromIndex(const QModelIndex& index) const {
+    if (!index.isValid())
+        return model->getRootItem();
+    return static_cast<ModelPart*>(index.internalPointer());
+}
+
+void PartSearch::addSubtree(ModelPart* part) {
+    if (!part)
+        return;
+
+    addPart(part);
+    for (int i = 0; i < part->childCount(); ++i)
+        addSubtree(part->child(i));
+}
+
+void PartSearch::removeSubtree(ModelPart* part) {
+    if (!part)
+        return;
+
+    removePart(part);
+    for (int i = 0; i < part->childCount(); ++i)
+        removeSubtree(part->child(i));
+}
+
+// The new id is the largest so far, appending keeps every list sorted
+void PartSearch::addPart(ModelPart* part) {
+    if (idOf.contains(part))
+        return;
+
+    const int id = parts.size();
+    const QString name = part->data(0).toString().toCaseFolded();
+    parts.append(part);
+    names.append(name);
+    idOf.insert(part, id);
+    ++generation;
+
+    for (int i = 0; i + 3 <= name.size(); ++i) {
+        QVector<int>& ids = trigrams[trigramKey(name.constData() + i)];
+        if (ids.isEmpty() || ids.last() != id)
+            ids.append(id);
+    }
+}
+
+// The id stays in the trigram lists until the next compaction, find() skips it
+void PartSearch::removePart(ModelPart* part) {
+    auto it = idOf.find(part);
+    if (it == idOf.end())
+        return;
+
+    const int id = it.value();
+    idOf.erase(it);
+
+    parts[id] = nullptr;
+    names[id].clear();
+    ++removed;
+    ++generation;
+}
+
+// Renumbers the remaining parts once most ids are dead, the lists are rebuilt in the same order
+void PartSearch::compact() {
+    const QVector<ModelPart*> live = parts;
+    parts.clear();
+    names.clear();
+    idOf.clear();
+    trigrams.clear();
+    removed = 0;
+
+    for (ModelPart* part : live) {
+        if (part)
+            addPart(part);
+    }
+}
+
+// Several changes in one go are reported once
+void PartSearch::scheduleChanged() {
+    if (changePending)
+        return;
+
+    changePending = true;
+    QTimer::singleShot(0, this, [this]() {
+        changePending = false;
+        emit indexChanged();
+    });
+}
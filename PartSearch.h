@@ -0,0 +1,85 @@
+#ifndef VIEWER_PARTSEARCH_H
+#define VIEWER_PARTSEARCH_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <QModelIndex>
+
+class ModelPart;
+class ModelPartList;
+
+/* Finds parts by a case insensitive piece of their name without walking the tree.
+ * Every name is split into its three character sequences (trigrams) and each trigram lists the
+ * parts whose name contains it. A query looks up the lists of its own trigrams, intersects them
+ * starting with the shortest, and only compares the few names left. A query that extends the
+ * previous one (the user typed another character) only re-checks the previous matches.
+ * Queries of one or two characters have no trigram and compare every name, they match most of
+ * the tree anyway. The index follows the model: parts are added as they are inserted, which
+ * builds it while a folder loads, and renamed or removed parts are replaced or dropped.
+ */
+class PartSearch : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param model is indexed and observed for inserted, renamed, removed and reset parts
+      * @param parent is used by the QObject constructor
+      */
+    explicit PartSearch(ModelPartList* model, QObject* parent = nullptr);
+
+    /** Find the parts (files and folders) whose name contains a piece of text
+      * @param text is compared ignoring case, empty text matches nothing
+      * @return the matching parts in the order they were added to the tree
+      */
+    QVector<ModelPart*> find(const QString& text);
+
+    /** @return the time taken by the last find() in milliseconds
+      */
+    double lastFindTime() const;
+
+    /** @return the number of parts in the index
+      */
+    int partCount() const;
+
+signals:
+    /** Emitted on the next pass of the event loop after parts were added, renamed or removed,
+      *  results of earlier queries may be out of date */
+    void indexChanged();
+
+private slots:
+    void handleRowsInserted(const QModelIndex& parent, int first, int last);
+    void handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void handleModelReset();
+
+private:
+    ModelPart* partFromIndex(const QModelIndex& index) const;
+    void addSubtree(ModelPart* part);
+    void removeSubtree(ModelPart* part);
+    void addPart(ModelPart* part);
+    void removePart(ModelPart* part);
+    void compact();
+    void scheduleChanged();
+
+    ModelPartList* model;
+
+    /* Parts are numbered in the order they are added, so every list of ids is sorted.
+     * A removed part keeps its number with a null entry until the index is compacted
+     */
+    QVector<ModelPart*> parts;
+    QVector<QString> names;                     /**< Case folded name of each id */
+    QHash<ModelPart*, int> idOf;
+    QHash<quint64, QVector<int>> trigrams;      /**< Ids of the names containing each trigram */
+    int removed = 0;
+
+    QString lastQuery;                          /**< Case folded text of the last find() */
+    QVector<int> lastMatches;
+    quint64 generation = 0;                     /**< Bumped on every change, last results are only reused within one */
+    quint64 lastGeneration = 0;
+    double findTime = 0.0;
+    bool changePending = false;
+};
+
+#endif // VIEWER_PARTSEARCH_H
@@ -0,0 +1,326 @@
+// Header file for this class
+#include "RenderBenchmark.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "PartLoader.h"
+#include "InstancedRenderer.h"
+#include "BatchRenderer.h"
+#include "LodGenerator.h"
+#include "LodSelector.h"
+#include "SceneSync.h"
+#include "GeometryRegistry.h"
+#include "MeshOptimizer.h"
+#include "RendererSetup.h"
+
+// Q includes
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QHash>
+#include <QTextStream>
+
+// VTK headers
+#include <vtkCamera.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkRenderTimerLog.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkPropCollection.h>
+#include <vtkGlyph3DMapper.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// Nearest rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double fraction) {
+    if (sorted.empty())
+        return 0.0;
+    const size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+// Shows the matching parts below an item and counts what is shown
+void showMatching(ModelPart* item, const QList<QRegularExpression>& patterns, int& parts, qint64& triangles) {
+    for (int i = 0; i < item->childCount(); ++i) {
+        ModelPart* child = item->child(i);
+        const QString name = child->data(0).toString();
+
+        bool match = patterns.isEmpty();
+        for (const QRegularExpression& pattern : patterns)
+            match = match || pattern.match(name).hasMatch();
+
+        if (match && child->getGeometry().polyData) {
+            child->setVisible(true);
+            ++parts;
+            triangles += child->getGeometry().polyData->GetNumberOfPolys();
+        }
+
+        showMatching(child, patterns, parts, triangles);
+    }
+}
+
+// Counts the meshes the visible actors drew in the last frame: level of detail, batch or instanced
+// source meshes as bound to the mappers. A glyph mapper draws its source once per instance
+void countDrawnMeshes(vtkRenderer* renderer, QHash<vtkPolyData*, qint64>& draws) {
+    vtkPropCollection* props = renderer->GetViewProps();
+    vtkCollectionSimpleIterator it;
+    props->InitTraversal(it);
+    while (vtkProp* prop = props->GetNextProp(it)) {
+        vtkActor* actor = vtkActor::SafeDownCast(prop);
+        if (!actor || !actor->GetVisibility() || !actor->GetMapper())
+            continue;
+
+        vtkMapper* mapper = actor->GetMapper();
+        if (vtkGlyph3DMapper* glyphs = vtkGlyph3DMapper::SafeDownCast(mapper)) {
+            vtkDataSet* instances = vtkDataSet::SafeDownCast(glyphs->GetInputDataObject(0, 0));
+            if (vtkPolyData* source = glyphs->GetSource())
+                draws[source] += instances ? instances->GetNumberOfPoints() : 0;
+        }
+        else if (vtkPolyData* mesh = vtkPolyData::SafeDownCast(mapper->GetInputDataObject(0, 0))) {
+            draws[mesh] += 1;
+        }
+    }
+}
+
+// Vertices transformed per triangle over every draw, as the simulated cache of MeshOptimizer sees them
+double cacheMissRatio(const QHash<vtkPolyData*, qint64>& draws) {
+    double misses = 0.0;
+    double triangles = 0.0;
+    std::vector<uint32_t> corners;
+    for (auto entry = draws.constBegin(); entry != draws.constEnd(); ++entry) {
+        vtkPolyData* mesh = entry.key();
+        vtkCellArray* polys = mesh->GetPolys();
+        if (entry.value() == 0 || !polys || polys->IsHomogeneous() != 3)
+            continue;
+
+        vtkDataArray* connectivity = polys->GetConnectivityArray();
+        corners.resize(size_t(connectivity->GetNumberOfValues()));
+        for (size_t c = 0; c < corners.size(); ++c)
+            corners[c] = uint32_t(connectivity->GetComponent(vtkIdType(c), 0));
+
+        const double count = double(corners.size() / 3) * double(entry.value());
+        misses += MeshOptimizer::cacheMissRatio(corners.data(), corners.size() / 3, size_t(mesh->GetNumberOfPoints())) * count;
+        triangles += count;
+    }
+    return triangles > 0.0 ? misses / triangles : 0.0;
+}
+
+// GPU time of a frame, the sum of its top level timed events
+double gpuMilliseconds(const vtkRenderTimerLog::Frame& frame) {
+    double ms = 0.0;
+    for (const vtkRenderTimerLog::Event& event : frame.Events)
+        ms += event.ElapsedTimeMilliseconds();
+    return ms;
+}
+
+// Summary of a list of frame times, the keys get the prefix
+void addFrameTimes(QJsonObject& frames, const QString& prefix, std::vector<double> ms) {
+    std::sort(ms.begin(), ms.end());
+    double total = 0.0;
+    for (double value : ms)
+        total += value;
+    frames[prefix + "MeanMs"] = ms.empty() ? 0.0 : total / ms.size();
+    frames[prefix + "P50Ms"] = percentile(ms, 0.50);
+    frames[prefix + "P95Ms"] = percentile(ms, 0.95);
+}
+
+// Queues level generation for everything below an item
+void requestLevels(LodGenerator& generator, ModelPart* item) {
+    generator.request(item);
+    for (int i = 0; i < item->childCount(); ++i)
+        requestLevels(generator, item->child(i));
+}
+
+} // namespace
+
+// Constructor
+RenderBenchmark::RenderBenchmark(const Options& options)
+    : options(options) {
+}
+
+// Loads the inputs, orbits the camera once and writes the JSON report
+int RenderBenchmark::run() {
+    // Mesa picks its software rasteriser, which gives the same numbers on machines without a GPU
+    if (!options.useGpu && qEnvironmentVariableIsEmpty("LIBGL_ALWAYS_SOFTWARE"))
+        qputenv("LIBGL_ALWAYS_SOFTWARE", "1");
+
+    ModelPartList partList("PartsList");
+    PartLoader loader(&partList);
+    MeshWelder::Options weldOptions;
+    weldOptions.optimiseOrder = options.optimiseMeshes;
+    loader.setWeldOptions(weldOptions);
+
+    // Folders go through the worker pool exactly as in the viewer, single files through addPart
+    QElapsedTimer loadTimer;
+    loadTimer.start();
+    for (const QString& input : options.inputs) {
+        QFileInfo info(input);
+        if (info.isDir()) {
+            QEventLoop loop;
+            QObject::connect(&loader, &PartLoader::finished, &loop, &QEventLoop::quit);
+            loader.loadFolder(info.absoluteFilePath());
+            loop.exec();
+        }
+        else if (info.isFile()) {
+            partList.addPart(info.fileName(), info.absoluteFilePath(), weldOptions);
+        }
+    }
+    const double loadSeconds = loadTimer.nsecsElapsed() / 1.0e9;
+
+    // The window is never shown, everything is drawn into an offscreen buffer
+    vtkSmartPointer<vtkRenderWindow> window = vtkSmartPointer<vtkRenderWindow>::New();
+    window->SetOffScreenRendering(1);
+    window->SetSize(options.width, options.height);
+    vtkSmartPointer<vtkRenderer> renderer = vtkSmartPointer<vtkRenderer>::New();
+    window->AddRenderer(renderer);
+    configureRenderer(renderer);
+
+    InstancedRenderer instancedRenderer(renderer);
+    instancedRenderer.setEnabled(options.instancing);
+    BatchRenderer batchRenderer(renderer);
+    batchRenderer.setEnabled(options.batching);
+    LodSelector lodSelector(renderer, options.levelsOfDetail ? DESKTOP_FRAME_BUDGET : 0.0);
+    SceneSync sceneSync(&partList, renderer, &instancedRenderer, &batchRenderer, &lodSelector);
+    sceneSync.setCullingEnabled(options.culling);
+
+    // Levels are generated up front so every frame of the orbit sees the same scene
+    LodGenerator lodGenerator;
+    lodGenerator.setOptimiseOrder(options.optimiseMeshes);
+    QElapsedTimer lodTimer;
+    lodTimer.start();
+    if (options.levelsOfDetail) {
+        requestLevels(lodGenerator, partList.getRootItem());
+        QEventLoop loop;
+        QObject::connect(&lodGenerator, &LodGenerator::levelsReady, &loop, [&]() {
+            if (!lodGenerator.isBusy())
+                loop.quit();
+        });
+        if (lodGenerator.isBusy())
+            loop.exec();
+    }
+    const double lodSeconds = lodTimer.nsecsElapsed() / 1.0e9;
+
+    QList<QRegularExpression> patterns;
+    for (const QString& pattern : options.visiblePatterns)
+        patterns.append(QRegularExpression(QRegularExpression::wildcardToRegularExpression(pattern),
+                                           QRegularExpression::CaseInsensitiveOption));
+
+    int visibleParts = 0;
+    qint64 visibleTriangles = 0;
+    showMatching(partList.getRootItem(), patterns, visibleParts, visibleTriangles);
+    if (partList.rowCount(QModelIndex()) > 0)
+        emit partList.dataChanged(partList.index(0, 0, QModelIndex()),
+                                  partList.index(partList.rowCount(QModelIndex()) - 1, 0, QModelIndex()));
+    sceneSync.flush();
+
+    // The first frame includes uploading every mesh to the GPU, it is reported on its own
+    renderer->ResetCamera();
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    window->Render();
+    window->WaitForCompletion();
+    const double firstFrameMs = frameTimer.nsecsElapsed() / 1.0e6;
+
+    // GPU timer queries need the context, which exists once the first frame was drawn
+    vtkRenderTimerLog* gpuTimer = window->GetRenderTimer();
+    const bool gpuTiming = gpuTimer->IsSupported();
+    gpuTimer->SetLoggingEnabled(gpuTiming);
+
+    std::vector<double> frameMs;
+    std::vector<double> gpuMs;
+    QHash<vtkPolyData*, qint64> draws;
+    frameMs.reserve(options.frames);
+    vtkCamera* camera = renderer->GetActiveCamera();
+    for (int frame = 0; frame < options.frames; ++frame) {
+        camera->Azimuth(360.0 / options.frames);
+        frameTimer.restart();
+        window->Render();
+        window->WaitForCompletion();
+        frameMs.push_back(frameTimer.nsecsElapsed() / 1.0e6);
+        countDrawnMeshes(renderer, draws);
+
+        while (gpuTiming && gpuTimer->FrameReady())
+            gpuMs.push_back(gpuMilliseconds(gpuTimer->PopFirstReadyFrame()));
+    }
+
+    // The queries of the last frames are still pending when the loop ends, the open frame is closed
+    // and they are collected before logging stops
+    if (gpuTiming) {
+        window->MakeCurrent();
+        gpuTimer->MarkFrame();
+        window->WaitForCompletion();
+        while (gpuTimer->FrameReady())
+            gpuMs.push_back(gpuMilliseconds(gpuTimer->PopFirstReadyFrame()));
+    }
+    gpuTimer->SetLoggingEnabled(false);
+
+    double totalMs = 0.0;
+    for (double ms : frameMs)
+        totalMs += ms;
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+
+    QJsonObject frames;
+    frames["count"] = options.frames;
+    frames["firstMs"] = firstFrameMs;
+    frames["meanMs"] = sorted.empty() ? 0.0 : totalMs / sorted.size();
+    frames["minMs"] = sorted.empty() ? 0.0 : sorted.front();
+    frames["p50Ms"] = percentile(sorted, 0.50);
+    frames["p90Ms"] = percentile(sorted, 0.90);
+    frames["p95Ms"] = percentile(sorted, 0.95);
+    frames["p99Ms"] = percentile(sorted, 0.99);
+    frames["maxMs"] = sorted.empty() ? 0.0 : sorted.back();
+    frames["fps"] = totalMs > 0.0 ? 1000.0 * sorted.size() / totalMs : 0.0;
+    frames["gpuTiming"] = gpuTiming;
+    if (gpuTiming)
+        addFrameTimes(frames, "gpu", gpuMs);
+
+    report = QJsonObject();
+    report["inputs"] = QJsonArray::fromStringList(options.inputs);
+    report["visiblePatterns"] = QJsonArray::fromStringList(options.visiblePatterns);
+    report["width"] = options.width;
+    report["height"] = options.height;
+    report["instancing"] = options.instancing;
+    report["batching"] = options.batching;
+    report["batches"] = batchRenderer.batchCount();
+    report["levelsOfDetail"] = options.levelsOfDetail;
+    report["culling"] = options.culling;
+    report["optimisedMeshOrder"] = options.optimiseMeshes;
+    report["vertexCacheMissRatio"] = cacheMissRatio(draws);
+    report["renderer"] = QString(window->GetClassName());
+    report["loadSeconds"] = loadSeconds;
+    report["lodSeconds"] = lodSeconds;
+    report["uniqueMeshes"] = GeometryRegistry::instance().uniqueCount();
+    report["visibleParts"] = visibleParts;
+    report["visibleTriangles"] = visibleTriangles;
+    report["frames"] = frames;
+
+    const QByteArray json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+    if (options.outputPath.isEmpty()) {
+        QTextStream(stdout) << json;
+    }
+    else {
+        QFile file(options.outputPath);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QTextStream(stderr) << "Cannot write " << options.outputPath << "\n";
+            return 1;
+        }
+        file.write(json);
+    }
+
+    return visibleParts > 0 ? 0 : 1;
+}
+
+QJsonObject RenderBenchmark::getReport() const {
+    return report;
+}
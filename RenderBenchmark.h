@@ -0,0 +1,56 @@
+#ifndef VIEWER_RENDERBENCHMARK_H
+#define VIEWER_RENDERBENCHMARK_H
+
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+
+/* Offscreen render benchmark, started from the command line with --benchmark (see main.cpp).
+ * Loads folders and STL files the same way the desktop viewer does, shows the parts whose names
+ * match the given patterns, then renders a camera orbit in an offscreen window set up like
+ * MainWindow::setupVTK (instancing, batching, levels of detail, folder culling and the shared renderer
+ * settings).
+ * Frame times (wall clock, and GPU time where the driver has timer queries), triangle counts,
+ * the vertex cache miss ratio of the meshes the mappers drew and load time are reported as JSON.
+ * Running it with and without optimiseMeshes shows what MeshOptimizer changes on an assembly,
+ * levels of detail included.
+ * To run without a GPU, use a VTK build with OSMesa or EGL, or an X server such as Xvfb.
+ * Mesa is told to use its software rasteriser unless useGpu is set.
+ */
+class RenderBenchmark {
+public:
+    struct Options {
+        QStringList inputs;                         /**< Folders and STL files to load */
+        QStringList visiblePatterns;                /**< Wildcards matched against part names, empty shows everything */
+        int frames = 360;                           /**< Frames in one full orbit */
+        int width = 1280;
+        int height = 720;
+        bool instancing = true;
+        bool batching = false;
+        bool levelsOfDetail = true;
+        bool culling = true;
+        bool useGpu = false;
+        bool optimiseMeshes = false;                /**< Reorder welded meshes with MeshOptimizer while loading */
+        QString outputPath;                         /**< JSON file, empty writes to standard output */
+    };
+
+    /** Constructor
+      * @param options are the run settings
+      */
+    explicit RenderBenchmark(const Options& options);
+
+    /** Load, render and write the report, needs a QCoreApplication
+      * @return a process exit code, non zero if nothing could be loaded
+      */
+    int run();
+
+    /** @return the report of the last run
+      */
+    QJsonObject getReport() const;
+
+private:
+    Options options;
+    QJsonObject report;
+};
+
+#endif // VIEWER_RENDERBENCHMARK_H
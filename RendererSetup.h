@@ -0,0 +1,21 @@
+#ifndef VIEWER_RENDERERSETUP_H
+#define VIEWER_RENDERERSETUP_H
+
+#include <vtkRenderer.h>
+
+/* Renderer settings shared by MainWindow::setupVTK and the offscreen RenderBenchmark, so the
+ * benchmark draws the scene exactly as the desktop view does.
+ */
+
+/** Frame time the desktop level of detail selection aims for, in seconds */
+const double DESKTOP_FRAME_BUDGET = 1.0 / 30.0;
+
+/** Apply the desktop view's renderer settings
+  * @param renderer is a freshly created renderer
+  */
+inline void configureRenderer(vtkRenderer* renderer) {
+    // Sets background colour to grey
+    renderer->SetBackground(0.1, 0.1, 0.1);
+}
+
+#endif // VIEWER_RENDERERSETUP_H
@@ -0,0 +1,261 @@
+// Header file for this class
+#include "SceneSync.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "InstancedRenderer.h"
+#include "BatchRenderer.h"
+#include "LodSelector.h"
+#include "TreeCuller.h"
+
+// Q includes
+#include <QTimer>
+
+// VTK headers
+#include <vtkCullerCollection.h>
+
+// Constructor
+SceneSync::SceneSync(ModelPartList* model, vtkRenderer* renderer, InstancedRenderer* instancedRenderer,
+                     BatchRenderer* batchRenderer, LodSelector* lodSelector, QObject* parent)
+    : QObject(parent), model(model), renderer(renderer), instancedRenderer(instancedRenderer),
+      batchRenderer(batchRenderer), lodSelector(lodSelector) {
+    connect(model, &QAbstractItemModel::dataChanged, this, &SceneSync::handleDataChanged);
+    connect(model, &QAbstractItemModel::rowsInserted, this, &SceneSync::handleRowsInserted);
+    connect(model, &QAbstractItemModel::rowsAboutToBeRemoved, this, &SceneSync::handleRowsAboutToBeRemoved);
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, &SceneSync::handleModelAboutToBeReset);
+    connect(model, &QAbstractItemModel::modelReset, this, &SceneSync::handleModelReset);
+
+    // The tree culler takes over from the renderer's per actor frustum coverage culler
+    culler = vtkSmartPointer<TreeCuller>::New();
+    culler->setRoot(model->getRootItem());
+    vtkCullerCollection* cullers = renderer->GetCullers();
+    cullers->InitTraversal();
+    previousCuller = cullers->GetNextItem();
+    setCullingEnabled(true);
+
+    markSubtree(model->getRootItem());
+    flush();
+}
+
+// Destructor
+SceneSync::~SceneSync() {
+    removeAll();
+    setCullingEnabled(false);
+}
+
+// Redraws every mesh, instancing may have been switched on or off
+void SceneSync::rebuild() {
+    markSubtree(model->getRootItem());
+    for (auto it = groups.constBegin(); it != groups.constEnd(); ++it)
+        dirty.insert(it.key());
+    flush();
+}
+
+// Takes the actors of every dirty mesh out of the renderer and puts the current ones in
+void SceneSync::flush() {
+    flushPending = false;
+    if (dirty.isEmpty())
+        return;
+
+    for (vtkPolyData* mesh : dirty) {
+        const QList<vtkSmartPointer<vtkActor>> oldActors = drawnActors.take(mesh);
+        for (const vtkSmartPointer<vtkActor>& actor : oldActors) {
+            lodSelector->setLevels(actor, {});
+            renderer->RemoveActor(actor);
+            culler->removePartActor(actor);
+        }
+
+        // Meshes with several visible copies are drawn instanced, small ones may be batched, the rest get their own actors
+        const QList<ModelPart*> group = groups.value(mesh);
+        if (instancedRenderer->setGroup(mesh, group)) {
+            batchRenderer->setGroup(mesh, {});
+            continue;
+        }
+        if (batchRenderer->setGroup(mesh, group))
+            continue;
+
+        for (ModelPart* part : group) {
+            vtkSmartPointer<vtkActor> actor = part->getActor();
+            renderer->AddActor(actor);
+            lodSelector->setLevels(actor, part->getLodLevels());
+            drawnActors[mesh].append(actor);
+            culler->addPartActor(actor, part);
+        }
+    }
+    dirty.clear();
+    batchRenderer->flush();
+
+    const bool firstContent = !showingParts && !visibleParts.isEmpty();
+    showingParts = !visibleParts.isEmpty();
+    emit sceneChanged(firstContent);
+}
+
+// Swaps the tree culler and the renderer's own culler
+void SceneSync::setCullingEnabled(bool enabled) {
+    renderer->GetCullers()->RemoveAllItems();
+    if (enabled)
+        renderer->AddCuller(culler);
+    else if (previousCuller)
+        renderer->AddCuller(previousCuller);
+}
+
+TreeCuller* SceneSync::getCuller() const {
+    return culler;
+}
+
+// Only the subtrees of parts that joined or left the set are checked again while isolating, turning
+// isolation on or off checks every part. Nothing was loaded or released, so no bounds go stale
+void SceneSync::setIsolation(bool enabled, const QSet<ModelPart*>& parts) {
+    if (!enabled && !isolating)
+        return;
+
+    const bool wasIsolating = isolating;
+    const QSet<ModelPart*> previous = isolatedParts;
+    isolating = enabled;
+    isolatedParts = enabled ? parts : QSet<ModelPart*>();
+
+    if (wasIsolating != enabled) {
+        markSubtree(model->getRootItem(), false, false);
+    }
+    else {
+        for (ModelPart* part : previous) {
+            if (!isolatedParts.contains(part))
+                markSubtree(part, false, false);
+        }
+        for (ModelPart* part : isolatedParts) {
+            if (!previous.contains(part))
+                markSubtree(part, false, false);
+        }
+    }
+    flush();
+    emit isolationChanged();
+}
+
+// Changed rows may be folders, so their whole subtree is re-checked
+void SceneSync::handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+    if (!topLeft.isValid())
+        return;
+
+    const QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row)
+        markSubtree(partFromIndex(model->index(row, 0, parent)));
+
+    scheduleFlush();
+}
+
+void SceneSync::handleRowsInserted(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partFromIndex(parent);
+    for (int row = first; row <= last; ++row)
+        markSubtree(parentPart->child(row));
+
+    scheduleFlush();
+}
+
+// The parts are deleted right after this, so their actors go now rather than on the next pass
+void SceneSync::handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+    ModelPart* parentPart = partFromIndex(parent);
+    for (int row = first; row <= last; ++row)
+        markSubtree(parentPart->child(row), true);
+
+    flush();
+}
+
+void SceneSync::handleModelAboutToBeReset() {
+    removeAll();
+    dirty.clear();
+    isolatedParts.clear();
+}
+
+void SceneSync::handleModelReset() {
+    markSubtree(model->getRootItem());
+    showingParts = false;
+    emit sceneChanged(false);
+    scheduleFlush();
+}
+
+// The root item for an invalid index, the part behind the index otherwise
+ModelPart* SceneSync::partFromIndex(const QModelIndex& index) const {
+    if (!index.isValid())
+        return model->getRootItem();
+    return static_cast<ModelPart*>(index.internalPointer());
+}
+
+void SceneSync::markSubtree(ModelPart* part, bool removing, bool boundsChanged) {
+    if (!part)
+        return;
+
+    markPart(part, removing, boundsChanged);
+    for (int i = 0; i < part->childCount(); ++i)
+        markSubtree(part->child(i), removing, boundsChanged);
+}
+
+// Moves a part in or out of the visible groups and marks the meshes involved
+void SceneSync::markPart(ModelPart* part, bool removing, bool boundsChanged) {
+    // Its geometry may have been loaded or released, the folders above it need new bounds
+    if (boundsChanged)
+        part->invalidateBounds();
+    // Hidden parts stay in their batch, a part about to be deleted must leave it, and the isolated set with it
+    if (removing) {
+        batchRenderer->forgetPart(part);
+        isolatedParts.remove(part);
+    }
+
+    vtkPolyData* mesh = part->getActor() ? part->getGeometry().polyData.GetPointer() : nullptr;
+    const bool show = !removing && mesh && part->visible() && isIsolated(part);
+    vtkPolyData* oldMesh = visibleParts.value(part, nullptr);
+
+    if (oldMesh && (!show || oldMesh != mesh)) {
+        QList<ModelPart*>& group = groups[oldMesh];
+        group.removeOne(part);
+        if (group.isEmpty())
+            groups.remove(oldMesh);
+        visibleParts.remove(part);
+        dirty.insert(oldMesh);
+    }
+
+    if (show) {
+        if (oldMesh != mesh) {
+            groups[mesh].append(part);
+            visibleParts.insert(part, mesh);
+        }
+        // Also covers colour changes, which instanced actors only pick up when rebuilt
+        dirty.insert(mesh);
+    }
+}
+
+// A part is kept if it or a folder above it is in the isolated set
+bool SceneSync::isIsolated(ModelPart* part) const {
+    if (!isolating)
+        return true;
+
+    for (ModelPart* item = part; item; item = item->parentItem()) {
+        if (isolatedParts.contains(item))
+            return true;
+    }
+    return false;
+}
+
+// Changes made in one go are applied together on the next pass of the event loop
+void SceneSync::scheduleFlush() {
+    if (flushPending || dirty.isEmpty())
+        return;
+
+    flushPending = true;
+    QTimer::singleShot(0, this, &SceneSync::flush);
+}
+
+// Removes every actor this class added and forgets all parts
+void SceneSync::removeAll() {
+    for (const QList<vtkSmartPointer<vtkActor>>& actors : drawnActors) {
+        for (const vtkSmartPointer<vtkActor>& actor : actors) {
+            lodSelector->setLevels(actor, {});
+            renderer->RemoveActor(actor);
+        }
+    }
+    instancedRenderer->clear();
+    batchRenderer->clear();
+
+    drawnActors.clear();
+    culler->clearPartActors();
+    groups.clear();
+    visibleParts.clear();
+}
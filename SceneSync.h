@@ -0,0 +1,119 @@
+#ifndef VIEWER_SCENESYNC_H
+#define VIEWER_SCENESYNC_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QModelIndex>
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkCuller.h>
+
+class ModelPart;
+class ModelPartList;
+class InstancedRenderer;
+class BatchRenderer;
+class LodSelector;
+class TreeCuller;
+
+/* Keeps a renderer in step with a ModelPartList without rebuilding the scene.
+ * The model's change notifications mark the affected parts, and the meshes they use are
+ * redrawn on the next pass of the event loop: only the actors of those meshes are removed and
+ * added again (or their instanced actor or batch rebuilt), everything else stays in the renderer.
+ * Several changes made in one go are therefore applied, and rendered, once.
+ * The renderer culls the part actors through a TreeCuller, which walks the tree so whole
+ * folders that are off screen or too small are skipped in one test.
+ */
+class SceneSync : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param model is observed for inserted, removed, changed and reset parts
+      * @param renderer receives the part actors
+      * @param instancedRenderer draws meshes shared by several visible parts
+      * @param batchRenderer merges small parts that are not instanced into a few meshes, when enabled
+      * @param lodSelector gets the levels of detail of every part drawn with its own actor
+      * @param parent is used by the QObject constructor
+      */
+    SceneSync(ModelPartList* model, vtkRenderer* renderer, InstancedRenderer* instancedRenderer,
+              BatchRenderer* batchRenderer, LodSelector* lodSelector, QObject* parent = nullptr);
+
+    /** Destructor - removes every actor this class added
+      */
+    ~SceneSync();
+
+    /** Re-check every part and redraw every mesh, used when a scene wide setting such as instancing or batching changes
+      */
+    void rebuild();
+
+    /** Apply pending changes now instead of on the next pass of the event loop
+      */
+    void flush();
+
+    /** Turn the folder level culling on or off, off goes back to the renderer's per actor culling.
+      * The caller renders afterwards.
+      */
+    void setCullingEnabled(bool enabled);
+
+    /** @return the culler, e.g. to read how much it rejected
+      */
+    TreeCuller* getCuller() const;
+
+    /** Draw only some parts and what is below them, other visible parts are left out until
+      *  the isolation ends. Their own visibility is not changed.
+      * @param enabled turns the isolation on or off
+      * @param parts are the parts to keep drawing while it is on
+      */
+    void setIsolation(bool enabled, const QSet<ModelPart*>& parts = QSet<ModelPart*>());
+
+    /** @return true if the part is kept by the current isolation, always true when not isolating
+      */
+    bool isIsolated(ModelPart* part) const;
+
+signals:
+    /** Emitted after the renderer was changed
+      * @param firstContent is true when the scene went from empty to showing something
+      */
+    void sceneChanged(bool firstContent);
+
+    /** Emitted when the set of parts kept by the isolation changed */
+    void isolationChanged();
+
+private slots:
+    void handleDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void handleRowsInserted(const QModelIndex& parent, int first, int last);
+    void handleRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+    void handleModelAboutToBeReset();
+    void handleModelReset();
+
+private:
+    ModelPart* partFromIndex(const QModelIndex& index) const;
+    void markSubtree(ModelPart* part, bool removing = false, bool boundsChanged = true);
+    void markPart(ModelPart* part, bool removing, bool boundsChanged);
+    void scheduleFlush();
+    void removeAll();
+
+    ModelPartList* model;
+    vtkRenderer* renderer;
+    InstancedRenderer* instancedRenderer;
+    BatchRenderer* batchRenderer;
+    LodSelector* lodSelector;
+
+    QHash<ModelPart*, vtkPolyData*> visibleParts;                       /**< Mesh each visible part is grouped under */
+    QHash<vtkPolyData*, QList<ModelPart*>> groups;                      /**< Visible parts of each mesh */
+    QHash<vtkPolyData*, QList<vtkSmartPointer<vtkActor>>> drawnActors;  /**< Own actors in the renderer per mesh */
+    QSet<vtkPolyData*> dirty;                                           /**< Meshes to redraw on the next flush */
+    vtkSmartPointer<TreeCuller> culler;
+    vtkSmartPointer<vtkCuller> previousCuller;                          /**< Put back when this class is destroyed */
+    bool flushPending = false;
+    bool showingParts = false;
+    bool isolating = false;
+    QSet<ModelPart*> isolatedParts;                                     /**< Parts kept while isolating, with everything below them */
+};
+
+#endif // VIEWER_SCENESYNC_H
@@ -0,0 +1,58 @@
+#ifndef VIEWER_SPSCRING_H
+#define VIEWER_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+/* Bounded lock free queue for exactly one producer thread and one consumer thread.
+ * Neither side ever blocks: push() fails when the ring is full and pop() fails when it is
+ * empty. The indices only grow and are masked into the slot array, so the capacity must be
+ * a power of two. Items are moved out on pop() so a slot does not keep references alive.
+ */
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /** Add an item, producer thread only
+      * @param item is moved into the ring
+      * @return false if the ring is full, the item is then dropped
+      */
+    bool push(T item) {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) == Capacity)
+            return false;
+
+        slots[position & (Capacity - 1)] = std::move(item);
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** Take the oldest item, consumer thread only
+      * @param item receives the item
+      * @return false if the ring is empty
+      */
+    bool pop(T& item) {
+        const size_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire))
+            return false;
+
+        item = std::move(slots[position & (Capacity - 1)]);
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @return the number of queued items, exact only on the consumer thread
+      */
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+private:
+    T slots[Capacity];
+    alignas(64) std::atomic<size_t> head{ 0 };  /**< Next slot to read, written by the consumer */
+    alignas(64) std::atomic<size_t> tail{ 0 };  /**< Next slot to write, written by the producer */
+};
+
+#endif // VIEWER_SPSCRING_H
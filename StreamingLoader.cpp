@@ -0,0 +1,275 @@
+// Header file for this class
+#include "StreamingLoader.h"
+#include "MappedSTLReader.h"
+#include "ModelPart.h"
+#include "ModelPartList.h"
+#include "LoadProfiler.h"
+
+// Q includes
+#include <QFile>
+
+// VTK headers
+#include <vtkCellArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Triangles decoded between two checks for cancellation, about 12 MB of file
+const qint64 CHUNK_TRIANGLES = 1 << 18;
+
+// How often the displayed mesh catches up with the decoder
+const int REFRESH_MS = 300;
+
+// Every corner is its own point until the mesh is welded, so the cell arrays are simple ramps
+template <typename ArrayT>
+void allocateRamps(vtkSmartPointer<vtkDataArray>& offsets, vtkSmartPointer<vtkDataArray>& connectivity, qint64 triangles) {
+    using ValueType = typename ArrayT::ValueType;
+
+    vtkSmartPointer<ArrayT> offsetArray = vtkSmartPointer<ArrayT>::New();
+    offsetArray->SetNumberOfValues(triangles + 1);
+    ValueType* offset = offsetArray->GetPointer(0);
+    for (qint64 i = 0; i <= triangles; ++i)
+        offset[i] = static_cast<ValueType>(3 * i);
+
+    vtkSmartPointer<ArrayT> connectivityArray = vtkSmartPointer<ArrayT>::New();
+    connectivityArray->SetNumberOfValues(3 * triangles);
+    ValueType* corner = connectivityArray->GetPointer(0);
+    for (qint64 i = 0; i < 3 * triangles; ++i)
+        corner[i] = static_cast<ValueType>(i);
+
+    offsets = offsetArray;
+    connectivity = connectivityArray;
+}
+
+// An array over the first values of another one, which keeps ownership of the memory
+template <typename ArrayT>
+vtkSmartPointer<ArrayT> prefixView(vtkDataArray* whole, vtkIdType values, int components = 1) {
+    vtkSmartPointer<ArrayT> view = vtkSmartPointer<ArrayT>::New();
+    view->SetNumberOfComponents(components);
+    view->SetArray(ArrayT::FastDownCast(whole)->GetPointer(0), values, 1);
+    return view;
+}
+
+} // namespace
+
+// Constructor - one file at a time is plenty, the decode already runs at disk speed
+StreamingLoader::StreamingLoader(ModelPartList* partList, QObject* parent)
+    : QObject(parent), partList(partList) {
+    pool.setMaxThreadCount(1);
+    refreshTimer.setInterval(REFRESH_MS);
+    connect(&refreshTimer, &QTimer::timeout, this, &StreamingLoader::refresh);
+}
+
+// Destructor - the parts belong to the tree, which is torn down separately
+StreamingLoader::~StreamingLoader() {
+    for (Active& load : active) {
+        load.stream->cancelled = true;
+        load.display->Initialize();
+    }
+    active.clear();
+    pool.waitForDone();
+}
+
+// The part is shown as soon as the first chunk is decoded
+ModelPart* StreamingLoader::load(const QString& name, const QString& filePath, const MeshWelder::Options& weldOptions) {
+    ModelPart* part = new ModelPart({ name, 0 });
+    part->setFilePath(filePath);
+    part->setVisible(true);
+    part->setLoadState(ModelPart::LoadState::Loading);
+    partList->appendParts(partList->getRootItem(), { part });
+
+    std::shared_ptr<Stream> stream = std::make_shared<Stream>();
+    stream->filePath = filePath;
+    stream->weldOptions = weldOptions;
+
+    Active load;
+    load.stream = stream;
+    load.display = vtkSmartPointer<vtkPolyData>::New();
+    active.insert(part, load);
+
+    pool.start([stream]() { readStream(stream); });
+    refreshTimer.start();
+
+    // Unknown total until the header is read, shown as a busy bar
+    emit progress(part, 0, 0);
+    return part;
+}
+
+// Parts go now, their workers stop at the next chunk and free the buffers
+void StreamingLoader::cancel() {
+    const QHash<ModelPart*, Active> loads = active;
+    active.clear();
+    refreshTimer.stop();
+
+    for (auto it = loads.constBegin(); it != loads.constEnd(); ++it) {
+        it->stream->cancelled = true;
+        it->display->Initialize();
+        partList->removePart(it.key());
+        emit cancelled(it->stream->filePath);
+    }
+}
+
+bool StreamingLoader::isLoading() const {
+    return !active.isEmpty();
+}
+
+// Grows the displayed meshes and swaps in the results of finished files
+void StreamingLoader::refresh() {
+    for (auto it = active.begin(); it != active.end();) {
+        Stream& stream = *it->stream;
+        if (stream.done.load(std::memory_order_acquire)) {
+            finish(it.key(), *it);
+            emit partLoaded(it.key());
+            it = active.erase(it);
+            continue;
+        }
+
+        const qint64 decoded = stream.decoded.load(std::memory_order_acquire);
+        if (decoded > it->shown) {
+            if (it->shown == 0) {
+                PartGeometry partial;
+                partial.polyData = it->display;
+                it.key()->setGeometry(partial);
+            }
+            showDecoded(*it, decoded);
+
+            const QModelIndex index = partList->indexOf(it.key());
+            emit partList->dataChanged(index, index);
+            emit progress(it.key(), decoded, stream.total);
+        }
+        ++it;
+    }
+
+    if (active.isEmpty())
+        refreshTimer.stop();
+}
+
+// Reads the file a chunk at a time into the preallocated soup, then welds and interns it
+void StreamingLoader::readStream(const std::shared_ptr<Stream>& stream) {
+    const QString& filePath = stream->filePath;
+    qint64 triangles = MappedSTLReader::binaryTriangleCount(filePath);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // Records are little endian floats, leave byte swapping to vtkSTLReader
+    triangles = -1;
+#endif
+
+    QFile file(filePath);
+    if (triangles < 0 || !file.open(QIODevice::ReadOnly) || !file.seek(MappedSTLReader::HEADER_SIZE)) {
+        // ASCII files are parsed in one go, the part appears once they are done
+        vtkSmartPointer<vtkPolyData> mesh = ModelPart::readSTL(filePath, stream->weldOptions);
+        if (!stream->cancelled) {
+            ScopedLoadTimer timer(filePath, LoadProfiler::Intern);
+            stream->geometry = GeometryRegistry::instance().intern(mesh);
+        }
+        stream->done.store(true, std::memory_order_release);
+        return;
+    }
+
+    {
+        // Reading and decoding are interleaved, both count as Parse
+        ScopedLoadTimer timer(filePath, LoadProfiler::Parse);
+
+        stream->coords = vtkSmartPointer<vtkFloatArray>::New();
+        stream->coords->SetNumberOfComponents(3);
+        stream->coords->SetNumberOfTuples(3 * triangles);
+        if (3 * triangles <= std::numeric_limits<vtkTypeInt32>::max())
+            allocateRamps<vtkTypeInt32Array>(stream->offsets, stream->connectivity, triangles);
+        else
+            allocateRamps<vtkTypeInt64Array>(stream->offsets, stream->connectivity, triangles);
+        stream->total = triangles;
+
+        QByteArray buffer;
+        buffer.resize(int(CHUNK_TRIANGLES * MappedSTLReader::RECORD_SIZE));
+        qint64 decoded = 0;
+        while (decoded < triangles) {
+            if (stream->cancelled)
+                return;
+
+            const qint64 count = std::min(CHUNK_TRIANGLES, triangles - decoded);
+            const qint64 bytes = count * MappedSTLReader::RECORD_SIZE;
+            if (file.read(buffer.data(), bytes) != bytes)
+                break;
+
+            MappedSTLReader::decodeRecords(reinterpret_cast<const uchar*>(buffer.constData()), count,
+                                           stream->coords->GetPointer(9 * decoded));
+            decoded += count;
+            stream->decoded.store(decoded, std::memory_order_release);
+        }
+    }
+
+    // A file that was cut short while being read is reported as failed
+    if (stream->decoded.load() == triangles) {
+        vtkNew<vtkPoints> points;
+        points->SetData(stream->coords);
+        vtkNew<vtkCellArray> cells;
+        cells->SetData(stream->offsets, stream->connectivity);
+        vtkSmartPointer<vtkPolyData> soup = vtkSmartPointer<vtkPolyData>::New();
+        soup->SetPoints(points);
+        soup->SetPolys(cells);
+
+        // Interning moves the points in place and an unwelded soup is what the part is drawing, so
+        // it is handed back as it is and interned on the GUI thread once the views are dropped
+        vtkSmartPointer<vtkPolyData> mesh = ModelPart::weld(soup, stream->weldOptions, filePath);
+        if (mesh == soup) {
+            stream->soup = soup;
+        }
+        else if (!stream->cancelled) {
+            ScopedLoadTimer timer(filePath, LoadProfiler::Intern);
+            stream->geometry = GeometryRegistry::instance().intern(mesh);
+        }
+    }
+    stream->done.store(true, std::memory_order_release);
+}
+
+// Points the displayed mesh at the decoded prefix of the soup, nothing is copied
+void StreamingLoader::showDecoded(Active& load, qint64 triangles) {
+    const Stream& stream = *load.stream;
+
+    vtkSmartPointer<vtkFloatArray> coords = prefixView<vtkFloatArray>(stream.coords, 9 * triangles, 3);
+    vtkNew<vtkPoints> points;
+    points->SetData(coords);
+
+    vtkNew<vtkCellArray> cells;
+    if (vtkTypeInt32Array::FastDownCast(stream.offsets))
+        cells->SetData(prefixView<vtkTypeInt32Array>(stream.offsets, triangles + 1),
+                       prefixView<vtkTypeInt32Array>(stream.connectivity, 3 * triangles));
+    else
+        cells->SetData(prefixView<vtkTypeInt64Array>(stream.offsets, triangles + 1),
+                       prefixView<vtkTypeInt64Array>(stream.connectivity, 3 * triangles));
+
+    load.display->SetPoints(points);
+    load.display->SetPolys(cells);
+    load.shown = triangles;
+}
+
+// Swaps the streamed soup for the welded mesh, the views into the soup are dropped first
+void StreamingLoader::finish(ModelPart* part, Active& load) {
+    Stream& stream = *load.stream;
+    load.display->Initialize();
+
+    // Nothing draws the soup any more, so it can be moved to its local frame and kept without a copy
+    if (stream.soup) {
+        ScopedLoadTimer timer(stream.filePath, LoadProfiler::Intern);
+        stream.geometry = GeometryRegistry::instance().intern(stream.soup);
+        stream.soup = nullptr;
+    }
+
+    if (stream.geometry.polyData && stream.geometry.polyData->GetNumberOfPoints() > 0) {
+        part->setGeometry(stream.geometry);
+        stream.geometry = PartGeometry();
+        part->setLoadState(ModelPart::LoadState::Loaded);
+    }
+    else {
+        part->releaseGeometry();
+        part->setLoadState(ModelPart::LoadState::Failed);
+    }
+
+    const QModelIndex index = partList->indexOf(part);
+    emit partList->dataChanged(index, index);
+}
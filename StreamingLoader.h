@@ -0,0 +1,122 @@
+#ifndef VIEWER_STREAMINGLOADER_H
+#define VIEWER_STREAMINGLOADER_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <atomic>
+#include <memory>
+
+#include <vtkSmartPointer.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPolyData.h>
+
+#include "MeshWelder.h"
+#include "GeometryRegistry.h"
+
+class ModelPart;
+class ModelPartList;
+
+/* Loads a single large binary STL file in chunks so the part fills in on screen while it is read.
+ * A worker allocates the whole triangle soup once from the header's triangle count and decodes
+ * the file into it a chunk at a time. On a timer the GUI thread points the part's displayed mesh
+ * at the triangles decoded so far, through arrays that share the worker's buffers instead of
+ * copying them. Once the file is read the soup is welded and interned like any other part and
+ * replaces the displayed mesh. With welding off the soup itself becomes the part's mesh: the GUI
+ * thread drops its views and interns it in place, so it is never copied. Cancelling removes the
+ * part from the tree; the buffers are freed when the worker notices, so nothing is left behind.
+ * The part is Loading until then, which keeps it out of the VR scene.
+ * ASCII files cannot be split and are read whole by the worker, without partial display.
+ */
+class StreamingLoader : public QObject {
+    Q_OBJECT
+
+public:
+    /** Constructor
+      * @param partList is the tree that streamed parts are added to
+      * @param parent is used by the QObject constructor
+      */
+    explicit StreamingLoader(ModelPartList* partList, QObject* parent = nullptr);
+
+    /** Destructor - cancels every load and waits for the workers to stop
+      */
+    ~StreamingLoader();
+
+    /** Add a visible part for a file under the root and start streaming its geometry
+      * @param name is shown in the tree
+      * @param filePath is the STL file
+      * @param weldOptions selects how vertices are merged once the whole file is read
+      * @return the new part, it is Loading until partLoaded is emitted
+      */
+    ModelPart* load(const QString& name, const QString& filePath, const MeshWelder::Options& weldOptions);
+
+    /** Abandon every load in progress and remove their parts from the tree
+      */
+    void cancel();
+
+    /** @return true while a file is being streamed
+      */
+    bool isLoading() const;
+
+    /** Files with fewer triangles than this load quickly enough to read in one go */
+    static const qint64 MIN_STREAMED_TRIANGLES = 1 << 22;
+
+signals:
+    /** Emitted after the displayed part of a mesh grew */
+    void progress(ModelPart* part, qint64 triangles, qint64 total);
+
+    /** Emitted when a load completes, the part is then Loaded or Failed */
+    void partLoaded(ModelPart* part);
+
+    /** Emitted for each load that was cancelled, after its part was removed */
+    void cancelled(const QString& filePath);
+
+private slots:
+    void refresh();
+
+private:
+    /* State shared between the GUI thread and the worker of one file. The worker writes the
+     * buffers and the result; everything it wrote before a store to decoded or done is visible
+     * to the GUI thread after the matching load
+     */
+    struct Stream {
+        QString filePath;
+        MeshWelder::Options weldOptions;
+        std::atomic<bool> cancelled{ false };
+        std::atomic<qint64> decoded{ 0 };           /**< Triangles ready to show */
+        std::atomic<bool> done{ false };
+        qint64 total = 0;                           /**< Triangles in the file, 0 until the header is read */
+        vtkSmartPointer<vtkFloatArray> coords;      /**< Whole soup, 9 floats per triangle */
+        vtkSmartPointer<vtkDataArray> offsets;      /**< Whole cell offsets, 32 or 64 bit */
+        vtkSmartPointer<vtkDataArray> connectivity; /**< Whole cell connectivity, same type as offsets */
+        PartGeometry geometry;                      /**< Interned result, set just before done */
+        vtkSmartPointer<vtkPolyData> soup;          /**< Unwelded result instead, interned by the GUI thread */
+
+        // Geometry that was never handed to the part still holds a registry reference
+        ~Stream() {
+            GeometryRegistry::instance().release(geometry);
+        }
+    };
+
+    /* A load as seen from the GUI thread */
+    struct Active {
+        std::shared_ptr<Stream> stream;
+        vtkSmartPointer<vtkPolyData> display;       /**< Mesh the part draws until the result arrives */
+        qint64 shown = 0;
+    };
+
+    static void readStream(const std::shared_ptr<Stream>& stream);
+    void showDecoded(Active& active, qint64 triangles);
+    void finish(ModelPart* part, Active& active);
+
+    ModelPartList* partList;
+    QThreadPool pool;
+    QTimer refreshTimer;
+    QHash<ModelPart*, Active> active;
+};
+
+#endif // VIEWER_STREAMINGLOADER_H
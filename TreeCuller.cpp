@@ -0,0 +1,152 @@
+// Header file for this class
+#include "TreeCuller.h"
+#include "ModelPart.h"
+
+// VTK headers
+#include <vtkCamera.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <cmath>
+
+vtkStandardNewMacro(TreeCuller);
+
+void TreeCuller::setRoot(ModelPart* root) {
+    this->root = root;
+}
+
+// The part and the folders above it now have one more actor to draw
+void TreeCuller::addPartActor(vtkProp* actor, ModelPart* part) {
+    if (!actor || !part || partActors.contains(actor))
+        return;
+
+    partActors.insert(actor, part);
+    countDrawn(part, 1);
+}
+
+void TreeCuller::removePartActor(vtkProp* actor) {
+    ModelPart* part = partActors.take(actor);
+    if (part)
+        countDrawn(part, -1);
+}
+
+// The parts are still alive, their counts are reset so a later scene starts from zero
+void TreeCuller::clearPartActors() {
+    for (ModelPart* part : partActors)
+        countDrawn(part, -1);
+    partActors.clear();
+}
+
+void TreeCuller::setMinimumPixels(double pixels) {
+    minimumPixels = pixels;
+}
+
+int TreeCuller::lastRejectedSubtrees() const {
+    return rejected;
+}
+
+// Walks the tree with this frame's camera, then keeps the props that are not part actors or passed
+double TreeCuller::Cull(vtkRenderer* renderer, vtkProp** propList, int& listLength, int&) {
+    rejected = 0;
+    if (!root)
+        return 0.0;
+
+    vtkCamera* camera = renderer->GetActiveCamera();
+    camera->GetFrustumPlanes(renderer->GetTiledAspectRatio(), planes);
+    camera->GetPosition(eye);
+
+    // Pixels covered by one unit of length at distance 1 (perspective) or anywhere (parallel), as in LodSelector
+    const int* size = renderer->GetSize();
+    const double height = std::max(1, size[1]);
+    parallel = camera->GetParallelProjection() != 0;
+    pixelsPerUnit = parallel
+        ? height / (2.0 * camera->GetParallelScale())
+        : height / (2.0 * std::tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.0));
+
+    ++frame;
+    visit(root);
+
+    int kept = 0;
+    otherProps.clear();
+    for (int i = 0; i < listLength; ++i) {
+        vtkProp* prop = propList[i];
+        auto part = partActors.constFind(prop);
+        if (part == partActors.constEnd())
+            otherProps.push_back(prop);
+        else if ((*part)->cullState().acceptedFrame == frame)
+            propList[kept++] = prop;
+    }
+
+    // The renderer still initialises the render times of the whole list itself afterwards
+    if (!otherProps.empty()) {
+        int otherCount = int(otherProps.size());
+        int otherInitialized = 0;
+        propCuller->Cull(renderer, otherProps.data(), otherCount, otherInitialized);
+        std::copy(otherProps.begin(), otherProps.begin() + otherCount, propList + kept);
+        kept += otherCount;
+    }
+    listLength = kept;
+
+    return 0.0;
+}
+
+// A subtree with nothing drawn or that is rejected is not descended into, so none of its children cost anything
+void TreeCuller::visit(ModelPart* part) {
+    if (part->cullState().drawnActors == 0)
+        return;
+
+    double bounds[6];
+    if (!part->getSubtreeBounds(bounds))
+        return;
+
+    if (rejects(bounds)) {
+        ++rejected;
+        return;
+    }
+
+    part->cullState().acceptedFrame = frame;
+
+    for (int i = 0; i < part->childCount(); ++i)
+        visit(part->child(i));
+}
+
+// Applies a change of the number of drawn actors to a part and every folder above it
+void TreeCuller::countDrawn(ModelPart* part, int change) {
+    for (ModelPart* item = part; item; item = item->parentItem())
+        item->cullState().drawnActors += change;
+}
+
+// Outside one of the side planes, or too small to cover the minimum number of pixels
+bool TreeCuller::rejects(const double bounds[6]) const {
+    // Near and far are left out, the clipping range is only reset later in the render
+    for (int plane = 0; plane < 4; ++plane) {
+        const double* p = planes + 4 * plane;
+        // The corner furthest along the inward normal, if it is outside the whole box is
+        const double x = p[0] >= 0.0 ? bounds[1] : bounds[0];
+        const double y = p[1] >= 0.0 ? bounds[3] : bounds[2];
+        const double z = p[2] >= 0.0 ? bounds[5] : bounds[4];
+        if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0.0)
+            return true;
+    }
+
+    if (minimumPixels <= 0.0)
+        return false;
+
+    const double center[3] = { (bounds[0] + bounds[1]) / 2, (bounds[2] + bounds[3]) / 2, (bounds[4] + bounds[5]) / 2 };
+    const double radius = std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                                    (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                                    (bounds[5] - bounds[4]) * (bounds[5] - bounds[4])) / 2.0;
+
+    double pixels = radius * pixelsPerUnit;
+    if (!parallel) {
+        const double distance = std::sqrt(vtkMath::Distance2BetweenPoints(center, eye)) - radius;
+        // The eye is inside the bounding sphere, the subtree fills the view
+        if (distance <= 0.0)
+            return false;
+        pixels /= distance;
+    }
+
+    return pixels < minimumPixels;
+}
@@ -0,0 +1,86 @@
+#ifndef VIEWER_TREECULLER_H
+#define VIEWER_TREECULLER_H
+
+#include <QHash>
+
+#include <vector>
+
+#include <vtkCuller.h>
+#include <vtkFrustumCoverageCuller.h>
+#include <vtkNew.h>
+
+class ModelPart;
+
+/* Culls part actors by walking the ModelPart tree from the root instead of testing every actor.
+ * Each folder's subtree bounds (cached in ModelPart) are tested against the sides of the view
+ * frustum and against a minimum projected size, so a subassembly that is off screen or too small
+ * to see is rejected with one test and its parts are never visited, nor are subtrees with no actor
+ * in the renderer. A passing part is stamped with the render's number, so nothing is built per frame.
+ * Props that are not part actors (instanced and batched actors, overlays) are handed to a VTK frustum
+ * coverage culler of its own.
+ * Replaces VTK's per prop frustum coverage culler on the renderer it is added to.
+ */
+class TreeCuller : public vtkCuller {
+public:
+    static TreeCuller* New();
+    vtkTypeMacro(TreeCuller, vtkCuller);
+
+    /** Set the tree that is walked on every render
+      * @param root is the top of the tree
+      */
+    void setRoot(ModelPart* root);
+
+    /** Tell the culler about the part actors in the renderer, anything else is not a part actor
+      * @param actor is the part's own actor, just added to the renderer
+      * @param part is the part it draws
+      */
+    void addPartActor(vtkProp* actor, ModelPart* part);
+
+    /** @param actor was passed to addPartActor() and is being taken out of the renderer, its part must still exist
+      */
+    void removePartActor(vtkProp* actor);
+
+    /** Forget every part actor, call before the parts are deleted
+      */
+    void clearPartActors();
+
+    /** @param pixels is the projected radius below which a subtree is not drawn, 0 only culls by the frustum
+      */
+    void setMinimumPixels(double pixels);
+
+    /** @return how many subtrees were rejected in the last render, each counted once at its top
+      */
+    int lastRejectedSubtrees() const;
+
+    /** Called by the renderer with the visible props, drops the part actors of rejected subtrees
+      */
+    double Cull(vtkRenderer* renderer, vtkProp** propList, int& listLength, int& initialized) override;
+
+protected:
+    TreeCuller() = default;
+    ~TreeCuller() override = default;
+
+private:
+    TreeCuller(const TreeCuller&) = delete;
+    void operator=(const TreeCuller&) = delete;
+
+    void visit(ModelPart* part);
+    bool rejects(const double bounds[6]) const;
+    static void countDrawn(ModelPart* part, int change);
+
+    ModelPart* root = nullptr;
+    QHash<vtkProp*, ModelPart*> partActors;     /**< Part actors in the renderer and the parts they draw */
+    vtkNew<vtkFrustumCoverageCuller> propCuller;/**< Culls the props that are not part actors */
+    std::vector<vtkProp*> otherProps;           /**< Reused every render to pass those props on */
+    double minimumPixels = 2.0;
+
+    /* State of the render in progress */
+    double planes[24];              /**< Left, right, bottom and top planes used, normals point inwards */
+    double eye[3];
+    double pixelsPerUnit = 0.0;
+    bool parallel = false;
+    quint64 frame = 0;              /**< Number of the render, parts that pass are stamped with it */
+    int rejected = 0;
+};
+
+#endif // VIEWER_TREECULLER_H
@@ -9,6 +9,8 @@
 
 #include "VRRenderThread.h"
 
+  /* Qt headers */
+#include <QTimer>
 
   /* Vtk headers */
 #include <vtkActor.h>
@@ -26,6 +28,11 @@
 #include <vtkSTLReader.h>
 #include <vtkDataSetmapper.h>
 #include <vtkCallbackCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkBoundingBox.h>
+#include <vtkTransform.h>
+
+#include <cmath>
 
 
 /* The class constructor is called by MainWindow and runs in the primary program thread, this thread
@@ -33,14 +40,12 @@
  * in the constructor, as it will take control of the main thread to handle the VR interaction (headset
  * rotation etc. This means that a second thread is needed to handle the VR.
  */
-VRRenderThread::VRRenderThread(QObject* parent) {
+VRRenderThread::VRRenderThread(QObject* parent) : frameStats("VR") {
 	/* Initialise actor list */
 	actors = vtkActorCollection::New();
 
 	/* Initialise command variables */
-	rotateX = 0.;
-	rotateY = 0.;
-	rotateZ = 0.;
+	endRender = false;
 }
 
 
@@ -54,47 +59,331 @@ VRRenderThread::~VRRenderThread() {
 }
 
 
-void VRRenderThread::addActorOffline(vtkActor* actor) {
+bool VRRenderThread::addActorOffline(vtkActor* actor, const QList<vtkSmartPointer<vtkPolyData>>& lodLevels) {
+	double* ac = actor->GetOrigin();
 
-	/* Check to see if render thread is running */
-	if (!this->isRunning()) {
-		double* ac = actor->GetOrigin();
+	/* I have found that these initial transforms will position the FS
+	 * car model in a sensible position but you can experiment
+	 */
+	actor->RotateX(-90);
+	actor->AddPosition(-ac[0] + 0, -ac[1] - 100, -ac[2] - 200);
 
-		/* I have found that these initial transforms will position the FS
-		 * car model in a sensible position but you can experiment
-		 */
-		actor->RotateX(-90);
-		actor->AddPosition(-ac[0] + 0, -ac[1] - 100, -ac[2] - 200);
+	const QList<vtkSmartPointer<vtkPolyData>> levels = copyForVR(lodLevels);
 
+	/* Before the VR loop starts the actor can be added directly, afterwards only the VR thread may touch the scene */
+	if (!this->isRunning()) {
 		actors->AddItem(actor);
+		if (!levels.isEmpty())
+			actorLevels.insert(actor, levels);
+		return true;
+	}
+
+	SceneCommand command;
+	command.type = SceneCommand::AddActor;
+	command.actor = actor;
+	command.lodLevels = levels;
+	return pushCommand(command);
+}
+
+
+bool VRRenderThread::removeActor(vtkActor* actor) {
+	SceneCommand command;
+	command.type = SceneCommand::RemoveActor;
+	command.actor = actor;
+	return pushCommand(command);
+}
+
+
+bool VRRenderThread::setActorColour(vtkActor* actor, double r, double g, double b) {
+	SceneCommand command;
+	command.type = SceneCommand::SetColour;
+	command.actor = actor;
+	command.values[0] = r;
+	command.values[1] = g;
+	command.values[2] = b;
+	return pushCommand(command);
+}
+
+
+bool VRRenderThread::setActorVisibility(vtkActor* actor, bool visible) {
+	SceneCommand command;
+	command.type = SceneCommand::SetVisibility;
+	command.actor = actor;
+	command.values[0] = visible ? 1.0 : 0.0;
+	return pushCommand(command);
+}
+
+
+bool VRRenderThread::setActorTransform(vtkActor* actor, const vtkMatrix4x4* matrix) {
+	SceneCommand command;
+	command.type = SceneCommand::SetTransform;
+	command.actor = actor;
+	for (int i = 0; i < 16; i++)
+		command.values[i] = matrix->GetElement(i / 4, i % 4);
+	return pushCommand(command);
+}
+
+
+bool VRRenderThread::setActorMesh(vtkActor* actor, vtkPolyData* mesh, const QList<vtkSmartPointer<vtkPolyData>>& lodLevels) {
+	const vtkSmartPointer<vtkPolyData> copy = copyForVR(mesh);
+	const QList<vtkSmartPointer<vtkPolyData>> levels = copyForVR(lodLevels);
+
+	if (!this->isRunning()) {
+		actor->GetMapper()->SetInputDataObject(copy);
+		if (levels.isEmpty())
+			actorLevels.remove(actor);
+		else
+			actorLevels.insert(actor, levels);
+		return true;
 	}
+
+	SceneCommand command;
+	command.type = SceneCommand::SetMesh;
+	command.actor = actor;
+	command.mesh = copy;
+	command.lodLevels = levels;
+	return pushCommand(command);
 }
 
 
+bool VRRenderThread::setRotationRate(double x, double y, double z) {
+	SceneCommand command;
+	command.type = SceneCommand::SetRotationRate;
+	command.values[0] = x;
+	command.values[1] = y;
+	command.values[2] = z;
+	return pushCommand(command);
+}
+
+
+bool VRRenderThread::setAnimationTimestep(double seconds) {
+	SceneCommand command;
+	command.type = SceneCommand::SetTimestep;
+	command.values[0] = seconds;
+	return pushCommand(command);
+}
+
 
 void VRRenderThread::issueCommand(int cmd, double value) {
 
-	/* Update class variables according to command */
+	/* Convert the old style commands to typed ones, a single rotation keeps the other two rates */
 	switch (cmd) {
-		/* These are just a few basic examples */
 	case END_RENDER:
+		/* Ending must work even with a full queue, so the flag is also set directly */
 		this->endRender = true;
+		{
+			SceneCommand command;
+			command.type = SceneCommand::EndRender;
+			pushCommand(command);
+		}
 		break;
 
 	case ROTATE_X:
-		this->rotateX = value;
+	case ROTATE_Y:
+	case ROTATE_Z:
+		{
+			/* The old rates were applied every 20 ms, i.e. 50 times a second */
+			const double rate = value * 50.0;
+			SceneCommand command;
+			command.type = SceneCommand::SetRotationRate;
+			command.values[0] = cmd == ROTATE_X ? rate : std::nan("");
+			command.values[1] = cmd == ROTATE_Y ? rate : std::nan("");
+			command.values[2] = cmd == ROTATE_Z ? rate : std::nan("");
+			pushCommand(command);
+		}
 		break;
+	}
+}
 
-	case ROTATE_Y:
-		this->rotateY = value;
+
+const FrameStats& VRRenderThread::getFrameStats() const {
+	return frameStats;
+}
+
+
+void VRRenderThread::beginBatch() {
+	batching = true;
+}
+
+
+bool VRRenderThread::endBatch() {
+	batching = false;
+	if (batch.empty())
+		return true;
+
+	SceneCommand command;
+	command.type = SceneCommand::Batch;
+	command.commands.swap(batch);
+	return pushCommand(std::move(command));
+}
+
+
+/* Commands behind ones already waiting must wait too, the VR thread has to apply them in order.
+ * The ring's size is only an upper bound on this thread, so room seen here is really there and
+ * a push never drops the moved command
+ */
+bool VRRenderThread::pushCommand(SceneCommand command) {
+	if (batching) {
+		batch.push_back(std::move(command));
+		return true;
+	}
+
+	if (overflow.empty() && commands.size() < COMMAND_CAPACITY)
+		return commands.push(std::move(command));
+	if (overflow.size() >= OVERFLOW_CAPACITY)
+		return false;
+
+	overflow.push_back(std::move(command));
+	if (!overflowPending) {
+		overflowPending = true;
+		QTimer::singleShot(OVERFLOW_RETRY_MS, this, [this]() { sendOverflow(); });
+	}
+	return true;
+}
+
+
+/* The copy shares the points, cells and attribute arrays but not the data object, whose pipeline
+ * information each mapper updates. The points cache their bounds, so they are computed here once
+ * while only the GUI thread can see them; the cell table is the copy's own
+ */
+vtkSmartPointer<vtkPolyData> VRRenderThread::copyForVR(vtkPolyData* mesh) {
+	if (!mesh)
+		return nullptr;
+
+	vtkSmartPointer<vtkPolyData> copy = vtkSmartPointer<vtkPolyData>::New();
+	copy->ShallowCopy(mesh);
+	copy->GetBounds();
+	if (copy->NeedToBuildCells())
+		copy->BuildCells();
+	return copy;
+}
+
+
+QList<vtkSmartPointer<vtkPolyData>> VRRenderThread::copyForVR(const QList<vtkSmartPointer<vtkPolyData>>& meshes) {
+	QList<vtkSmartPointer<vtkPolyData>> copies;
+	for (const vtkSmartPointer<vtkPolyData>& mesh : meshes)
+		copies.append(copyForVR(mesh));
+	return copies;
+}
+
+
+void VRRenderThread::sendOverflow() {
+	overflowPending = false;
+	while (!overflow.empty() && commands.size() < COMMAND_CAPACITY) {
+		commands.push(std::move(overflow.front()));
+		overflow.pop_front();
+	}
+
+	/* The VR thread has stopped, nothing will make room any more */
+	if (isFinished()) {
+		overflow.clear();
+		return;
+	}
+
+	if (!overflow.empty()) {
+		overflowPending = true;
+		QTimer::singleShot(OVERFLOW_RETRY_MS, this, [this]() { sendOverflow(); });
+	}
+}
+
+
+/* Only the commands that were queued when the frame started are applied, so a GUI thread that keeps
+ * sending cannot stall the headset
+ */
+void VRRenderThread::drainCommands() {
+	size_t count = commands.size();
+	SceneCommand command;
+
+	while (count-- > 0 && commands.pop(command)) {
+		applyCommand(command);
+
+		/* Release the actor reference now rather than when the next command overwrites it */
+		command = SceneCommand();
+	}
+}
+
+
+void VRRenderThread::applyCommand(SceneCommand& command) {
+	vtkActor* actor = command.actor;
+
+	switch (command.type) {
+	case SceneCommand::AddActor:
+		placeInScene(actor);
+		renderer->AddActor(actor);
+		if (!command.lodLevels.isEmpty())
+			lodSelector->setLevels(actor, command.lodLevels);
 		break;
 
-	case ROTATE_Z:
-		this->rotateZ = value;
+	case SceneCommand::RemoveActor:
+		lodSelector->setLevels(actor, {});
+		renderer->RemoveActor(actor);
+		break;
+
+	case SceneCommand::SetColour:
+		actor->GetProperty()->SetColor(command.values[0], command.values[1], command.values[2]);
+		break;
+
+	case SceneCommand::SetVisibility:
+		actor->SetVisibility(command.values[0] != 0.0);
+		break;
+
+	case SceneCommand::SetTransform:
+		{
+			vtkNew<vtkMatrix4x4> matrix;
+			matrix->DeepCopy(command.values);
+			placeInScene(actor, matrix);
+		}
+		break;
+
+	case SceneCommand::SetMesh:
+		/* The selector hands back the actor's own mapper, its levels are registered again for the new mesh */
+		lodSelector->setLevels(actor, {});
+		actor->GetMapper()->SetInputDataObject(command.mesh);
+		if (!command.lodLevels.isEmpty())
+			lodSelector->setLevels(actor, command.lodLevels);
+		break;
+
+	case SceneCommand::SetRotationRate:
+		/* NaN leaves a rate unchanged, used by the single axis issueCommand() calls */
+		for (int i = 0; i < 3; i++) {
+			if (std::isnan(command.values[i]))
+				command.values[i] = animation.getRate(i);
+		}
+		animation.setRates(command.values[0], command.values[1], command.values[2]);
+		break;
+
+	case SceneCommand::SetTimestep:
+		animation.setTimestep(command.values[0]);
+		break;
+
+	case SceneCommand::EndRender:
+		endRender = true;
+		break;
+
+	case SceneCommand::Batch:
+		for (SceneCommand& part : command.commands)
+			applyCommand(part);
 		break;
 	}
 }
 
+/* Every actor concatenates the one scene transform, so a tick still updates a single object, but
+ * each actor stays a prop of its own that the renderer's frustum culler tests and whose bounds
+ * (used by the level of detail selector) are in world coordinates
+ */
+void VRRenderThread::placeInScene(vtkActor* actor, const vtkMatrix4x4* matrix) {
+	vtkSmartPointer<vtkTransform> placement = vtkTransform::SafeDownCast(actor->GetUserTransform());
+	if (!placement) {
+		placement = vtkSmartPointer<vtkTransform>::New();
+		actor->SetUserTransform(placement);
+	}
+
+	placement->Identity();
+	placement->Concatenate(animation.getTransform());
+	if (matrix)
+		placement->Concatenate(matrix->GetData());
+}
+
 /* This function runs in a separate thread. This means that the program
  * can fork into two separate execution paths. This thread is triggered by
  * calling VRRenderThread::start()
@@ -120,10 +409,25 @@ void VRRenderThread::run() {
 
 	renderer->SetBackground(colors->GetColor3d("BkgColor").GetData());
 
-	/* Loop through list of actors provided and add to scene */
+	/* The scene turns about the centre of the parts it starts with */
+	vtkBoundingBox box;
 	vtkActor* a;
 	actors->InitTraversal();
 	while ((a = (vtkActor*)actors->GetNextActor())) {
+		box.AddBounds(a->GetBounds());
+	}
+	if (box.IsValid()) {
+		double centre[3];
+		box.GetCenter(centre);
+		animation.setPivot(centre);
+	}
+
+	/* Loop through list of actors provided and add them to the renderer, each one shares the
+	 * animation's transform so turning the scene still only updates that one transform
+	 */
+	actors->InitTraversal();
+	while ((a = (vtkActor*)actors->GetNextActor())) {
+		placeInScene(a);
 		renderer->AddActor(a);
 	}
 
@@ -139,6 +443,12 @@ void VRRenderThread::run() {
 	camera = vtkOpenVRCamera::New();
 	renderer->SetActiveCamera(camera);
 
+	/* Switch levels of detail by screen size, the headset needs a steady 90 frames per second */
+	LodSelector selector(renderer, 1.0 / 90.0);
+	lodSelector = &selector;
+	for (auto it = actorLevels.constBegin(); it != actorLevels.constEnd(); ++it)
+		selector.setLevels(it.key(), it.value());
+
 	/* The render window interactor captures mouse events
 	 * and will perform appropriate camera or actor manipulation
 	 * depending on the nature of the events.
@@ -148,54 +458,30 @@ void VRRenderThread::run() {
 	interactor->Initialize();
 	window->Render();
 
+	/* Time every frame of the loop, the GUI can dump them next to the desktop frames and loads */
+	frameStats.clear();
+	FrameRecorder recorder(window, renderer, &frameStats);
+
 
 	/* Now start the VR - we will implement the command loop manually
 	 * so it can be interrupted to make modifications to the actors
 	 * (i.e. to implement animation)
 	 */
-	endRender = false;
-	t_last = std::chrono::steady_clock::now();
-
 	while (!interactor->GetDone() && !this->endRender) {
+		recorder.markFrameStart();
+
+		/* Apply the scene edits sent by the GUI since the last frame */
+		drainCommands();
+
 		interactor->DoOneEvent(window, renderer);
 
-		/* Check to see if enough time has elapsed since last update
-		 * This looks overcomplicated (and it is, C++ loves to make things unecessarily complicated!) but
-		 * is really just checking if more than 20ms have elaspsed since the last animation step. The
-		 * complications comes from the fact that numbers representing time on computers don't usually have
-		 * standard second/millisecond units. Because everything is a class in C++, the converion from
-		 * computer units to seconds/milliseconds ends up looking like what you see below.
-		 *
-		 * My choice of 20ms is arbitrary, if this value is too small the animation calculations could begin to
-		 * interfere with the interator processes and make the simulation unresponsive. If it is too large
-		 * the animations will be jerky. Play with the value to see what works best.
+		/* Advance the animation by the real time since the last frame. The scheduler updates one
+		 * shared transform, so the cost does not depend on the number of actors and the speed does
+		 * not depend on how often this loop gets round.
 		 */
-		if (std::chrono::duration_cast <std::chrono::milliseconds> (std::chrono::steady_clock::now() - t_last).count() > 20) {
-
-			/* Do things that might need doing ... */
-			vtkActorCollection* actorList = renderer->GetActors();
-			vtkActor* a;
-
-			/* X Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor*)actorList->GetNextActor())) {
-				a->RotateX(rotateX);
-			}
-
-			/* Y Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor*)actorList->GetNextActor())) {
-				a->RotateY(rotateY);
-			}
-
-			/* Z Rotation */
-			actorList->InitTraversal();
-			while ((a = (vtkActor*)actorList->GetNextActor())) {
-				a->RotateZ(rotateZ);
-			}
-
-			/* Remember time now */
-			t_last = std::chrono::steady_clock::now();
-		}
+		animation.tick(AnimationScheduler::Clock::now());
 	}
-}
\ No newline at end of file
+
+	/* The selector goes out of scope with this function */
+	lodSelector = nullptr;
+}
@@ -10,11 +10,20 @@
 #define VR_RENDER_THREAD_H
 
   /* Project headers */
+#include "LodSelector.h"
+#include "SpscRing.h"
+#include "AnimationScheduler.h"
+#include "FrameStats.h"
 
   /* Qt headers */
 #include <QThread>
-#include <QMutex>
-#include <QWaitCondition>
+#include <QHash>
+#include <QList>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <vector>
 
 /* Vtk headers */
 #include <vtkActor.h>
@@ -24,6 +33,8 @@
 #include <vtkOpenVRCamera.h>	
 #include <vtkActorCollection.h>
 #include <vtkCommand.h>
+#include <vtkMatrix4x4.h>
+#include <vtkTransform.h>
 
 
 
@@ -54,18 +65,73 @@ public:
       */
     ~VRRenderThread();
 
-    /** This allows actors to be added to the VR renderer BEFORE the VR
-      * interactor has been started
+    /** This allows actors to be added to the VR renderer. Before the VR interactor has been started
+      * the actor is added directly, afterwards it is queued and added at the start of the next frame.
+      * The actor must not be changed by the GUI thread once it has been handed over. Its mapper's
+      * input must be a data object of its own, see copyForVR(); the arrays behind it are shared with
+      * the desktop and must not be edited afterwards. Replace a mesh with setActorMesh() instead.
+      * @param lodLevels are reduced versions of the actor's mesh, switched by screen size in the headset.
+      *  The VR thread gets copies of them, as for the mesh
+      * @return false if the command queue was full and the actor was not added
      */
-    void addActorOffline(vtkActor* actor);
+    bool addActorOffline(vtkActor* actor, const QList<vtkSmartPointer<vtkPolyData>>& lodLevels = {});
 
+    /** The following functions queue an edit of the running VR scene, they can be called from the
+      * GUI thread at any time and never block. Edits that find the command ring full wait in an
+      * overflow queue on the GUI side and are sent as the VR thread catches up. Each returns false
+      * if the overflow queue was full as well, the edit is then dropped.
+      * @param actor is an actor previously passed to addActorOffline()
+      */
+    bool removeActor(vtkActor* actor);
+    bool setActorColour(vtkActor* actor, double r, double g, double b);
+    bool setActorVisibility(vtkActor* actor, bool visible);
+    bool setActorTransform(vtkActor* actor, const vtkMatrix4x4* matrix);
+
+    /** Point an actor's mapper at a different mesh, e.g. when a part switches shading or is reloaded.
+      * @param mesh is the desktop mesh, the VR thread gets a copy of it as for the levels
+      */
+    bool setActorMesh(vtkActor* actor, vtkPolyData* mesh, const QList<vtkSmartPointer<vtkPolyData>>& lodLevels = {});
+
+    /** Make the VR thread's own data object over a mesh's arrays. The two render threads then each
+      * update the pipeline state of a different object, while the geometry itself is not copied.
+      * Bounds and cells are filled in here, so neither thread writes the shared arrays' caches.
+      * GUI thread only.
+      * @return the copy, null for a null mesh
+      */
+    static vtkSmartPointer<vtkPolyData> copyForVR(vtkPolyData* mesh);
+
+    /** Set how fast the whole scene turns about its centre
+      * @param x, y, z are the rates about each axis in degrees per second
+      * @return false if the command queue was full
+      */
+    bool setRotationRate(double x, double y, double z);
+
+    /** Choose how the animation advances
+      * @param seconds is a fixed step length, or 0 to advance by the real time of every frame
+      * @return false if the command queue was full
+      */
+    bool setAnimationTimestep(double seconds);
+
+    /** Collect the edits queued until endBatch() into one command, so a whole subtree takes a
+      * single slot of the command ring and reaches the VR scene in the same frame. GUI thread only.
+      */
+    void beginBatch();
+
+    /** Queue the edits collected since beginBatch()
+      * @return false if the queue was full, none of the edits in the batch were queued
+      */
+    bool endBatch();
 
     /** This allows commands to be issued to the VR thread in a thread safe way.
-      * Function will set variables within the class to indicate the type of
-      * action / animation / etc to perform. The rendering thread will then impelement this.
+      * Kept for compatibility, the command is converted to one of the typed commands above. ROTATE_*
+      * values are degrees per 20 ms step as before and are converted to degrees per second.
       */
     void issueCommand(int cmd, double value);
 
+    /** Timings of the most recent VR frames, kept after the thread stops. Safe to read from any thread.
+      */
+    const FrameStats& getFrameStats() const;
+
 
 protected:
     /** This is a re-implementation of a QThread function
@@ -73,33 +139,77 @@ protected:
     void run() override;
 
 private:
+    /* One edit of the VR scene, passed from the GUI thread to the VR thread through the command ring */
+    struct SceneCommand {
+        enum Type { AddActor, RemoveActor, SetColour, SetVisibility, SetTransform, SetMesh, SetRotationRate, SetTimestep, EndRender, Batch };
+
+        Type                                    type = EndRender;
+        vtkSmartPointer<vtkActor>               actor;          /*< Keeps the actor alive while queued */
+        vtkSmartPointer<vtkPolyData>            mesh;           /*< SetMesh only */
+        QList<vtkSmartPointer<vtkPolyData>>     lodLevels;      /*< AddActor and SetMesh */
+        double                                  values[16];     /*< Colour, visibility, rates or a row major matrix */
+        std::vector<SceneCommand>               commands;       /*< Batch only, applied in order */
+    };
+
+    /** Size of the command ring */
+    static const size_t COMMAND_CAPACITY = 1024;
+
+    /** Commands waiting on the GUI side for room in the ring, beyond this the GUI side calls return false */
+    static const size_t OVERFLOW_CAPACITY = 65536;
+
+    /** Wait before trying to move waiting commands into the ring again */
+    static const int OVERFLOW_RETRY_MS = 5;
+
+    bool pushCommand(SceneCommand command);
+
+    static QList<vtkSmartPointer<vtkPolyData>> copyForVR(const QList<vtkSmartPointer<vtkPolyData>>& meshes);
+
+    /** Move waiting commands into the ring in order, runs on the GUI thread */
+    void sendOverflow();
+
+    /** Apply the commands queued before this frame started, runs on the VR thread */
+    void drainCommands();
+    void applyCommand(SceneCommand& command);
+
+    /** Give an actor the scene rotation followed by its own matrix, runs on the VR thread
+      * @param matrix is the actor's own placement, null for none
+      */
+    void placeInScene(vtkActor* actor, const vtkMatrix4x4* matrix = nullptr);
+
     /* Standard VTK VR Classes */
     vtkSmartPointer<vtkOpenVRRenderWindow>              window;
     vtkSmartPointer<vtkOpenVRRenderWindowInteractor>    interactor;
     vtkSmartPointer<vtkOpenVRRenderer>                  renderer;
     vtkSmartPointer<vtkOpenVRCamera>                    camera;
 
-    /* Use to synchronise passing of data to VR thread */
-    QMutex                                              mutex;
-    QWaitCondition                                      condition;
+    /* Commands from the GUI thread, single producer (GUI) and single consumer (VR thread) */
+    SpscRing<SceneCommand, COMMAND_CAPACITY>            commands;
+
+    /* Commands that did not fit in the ring and the batch being collected, only used on the GUI thread */
+    std::deque<SceneCommand>                            overflow;
+    bool                                                overflowPending = false;
+    std::vector<SceneCommand>                           batch;
+    bool                                                batching = false;
+
+    /* Switches levels of detail while the VR loop runs, only used on the VR thread */
+    LodSelector*                                        lodSelector = nullptr;
 
     /** List of actors that will need to be added to the VR scene */
     vtkSmartPointer<vtkActorCollection>                 actors;
 
-    /** A timer to help implement animations and visual effects */
-    std::chrono::time_point<std::chrono::steady_clock>  t_last;
+    /** Reduced levels of detail of the actors that have them */
+    QHash<vtkActor*, QList<vtkSmartPointer<vtkPolyData>>> actorLevels;
+
+    /** Advances the scene rotation by real elapsed time, only used on the VR thread */
+    AnimationScheduler                                  animation;
+
+    /** Frame timings of the VR loop, written on the VR thread */
+    FrameStats                                          frameStats;
 
     /** This will be set to false by the constructor, if it is set to true
       * by the GUI then the rendering will end
       */
-    bool                                                endRender;
-
-    /* Some variables to indicate animation actions to apply.
-     *
-     */
-    double rotateX;         /*< Degrees to rotate around X axis (per time-step) */
-    double rotateY;         /*< Degrees to rotate around Y axis (per time-step) */
-    double rotateZ;         /*< Degrees to rotate around Z axis (per time-step) */
+    std::atomic<bool>                                   endRender;
 };
 
 
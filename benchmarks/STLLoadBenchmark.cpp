@@ -0,0 +1,170 @@
+/*  STL load benchmark
+ *
+ *  Standalone executable comparing MappedSTLReader with the vtkSTLReader path that
+ *  ModelPart::loadSTL used before it, on the same files. It lives in its own directory, away from
+ *  the viewer's main.cpp, and is built as a separate target from this file and the source root's
+ *  MappedSTLReader.cpp and LoadProfiler.cpp, with the source root on the include path, linking Qt
+ *  Core and the VTK IOGeometry and RenderingCore modules (LoadProfiler watches mappers for their
+ *  first draw, even though this program never draws). It is not part of the viewer target.
+ *
+ *  Usage: STLLoadBenchmark file1.stl [file2.stl ...]
+ *
+ *  Each reader runs in a child process of this program so that the peak resident set size
+ *  reported belongs to that reader alone.
+ */
+
+#include "MappedSTLReader.h"
+
+// Q includes
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMap>
+#include <QProcess>
+#include <QStringList>
+#include <QTextStream>
+
+// VTK headers
+#include <vtkSmartPointer.h>
+#include <vtkSTLReader.h>
+#include <vtkPolyData.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Results reported by one child process
+struct ReaderRun {
+    QMap<QString, double> milliseconds;     // per file load time
+    QMap<QString, qint64> triangles;        // per file triangle count
+    qint64 peakKB = 0;
+};
+
+// Peak resident memory of this process in kilobytes
+qint64 peakResidentKB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return static_cast<qint64>(counters.PeakWorkingSetSize / 1024);
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;          // bytes on macOS
+#else
+    return usage.ru_maxrss;                 // kilobytes on Linux
+#endif
+#endif
+}
+
+// Loads one file with the requested reader, the output is kept alive until the timer stops
+qint64 loadFile(const QString& reader, const QString& fileName) {
+    if (reader == "mapped") {
+        vtkSmartPointer<vtkPolyData> geometry = MappedSTLReader::read(fileName);
+        return geometry ? geometry->GetNumberOfCells() : -1;
+    }
+
+    vtkSmartPointer<vtkSTLReader> stlReader = vtkSmartPointer<vtkSTLReader>::New();
+    stlReader->SetFileName(fileName.toStdString().c_str());
+    stlReader->Update();
+    return stlReader->GetOutput()->GetNumberOfCells();
+}
+
+// Child mode: time every file with one reader and print tab separated results
+int runReader(const QString& reader, const QStringList& files) {
+    QTextStream out(stdout);
+
+    for (const QString& fileName : files) {
+        QElapsedTimer timer;
+        timer.start();
+        const qint64 triangles = loadFile(reader, fileName);
+        const double ms = timer.nsecsElapsed() / 1.0e6;
+
+        out << "file\t" << fileName << "\t" << ms << "\t" << triangles << "\n";
+    }
+
+    out << "peak\t" << peakResidentKB() << "\n";
+    return 0;
+}
+
+// Parent mode: run a child process for a reader and collect its output
+ReaderRun launchReader(const QString& reader, const QStringList& files) {
+    ReaderRun run;
+
+    QProcess child;
+    child.start(QCoreApplication::applicationFilePath(), QStringList({ "--reader", reader }) + files);
+    child.waitForFinished(-1);
+
+    const QStringList lines = QString::fromLocal8Bit(child.readAllStandardOutput()).split('\n');
+    for (const QString& line : lines) {
+        const QStringList fields = line.split('\t');
+        if (fields.size() == 4 && fields[0] == "file") {
+            run.milliseconds.insert(fields[1], fields[2].toDouble());
+            run.triangles.insert(fields[1], fields[3].toLongLong());
+        }
+        else if (fields.size() == 2 && fields[0] == "peak") {
+            run.peakKB = fields[1].toLongLong();
+        }
+    }
+
+    return run;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    args.removeFirst();
+
+    if (args.size() >= 2 && args[0] == "--reader") {
+        const QString reader = args[1];
+        return runReader(reader, args.mid(2));
+    }
+
+    QTextStream out(stdout);
+    if (args.isEmpty()) {
+        out << "Usage: STLLoadBenchmark file1.stl [file2.stl ...]\n";
+        return 1;
+    }
+
+    const ReaderRun vtkRun = launchReader("vtk", args);
+    const ReaderRun mappedRun = launchReader("mapped", args);
+
+    out << qSetFieldWidth(40) << Qt::left << "File" << qSetFieldWidth(14) << Qt::right
+        << "Triangles" << "vtkSTLReader" << "Mapped" << "Speedup" << qSetFieldWidth(0) << "\n";
+
+    double vtkTotal = 0.0;
+    double mappedTotal = 0.0;
+    for (const QString& fileName : args) {
+        const double vtkMs = vtkRun.milliseconds.value(fileName);
+        const double mappedMs = mappedRun.milliseconds.value(fileName);
+        vtkTotal += vtkMs;
+        mappedTotal += mappedMs;
+
+        out << qSetFieldWidth(40) << Qt::left << QFileInfo(fileName).fileName() << qSetFieldWidth(14) << Qt::right
+            << mappedRun.triangles.value(fileName)
+            << QString::number(vtkMs, 'f', 1) + " ms"
+            << QString::number(mappedMs, 'f', 1) + " ms"
+            << (mappedMs > 0.0 ? QString::number(vtkMs / mappedMs, 'f', 2) + "x" : QString("-"))
+            << qSetFieldWidth(0) << "\n";
+    }
+
+    out << qSetFieldWidth(40) << Qt::left << "Total" << qSetFieldWidth(14) << Qt::right << ""
+        << QString::number(vtkTotal, 'f', 1) + " ms"
+        << QString::number(mappedTotal, 'f', 1) + " ms"
+        << (mappedTotal > 0.0 ? QString::number(vtkTotal / mappedTotal, 'f', 2) + "x" : QString("-"))
+        << qSetFieldWidth(0) << "\n";
+
+    out << qSetFieldWidth(40) << Qt::left << "Peak RSS" << qSetFieldWidth(14) << Qt::right << ""
+        << QString::number(vtkRun.peakKB / 1024.0, 'f', 1) + " MB"
+        << QString::number(mappedRun.peakKB / 1024.0, 'f', 1) + " MB"
+        << qSetFieldWidth(0) << "\n";
+
+    return 0;
+}
@@ -1,9 +1,67 @@
 #include "mainwindow.h"
+#include "RenderBenchmark.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+
+// Parses the benchmark options and runs it, see RenderBenchmark for what is measured
+static int runBenchmark(const QCoreApplication& app)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Offscreen render benchmark, writes frame times as JSON");
+    parser.addHelpOption();
+    parser.addOption({ "benchmark", "Run the offscreen render benchmark instead of the viewer." });
+    parser.addOption({ "visible", "Show parts whose name matches <pattern> (wildcards, repeatable). Default: all.", "pattern" });
+    parser.addOption({ "frames", "Frames in the camera orbit.", "count", "360" });
+    parser.addOption({ "size", "Offscreen image size.", "WxH", "1280x720" });
+    parser.addOption({ "output", "Write the JSON report to <file> instead of standard output.", "file" });
+    parser.addOption({ "no-instancing", "Give every part its own actor." });
+    parser.addOption({ "batch", "Merge small parts into a few meshes instead of one actor each." });
+    parser.addOption({ "no-lod", "Draw every part at full detail." });
+    parser.addOption({ "no-culling", "Use VTK's per actor culling instead of culling whole folders." });
+    parser.addOption({ "gpu", "Allow a hardware OpenGL driver instead of Mesa's software rasteriser." });
+    parser.addOption({ "optimise-meshes", "Reorder triangles and vertices of loaded meshes for the vertex cache and overdraw." });
+    parser.addPositionalArgument("inputs", "Folders and STL files to load.", "<folder|file.stl>...");
+    parser.process(app);
+
+    RenderBenchmark::Options options;
+    options.inputs = parser.positionalArguments();
+    options.visiblePatterns = parser.values("visible");
+    options.frames = qMax(1, parser.value("frames").toInt());
+    const QStringList size = parser.value("size").split('x');
+    if (size.size() == 2) {
+        options.width = qMax(1, size[0].toInt());
+        options.height = qMax(1, size[1].toInt());
+    }
+    options.outputPath = parser.value("output");
+    options.instancing = !parser.isSet("no-instancing");
+    options.batching = parser.isSet("batch");
+    options.levelsOfDetail = !parser.isSet("no-lod");
+    options.culling = !parser.isSet("no-culling");
+    options.useGpu = parser.isSet("gpu");
+    options.optimiseMeshes = parser.isSet("optimise-meshes");
+
+    if (options.inputs.isEmpty()) {
+        QTextStream(stderr) << "No folders or STL files given\n";
+        return 1;
+    }
+
+    return RenderBenchmark(options).run();
+}
 
 int main(int argc, char *argv[])
 {
+    // The benchmark draws offscreen, so it runs without a GUI application or a display
+    for (int i = 1; i < argc; ++i) {
+        if (QString(argv[i]) == "--benchmark") {
+            QCoreApplication app(argc, argv);
+            return runBenchmark(app);
+        }
+    }
+
     QApplication a(argc, argv);
     MainWindow w;
     w.show();
@@ -5,6 +5,24 @@
 #include "ModelPartList.h"
 #include "optiondialog.h"
 #include "VRRenderThread.h"
+#include "PartLoader.h"
+#include "StreamingLoader.h"
+#include "MappedSTLReader.h"
+#include "InstancedRenderer.h"
+#include "BatchRenderer.h"
+#include "GeometryCache.h"
+#include "LodGenerator.h"
+#include "LodSelector.h"
+#include "NormalGenerator.h"
+#include "SceneSync.h"
+#include "MemoryBudget.h"
+#include "GeometryCompactor.h"
+#include "RendererSetup.h"
+#include "LoadProfiler.h"
+#include "FrameStats.h"
+#include "PartPicker.h"
+#include "PartSearch.h"
+#include "PartFilterModel.h"
 
 // Q includes
 #include <QFileDialog>
@@ -14,6 +32,16 @@
 #include <QDir>
 #include <QFileInfoList>
 #include <QDebug>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QMenuBar>
+#include <QInputDialog>
+#include <QColorDialog>
+#include <QLocale>
+#include <QAbstractEventDispatcher>
+#include <QLineEdit>
+#include <QToolBar>
+#include <QTimer>
 
 // VTK headers
 #include <vtkGenericOpenGLRenderWindow.h>
@@ -29,6 +57,19 @@
 #include <vtkSTLReader.h>
 #include <vtkDataSetmapper.h>
 #include <vtkCallbackCommand.h>
+#include <vtkTextProperty.h>
+
+#include <algorithm>
+
+namespace {
+
+// Searches with at most this many matches open the folders that hold them
+const int MAX_EXPANDED_MATCHES = 200;
+
+// Pause in typing or loading before the search runs again
+const int SEARCH_DELAY_MS = 150;
+
+} // namespace
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
@@ -41,20 +82,139 @@ MainWindow::MainWindow(QWidget* parent)
     connect(ui->startVRButton, &QPushButton::clicked, this, &MainWindow::handleStartVR);
 
     this->partList = new ModelPartList("PartsList");
-    ui->treeView->setModel(this->partList);
+    // The view goes through a filter so the search box can narrow the tree, its indices are mapped back to the list
+    partFilter = new PartFilterModel(this);
+    partFilter->setPartList(partList);
+    ui->treeView->setModel(partFilter);
     ui->treeView->addAction(ui->actionItemOptions);
     ui->treeView->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(ui->treeView, &QTreeView::customContextMenuRequested, this, &MainWindow::showContextMenu);
     connect(ui->treeView, &QTreeView::clicked, this, &MainWindow::handleTreeClicked);
+    // Several parts can be picked for the subtree actions of the context menu
+    ui->treeView->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
     connect(ui->actionOpenSingleFile, &QAction::triggered, this, &MainWindow::on_actionOpenSingleFile_triggered);
     connect(ui->actionClearTreeView, &QAction::triggered, this, &MainWindow::on_actionClearTreeView_triggered);
 
     connect(ui->stopVRButton, &QPushButton::clicked, this, &MainWindow::handleStopVR);
 
+    // Folder loading runs on a worker pool, progress and cancel live in the status bar
+    partLoader = new PartLoader(partList, this);
+    loadProgress = new QProgressBar(this);
+    loadProgress->setMaximumWidth(200);
+    loadProgress->hide();
+    cancelLoadButton = new QPushButton(tr("Cancel"), this);
+    cancelLoadButton->hide();
+    ui->statusbar->addPermanentWidget(loadProgress);
+    ui->statusbar->addPermanentWidget(cancelLoadButton);
+
+    connect(cancelLoadButton, &QPushButton::clicked, partLoader, &PartLoader::cancel);
+    connect(partLoader, &PartLoader::progress, this, &MainWindow::handleLoadProgress);
+    connect(partLoader, &PartLoader::finished, this, &MainWindow::handleLoadFinished);
+    connect(partLoader, &PartLoader::partLoaded, this, &MainWindow::handlePartLoaded);
+    // Parts loaded on demand are read the first time they are made visible
+    connect(partList, &ModelPartList::dataChanged, this, &MainWindow::handlePartsChanged);
+
+    // Huge single files are streamed in, sharing the progress bar and cancel button
+    streamingLoader = new StreamingLoader(partList, this);
+    connect(cancelLoadButton, &QPushButton::clicked, streamingLoader, &StreamingLoader::cancel);
+    connect(streamingLoader, &StreamingLoader::progress, this, &MainWindow::handleStreamProgress);
+    connect(streamingLoader, &StreamingLoader::partLoaded, this, &MainWindow::handleStreamLoaded);
+    connect(streamingLoader, &StreamingLoader::cancelled, this, &MainWindow::handleStreamCancelled);
+
+    // Settings that apply to files loaded from now on
+    QMenu* loadingMenu = menuBar()->addMenu(tr("Loading"));
+    loadingMenu->addAction(tr("Vertex welding..."), this, &MainWindow::handleWeldOptions);
+    QAction* meshOrderAction = loadingMenu->addAction(tr("Optimise mesh order for the GPU"));
+    meshOrderAction->setCheckable(true);
+    connect(meshOrderAction, &QAction::toggled, this, &MainWindow::handleMeshOrderToggled);
+    QAction* cacheAction = loadingMenu->addAction(tr("Use geometry cache"));
+    cacheAction->setCheckable(true);
+    cacheAction->setChecked(true);
+    connect(cacheAction, &QAction::toggled, partLoader, &PartLoader::setCacheEnabled);
+    QAction* deferredAction = loadingMenu->addAction(tr("Load geometry on demand"));
+    deferredAction->setCheckable(true);
+    connect(deferredAction, &QAction::toggled, partLoader, &PartLoader::setDeferred);
+    QAction* streamingAction = loadingMenu->addAction(tr("Stream large single files"));
+    streamingAction->setCheckable(true);
+    streamingAction->setChecked(streamLargeFiles);
+    connect(streamingAction, &QAction::toggled, this, &MainWindow::handleStreamingToggled);
+    loadingMenu->addAction(tr("Memory budget..."), this, &MainWindow::handleMemoryBudget);
+    QAction* compactAction = loadingMenu->addAction(tr("Compact hidden geometry"));
+    compactAction->setCheckable(true);
+    connect(compactAction, &QAction::toggled, this, &MainWindow::handleCompactionToggled);
+    loadingMenu->addAction(tr("Compact precision..."), this, &MainWindow::handleCompactPrecision);
+    loadingMenu->addAction(tr("Compact geometry report..."), this, &MainWindow::handleCompactReport);
+    loadingMenu->addSeparator();
+    loadingMenu->addAction(tr("Load timing report..."), this, &MainWindow::handleLoadReport);
+    loadingMenu->addAction(tr("Export load trace..."), this, &MainWindow::handleExportLoadTrace);
+    loadingMenu->addAction(tr("Clear geometry cache"), this, &MainWindow::handleClearGeometryCache);
+
+    // Reduced levels of detail are built in the background once parts are loaded
+    lodGenerator = new LodGenerator(this);
+    connect(lodGenerator, &LodGenerator::levelsReady, this, &MainWindow::handleLevelsReady);
+    // So are smooth shading meshes, while smooth shading is switched on
+    normalGenerator = new NormalGenerator(this);
+    connect(normalGenerator, &NormalGenerator::normalsReady, this, &MainWindow::handleNormalsReady);
+    // Hidden parts can trade their meshes for compact copies, decoded again when they are shown
+    geometryCompactor = new GeometryCompactor(this);
+
+    QMenu* viewMenu = menuBar()->addMenu(tr("View"));
+    QAction* instancingAction = viewMenu->addAction(tr("Instance duplicate parts"));
+    instancingAction->setCheckable(true);
+    instancingAction->setChecked(true);
+    connect(instancingAction, &QAction::toggled, this, &MainWindow::handleInstancingToggled);
+    QAction* batchingAction = viewMenu->addAction(tr("Batch small parts into merged meshes"));
+    batchingAction->setCheckable(true);
+    connect(batchingAction, &QAction::toggled, this, &MainWindow::handleBatchingToggled);
+    QAction* cullingAction = viewMenu->addAction(tr("Cull small and off-screen folders"));
+    cullingAction->setCheckable(true);
+    cullingAction->setChecked(true);
+    connect(cullingAction, &QAction::toggled, this, &MainWindow::handleCullingToggled);
+    QAction* smoothAction = viewMenu->addAction(tr("Smooth shading"));
+    smoothAction->setCheckable(true);
+    connect(smoothAction, &QAction::toggled, this, &MainWindow::handleSmoothShadingToggled);
+    viewMenu->addAction(tr("Smooth shading angle..."), this, &MainWindow::handleFeatureAngle);
+    viewMenu->addAction(tr("Reset camera"), this, &MainWindow::handleResetCamera);
+    QAction* memoryColumnAction = viewMenu->addAction(tr("Show memory column"));
+    memoryColumnAction->setCheckable(true);
+    connect(memoryColumnAction, &QAction::toggled, this, &MainWindow::handleMemoryColumnToggled);
+    ui->treeView->setColumnHidden(ModelPartList::MEMORY_COLUMN, true);
+    viewMenu->addSeparator();
+    QAction* frameStatsAction = viewMenu->addAction(tr("Show frame statistics"));
+    frameStatsAction->setCheckable(true);
+    connect(frameStatsAction, &QAction::toggled, this, &MainWindow::handleFrameStatsToggled);
+    viewMenu->addAction(tr("Export frame trace..."), this, &MainWindow::handleExportFrameTrace);
+
+    // The name index is filled as parts are added, so searching never walks the tree
+    partSearch = new PartSearch(partList, this);
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(SEARCH_DELAY_MS);
+    connect(searchTimer, &QTimer::timeout, this, &MainWindow::handleSearchChanged);
+    connect(partSearch, &PartSearch::indexChanged, searchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    QToolBar* searchBar = addToolBar(tr("Search"));
+    searchBox = new QLineEdit(this);
+    searchBox->setPlaceholderText(tr("Search parts"));
+    searchBox->setClearButtonEnabled(true);
+    searchBar->addWidget(searchBox);
+    connect(searchBox, &QLineEdit::textChanged, searchTimer, static_cast<void (QTimer::*)()>(&QTimer::start));
+    QAction* isolateAction = searchBar->addAction(tr("Isolate matches"));
+    isolateAction->setCheckable(true);
+    connect(isolateAction, &QAction::toggled, this, &MainWindow::handleIsolateToggled);
 
     setupVTK();
 
+    // A desktop frame starts when the event loop wakes up to handle whatever leads to the render
+    connect(QAbstractEventDispatcher::instance(), &QAbstractEventDispatcher::awake, this, [this]() {
+        if (frameRecorder)
+            frameRecorder->markFrameStart();
+    });
+
+    // Hidden parts give their geometry back when the budget is exceeded, they reload when shown
+    memoryBudget = new MemoryBudget(partList, lodGenerator, lodSelector, normalGenerator, partPicker,
+                                    geometryCompactor, this);
+
     emit statusUpdateMessageSignal("Loaded Level0 parts (invisible)", 2000);
 
     vrThread = new VRRenderThread(this);
@@ -69,7 +229,26 @@ MainWindow::~MainWindow()
         vrThread->issueCommand(VRRenderThread::END_RENDER, 0.0);
         vrThread->wait(); //Wait for thread to safely exit
     }
+    delete frameRecorder;
+    frameRecorder = nullptr;
+    // Stop the loader workers before the tree they write into goes away
+    disconnect(partLoader, nullptr, this, nullptr);
+    delete partLoader;
+    disconnect(streamingLoader, nullptr, this, nullptr);
+    delete streamingLoader;
+    delete memoryBudget;
+    delete geometryCompactor;
+    delete partPicker;
+    disconnect(lodGenerator, nullptr, this, nullptr);
+    delete lodGenerator;
+    disconnect(normalGenerator, nullptr, this, nullptr);
+    delete normalGenerator;
     delete vrThread;
+    delete sceneSync;
+    delete instancedRenderer;
+    delete batchRenderer;
+    delete lodSelector;
+    delete desktopStats;
     delete ui;
 }
 
@@ -86,8 +265,36 @@ void MainWindow::setupVTK()
     // Creates a new renderer, which draws the 3d scene, ands the renderer renderwindow
     renderer = vtkSmartPointer<vtkRenderer>::New();
     renderWindow->AddRenderer(renderer);
-    // Sets background colour to grey
-    renderer->SetBackground(0.1, 0.1, 0.1);
+    // Background and other settings shared with the offscreen benchmark
+    configureRenderer(renderer);
+    // Parts that share a mesh are drawn through one instanced actor
+    instancedRenderer = new InstancedRenderer(renderer);
+    // Small parts can be merged into a few meshes with their colours in a lookup table
+    batchRenderer = new BatchRenderer(renderer);
+    // Large parts drop to coarser levels when small on screen or when frames go over budget
+    lodSelector = new LodSelector(renderer, DESKTOP_FRAME_BUDGET);
+    // Follows the tree's change notifications and only touches the actors of parts that changed
+    sceneSync = new SceneSync(partList, renderer, instancedRenderer, batchRenderer, lodSelector, this);
+    connect(sceneSync, &SceneSync::sceneChanged, this, &MainWindow::handleSceneChanged);
+    // Clicking a part in the view selects it in the tree
+    partPicker = new PartPicker(partList, renderer, this);
+    partPicker->attach(renderWindow->GetInteractor());
+    partPicker->setScene(sceneSync);
+    connect(partPicker, &PartPicker::partPicked, this, &MainWindow::handlePartPicked);
+    // Every desktop frame is timed, the overlay shows the recent ones when switched on
+    statsOverlay = vtkSmartPointer<vtkTextActor>::New();
+    statsOverlay->SetDisplayPosition(10, 10);
+    statsOverlay->GetTextProperty()->SetFontSize(14);
+    statsOverlay->GetTextProperty()->SetColor(1.0, 1.0, 1.0);
+    statsOverlay->SetVisibility(false);
+    renderer->AddActor2D(statsOverlay);
+    desktopStats = new FrameStats("Desktop");
+    frameRecorder = new FrameRecorder(renderWindow, renderer, desktopStats);
+    frameRecorder->setFrameCallback([this](const FrameStats::Frame&) {
+        // Shown from the next frame on, the overlay never causes a render of its own
+        if (statsOverlay->GetVisibility())
+            statsOverlay->SetInput(desktopStats->summary().toUtf8().constData());
+    });
     // Triggers initial render 
     renderWindow->Render();
 }
@@ -101,8 +308,7 @@ void MainWindow::statusUpdateMessage(const QString& message, int timeout)
 void MainWindow::on_actionItemOptions_triggered()
 {
     // Get the currently selected item in the tree view, attaches a pointer to a ModelPart, which represents the stl Model
-    QModelIndex index = ui->treeView->currentIndex();
-    ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
+    ModelPart* selectedPart = partFromViewIndex(ui->treeView->currentIndex());
 
     // If no item is selected, show a warning message and exit
     if (!selectedPart) {
@@ -124,20 +330,13 @@ void MainWindow::on_actionItemOptions_triggered()
         QColor chosenColor = optionDialog.getColor();
         selectedPart->setColour(chosenColor.red(), chosenColor.green(), chosenColor.blue());
 
-        // If the VR thread is running, update the corresponding VTK actor color
-        if (vrThread && vrThread->isRunning()) {
-            vtkActor* actor = selectedPart->getActor();
-        }
-
         // Update the visibility of the model part
         selectedPart->setVisible(optionDialog.isVisible());
 
-        // Notify the model/view that the data for this index has changed
+        // Notify the model/view that the data for this index has changed, the scene and VR follow it
+        const QModelIndex index = partList->indexOf(selectedPart);
         partList->dataChanged(index, index);
 
-        // Trigger a render update in the viewer
-        updateRender();
-
         // Emit a signal to display a status message for 2 seconds
         emit statusUpdateMessageSignal("Updated item options", 2000);
     }
@@ -147,75 +346,393 @@ void MainWindow::on_actionItemOptions_triggered()
 // Handle when tree view is clicked and emits a message
 void MainWindow::handleTreeClicked()
 {
-    QModelIndex index = ui->treeView->currentIndex();
-    ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
+    ModelPart* selectedPart = partFromViewIndex(ui->treeView->currentIndex());
 
     if (selectedPart) {
+        // Selecting a part that was loaded on demand reads it in the background
+        partLoader->loadPart(selectedPart);
+
         QString text = selectedPart->data(0).toString();
         emit statusUpdateMessageSignal("Selected item: " + text, 2000);
     }
 }
+// Makes the part clicked in the 3D view the current tree item, a click on empty space changes nothing
+void MainWindow::handlePartPicked(ModelPart* part)
+{
+    if (!part) return;
+
+    // A part hidden by the search has no row in the view, it is still reported
+    const QModelIndex index = partFilter->indexFromPartList(partList->indexOf(part));
+    if (index.isValid()) {
+        ui->treeView->setCurrentIndex(index);
+        ui->treeView->scrollTo(index);
+    }
+
+    emit statusUpdateMessageSignal(QString("Selected item: %1 (picked in %2 ms)")
+                                   .arg(part->data(0).toString()).arg(partPicker->lastPickTime(), 0, 'f', 3), 2000);
+}
+
 // This is the handling of the OpenFile Button, however it actually opens a repositry
 void MainWindow::on_actionOpenFile_triggered()
 {
     QString folderPath = QFileDialog::getExistingDirectory(this, "Select Repositry Folder", QDir::homePath());
 
     if (!folderPath.isEmpty()) {
+        partLoader->cancel();
+        partLoader->cancelParts();
+        streamingLoader->cancel();
+        vrStartPending = false;
+        clearVRScene();
+        discardBackgroundData();
         partList->clear();
-        renderer->RemoveAllViewProps();
 
+        // The timing report covers this repository only
+        LoadProfiler::instance().clear();
         loadInitialPartsFromFolder(folderPath);
 
     }
 }
 
+// The part behind an index of the tree view, which shows the filtered list
+ModelPart* MainWindow::partFromViewIndex(const QModelIndex& index) const
+{
+    return partFilter->partFromIndex(index);
+}
+
+// The parts of the selected rows of the tree view
+QList<ModelPart*> MainWindow::selectedParts() const
+{
+    QList<ModelPart*> parts;
+    for (const QModelIndex& index : ui->treeView->selectionModel()->selectedRows(0)) {
+        if (ModelPart* part = partFromViewIndex(index))
+            parts.append(part);
+    }
+    return parts;
+}
+
+// Each subtree action changes every part first and is drawn in one render once the model reports it
+void MainWindow::handleShowSelected()
+{
+    partList->setSubtreesVisible(selectedParts(), true);
+}
+
+void MainWindow::handleHideSelected()
+{
+    partList->setSubtreesVisible(selectedParts(), false);
+}
+
+void MainWindow::handleIsolateSelected()
+{
+    partList->isolate(selectedParts());
+}
+
+void MainWindow::handleColourSelected()
+{
+    const QList<ModelPart*> parts = selectedParts();
+    if (parts.isEmpty()) return;
+
+    const QColor colour = QColorDialog::getColor(parts.first()->getColor(), this, tr("Subtree colour"));
+    if (colour.isValid())
+        partList->setSubtreesColour(parts, colour);
+}
+
+void MainWindow::handleShowAll()
+{
+    QList<ModelPart*> parts;
+    ModelPart* rootItem = partList->getRootItem();
+    for (int i = 0; i < rootItem->childCount(); ++i)
+        parts.append(rootItem->child(i));
+    partList->setSubtreesVisible(parts, true);
+}
+
 // Handles the selection of a part when the user right clicks on a stlfile allowing them to open option dialog
 void MainWindow::showContextMenu(const QPoint& pos)
 {
     QModelIndex index = ui->treeView->indexAt(pos);
     if (!index.isValid()) return;
 
-    ui->treeView->setCurrentIndex(index); // Make sure context menu affects selected part
+    // Keep a multiple selection the click is part of, otherwise the clicked item becomes the selection
+    if (!ui->treeView->selectionModel()->isSelected(index))
+        ui->treeView->setCurrentIndex(index);
     QMenu contextMenu(this);
     contextMenu.addAction(ui->actionItemOptions);
+    contextMenu.addSeparator();
+    contextMenu.addAction(tr("Show"), this, &MainWindow::handleShowSelected);
+    contextMenu.addAction(tr("Hide"), this, &MainWindow::handleHideSelected);
+    contextMenu.addAction(tr("Isolate"), this, &MainWindow::handleIsolateSelected);
+    contextMenu.addAction(tr("Colour..."), this, &MainWindow::handleColourSelected);
+    contextMenu.addSeparator();
+    contextMenu.addAction(tr("Show all"), this, &MainWindow::handleShowAll);
     contextMenu.exec(ui->treeView->viewport()->mapToGlobal(pos));
 }
 
-void MainWindow::updateRender() {
-    // Clears all existing actors
-    renderer->RemoveAllViewProps();
-    // Recursively add each isible actor from the tree
-    int topLevelCount = partList->rowCount(QModelIndex());
-    for (int i = 0; i < topLevelCount; ++i) {
-        QModelIndex topIndex = partList->index(i, 0, QModelIndex());
-        updateRenderFromTree(topIndex);
-    }
-
-    if (renderer->GetActors()->GetNumberOfItems() > 0) {
+// Renders after the scene changed, the camera only moves by itself when the first parts appear
+void MainWindow::handleSceneChanged(bool firstContent)
+{
+    if (firstContent) {
         renderer->ResetCamera();
     }
 
     renderWindow->Render();
+
+    // Parts drawn for the first time have now built and uploaded their buffers
+    LoadProfiler::instance().collectFirstDraws();
 }
-// Recursively moves through the model tree and adds visible parts to the renderer
-void MainWindow::updateRenderFromTree(const QModelIndex& index)
+
+// Fits the camera to everything that is shown
+void MainWindow::handleResetCamera()
 {
-    if (!index.isValid()) return;
+    renderer->ResetCamera();
+    renderWindow->Render();
+}
 
-    ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
+// Queues level of detail generation, picking hierarchies and smooth meshes for a part and everything below it
+void MainWindow::requestBackgroundData(ModelPart* part)
+{
+    lodGenerator->request(part);
+    partPicker->request(part);
+    part->setSmoothShading(smoothShading);
+    if (smoothShading)
+        normalGenerator->request(part);
+    for (int i = 0; i < part->childCount(); ++i) {
+        requestBackgroundData(part->child(i));
+    }
+}
+
+// Drops all levels of detail and picking hierarchies before the parts they belong to are deleted
+void MainWindow::discardBackgroundData()
+{
+    lodGenerator->clear();
+    lodSelector->releaseMappers();
+    normalGenerator->clear();
+    partPicker->clear();
+    geometryCompactor->clear();
+}
 
-    if (selectedPart && selectedPart->visible()) {
-        vtkSmartPointer<vtkActor> actor = selectedPart->getActor();
+// Puts a subtree in the current shading mode, smooth meshes that are missing are queued
+void MainWindow::applyShading(ModelPart* part)
+{
+    part->setSmoothShading(smoothShading);
+    if (smoothShading)
+        normalGenerator->request(part);
+    for (int i = 0; i < part->childCount(); ++i) {
+        applyShading(part->child(i));
+    }
+}
 
-        if (actor) {
-            renderer->AddActor(actor);
+// Registers new levels for the parts that are currently drawn with their own actor
+void MainWindow::handleLevelsReady(const QList<ModelPart*>& parts)
+{
+    partList->memoryChanged(parts);
+
+    bool changed = false;
+    for (ModelPart* part : parts) {
+        vtkActor* actor = part->getActor();
+        // Parts drawn through an instanced actor keep full detail
+        if (actor && part->visible() && renderer->HasViewProp(actor)) {
+            lodSelector->setLevels(actor, part->getLodLevels());
+            changed = true;
         }
     }
 
-    int rows = partList->rowCount(index);
-    for (int i = 0; i < rows; i++) {
-        updateRenderFromTree(partList->index(i, 0, index));
+    if (changed)
+        renderWindow->Render();
+}
+
+// Parts switch to their smooth mesh as it arrives, the scene is told so instanced copies follow.
+// Its flush renders once for the whole batch
+void MainWindow::handleNormalsReady(const QList<ModelPart*>& parts)
+{
+    partList->memoryChanged(parts);
+    if (!smoothShading) return;
+
+    partList->partsChanged(parts);
+}
+
+// Starts reading any part under the changed rows that was made visible before its geometry was loaded
+void MainWindow::handlePartsChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight)
+{
+    if (!topLeft.isValid()) return;
+
+    const QModelIndex parent = topLeft.parent();
+    for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+        ModelPart* part = static_cast<ModelPart*>(partList->index(row, 0, parent).internalPointer());
+        loadVisibleParts(part);
+        syncVRSubtree(part);
+    }
+}
+
+// Sends colour and visibility edits of a subtree to the running VR scene as one command, newly shown parts are added to it.
+// If the command cannot be queued the changes are not recorded, so the next change of those parts sends them again
+void MainWindow::syncVRSubtree(ModelPart* part)
+{
+    if (!part || !vrThread || !vrThread->isRunning()) return;
+
+    VRChanges changes;
+    vrThread->beginBatch();
+    queueVRSubtree(part, changes);
+    if (!vrThread->endBatch()) {
+        emit statusUpdateMessageSignal("VR scene is busy, changes were not sent", 2000);
+        return;
     }
+
+    for (auto it = changes.added.constBegin(); it != changes.added.constEnd(); ++it) {
+        vrActors.insert(it.key(), it.value());
+    }
+    for (auto it = changes.meshes.constBegin(); it != changes.meshes.constEnd(); ++it) {
+        vrMeshes.insert(it.key(), it.value());
+    }
+    for (auto it = changes.looks.constBegin(); it != changes.looks.constEnd(); ++it) {
+        vrLooks.insert(it.key(), it.value());
+    }
+    for (ModelPart* removed : changes.removed) {
+        vrActors.remove(removed);
+        vrMeshes.remove(removed);
+        vrLooks.remove(removed);
+    }
+}
+
+// What the VR actor of a part should look like now
+MainWindow::VRLook MainWindow::lookOf(ModelPart* part)
+{
+    VRLook look;
+    look.colour = QColor(part->getColourR(), part->getColourG(), part->getColourB());
+    look.visible = part->visible();
+    return look;
+}
+
+// Queues the edits of one subtree into the current VR batch, only what differs from what the actor was
+// last sent. A part whose shaded mesh changed (shading toggled, reloaded) passes the new one on; a part whose geometry was released leaves the VR scene and
+// is added again when it is next shown. Parts still streaming in are kept out of VR until they are
+// loaded, their displayed mesh is edited in place over buffers a worker may free
+void MainWindow::queueVRSubtree(ModelPart* part, VRChanges& changes)
+{
+    vtkSmartPointer<vtkActor> actor = vrActors.value(part);
+    const bool loaded = part->getLoadState() == ModelPart::LoadState::Loaded;
+    if (part->visible() && !actor && loaded && part->getActor()) {
+        actor = part->getNewActor();
+        vrThread->addActorOffline(actor, part->getLodLevels());
+        changes.added.insert(part, actor);
+        changes.meshes.insert(part, part->getShadedMesh());
+        changes.looks.insert(part, lookOf(part));
+    }
+    else if (actor && (!loaded || !part->getShadedMesh())) {
+        vrThread->removeActor(actor);
+        changes.removed.append(part);
+    }
+    else if (actor) {
+        vtkPolyData* mesh = part->getShadedMesh();
+        if (vrMeshes.value(part) != mesh) {
+            vrThread->setActorMesh(actor, mesh, part->getLodLevels());
+            changes.meshes.insert(part, mesh);
+        }
+        const VRLook sent = vrLooks.value(part);
+        const VRLook look = lookOf(part);
+        if (look.colour != sent.colour) {
+            vrThread->setActorColour(actor, look.colour.redF(), look.colour.greenF(), look.colour.blueF());
+        }
+        if (look.visible != sent.visible) {
+            vrThread->setActorVisibility(actor, look.visible);
+        }
+        if (look.colour != sent.colour || look.visible != sent.visible) {
+            changes.looks.insert(part, look);
+        }
+    }
+
+    for (int i = 0; i < part->childCount(); ++i) {
+        queueVRSubtree(part->child(i), changes);
+    }
+}
+
+// Takes every part actor out of the running VR scene in one command, used before the tree is cleared
+void MainWindow::clearVRScene()
+{
+    if (vrThread && vrThread->isRunning()) {
+        vrThread->beginBatch();
+        for (const vtkSmartPointer<vtkActor>& actor : vrActors) {
+            vrThread->removeActor(actor);
+        }
+        if (!vrThread->endBatch()) {
+            emit statusUpdateMessageSignal("VR scene is busy, old parts stay until VR is restarted", 2000);
+        }
+    }
+    vrActors.clear();
+    vrMeshes.clear();
+    vrLooks.clear();
+}
+
+// Recursively queues every visible part that still needs its geometry
+void MainWindow::loadVisibleParts(ModelPart* part)
+{
+    if (!part) return;
+
+    if (part->visible()) {
+        partLoader->loadPart(part);
+    }
+    for (int i = 0; i < part->childCount(); ++i) {
+        loadVisibleParts(part->child(i));
+    }
+}
+
+// A part loaded on demand gets its levels of detail, picking hierarchy and smooth mesh, and VR starts if it was waiting for it
+void MainWindow::handlePartLoaded(ModelPart* part)
+{
+    requestBackgroundData(part);
+
+    if (part->getLoadState() == ModelPart::LoadState::Failed) {
+        emit statusUpdateMessageSignal("Could not read " + part->getFilePath(), 2000);
+    }
+
+    if (vrStartPending && partLoader->pendingParts() == 0) {
+        vrStartPending = false;
+        handleStartVR();
+    }
+}
+
+// Switches instanced drawing of repeated meshes on or off
+void MainWindow::handleInstancingToggled(bool enabled)
+{
+    instancedRenderer->setEnabled(enabled);
+    sceneSync->rebuild();
+}
+
+// Switches every part between flat facets and smooth normals, instanced groups are rebuilt with the new mesh
+void MainWindow::handleSmoothShadingToggled(bool smooth)
+{
+    smoothShading = smooth;
+    applyShading(partList->getRootItem());
+    sceneSync->rebuild();
+    syncVRSubtree(partList->getRootItem());
+}
+
+// Lets the user pick the angle above which an edge stays sharp in smooth shading
+void MainWindow::handleFeatureAngle()
+{
+    bool ok = false;
+    double angle = QInputDialog::getDouble(this, tr("Smooth shading"), tr("Feature angle (degrees):"),
+                                           normalGenerator->featureAngle(), 0.0, 180.0, 1, &ok);
+    if (!ok || angle == normalGenerator->featureAngle())
+        return;
+
+    // Every smooth mesh is rebuilt, or read from the cache if it was stored with this angle
+    normalGenerator->setFeatureAngle(angle);
+    applyShading(partList->getRootItem());
+    sceneSync->rebuild();
+    syncVRSubtree(partList->getRootItem());
+}
+
+// Switches merging of small parts into batches on or off
+void MainWindow::handleBatchingToggled(bool enabled)
+{
+    batchRenderer->setEnabled(enabled);
+    sceneSync->rebuild();
+}
+
+// Switches the folder level culling on or off
+void MainWindow::handleCullingToggled(bool enabled)
+{
+    sceneSync->setCullingEnabled(enabled);
+    renderWindow->Render();
 }
 
 // Loads model parts from a specified folder and its subfolders, then updates the render view
@@ -227,60 +744,302 @@ void MainWindow::loadInitialPartsFromFolder(const QString& folderPath)
         return;
     }
 
-    loadPartsRecursively(dir, partList->getRootItem());
-    updateRender();
+    // Parts are added to the tree in batches as the workers finish, see handleLoadFinished
+    partLoader->loadFolder(folderPath);
+    normalGenerator->setCache(partLoader->currentCache(), partLoader->currentWeldOptions());
 }
-// Code for the button that starts the VR
-void MainWindow::startVRRendering() {
 
-    // loop through tree and add actors using add actor offline
+// Lets the user pick how duplicate STL corners are merged when parts are loaded
+void MainWindow::handleWeldOptions()
+{
+    const QStringList modes = { tr("Off"), tr("Exact"), tr("Tolerance") };
 
-    if (vrThread && !vrThread->isRunning()) {
-        vrThread->start();
-        emit statusUpdateMessageSignal("VR thread started", 2000);
+    bool ok = false;
+    QString mode = QInputDialog::getItem(this, tr("Vertex welding"), tr("Merge vertices:"),
+                                         modes, static_cast<int>(weldOptions.mode), false, &ok);
+    if (!ok)
+        return;
+
+    MeshWelder::Options options = weldOptions;
+    options.mode = static_cast<MeshWelder::Mode>(modes.indexOf(mode));
+
+    if (options.mode == MeshWelder::Mode::Tolerance) {
+        options.tolerance = QInputDialog::getDouble(this, tr("Vertex welding"), tr("Tolerance (model units):"),
+                                                    weldOptions.tolerance, 1.0e-9, 1.0e3, 9, &ok);
+        if (!ok)
+            return;
+    }
+
+    weldOptions = options;
+    partLoader->setWeldOptions(weldOptions);
+
+    emit statusUpdateMessageSignal("Vertex welding applies to parts loaded from now on", 2000);
+}
+
+// Welded meshes are reordered for the vertex cache and overdraw. The cache keeps an entry per setting,
+// so switching back reuses the entries written before
+void MainWindow::handleMeshOrderToggled(bool optimise)
+{
+    weldOptions.optimiseOrder = optimise;
+    partLoader->setWeldOptions(weldOptions);
+    lodGenerator->setOptimiseOrder(optimise);
+
+    emit statusUpdateMessageSignal("Mesh order applies to parts loaded from now on", 2000);
+}
+
+// Lets the user cap the memory held by part geometry, 0 turns the cap off
+void MainWindow::handleMemoryBudget()
+{
+    const qint64 mebibyte = 1024 * 1024;
+    const QString used = QLocale().formattedDataSize(memoryBudget->usedBytes());
+
+    bool ok = false;
+    int budget = QInputDialog::getInt(this, tr("Memory budget"),
+                                      tr("Geometry memory limit in MiB, 0 for no limit (%1 in use):").arg(used),
+                                      int(memoryBudget->budget() / mebibyte), 0, 1024 * 1024, 256, &ok);
+    if (!ok)
+        return;
+
+    memoryBudget->setBudget(budget * mebibyte);
+
+    emit statusUpdateMessageSignal("Geometry memory in use: " + QLocale().formattedDataSize(memoryBudget->usedBytes()), 2000);
+}
+
+// Hidden parts are compacted straight away, turning it off leaves the copies already made
+void MainWindow::handleCompactionToggled(bool enabled)
+{
+    geometryCompactor->setEnabled(enabled);
+    memoryBudget->enforce();
+
+    emit statusUpdateMessageSignal(enabled ? "Hidden parts are kept as compact copies" : "Hidden parts keep their full geometry", 2000);
+}
+
+// Lets the user trade precision for memory, the report shows what the current copies lost
+void MainWindow::handleCompactPrecision()
+{
+    CompactMesh::Options options = geometryCompactor->options();
+
+    bool ok = false;
+    options.positionBits = QInputDialog::getInt(this, tr("Compact precision"),
+                                                tr("Bits per coordinate, 8 halves the memory of 9 to 16:"),
+                                                options.positionBits, 8, 16, 1, &ok);
+    if (!ok)
+        return;
+
+    options.normalBits = QInputDialog::getInt(this, tr("Compact precision"),
+                                              tr("Bits per normal component, 8 halves the memory of 9 to 16:"),
+                                              options.normalBits, 8, 16, 1, &ok);
+    if (!ok)
+        return;
+
+    geometryCompactor->setOptions(options);
+
+    emit statusUpdateMessageSignal("Compact precision applies to parts hidden from now on", 2000);
+}
+
+// Memory saved and the worst error over every compact copy held now
+void MainWindow::handleCompactReport()
+{
+    const GeometryCompactor::Report report = geometryCompactor->report();
+    const CompactMesh::Options options = geometryCompactor->options();
+
+    QString text = tr("Precision: %1 bit positions, %2 bit normals\n").arg(options.positionBits).arg(options.normalBits);
+    if (report.meshes == 0) {
+        text += tr("No parts are compacted.");
     }
     else {
-        emit statusUpdateMessageSignal("VR thread is already running", 2000);
+        text += tr("%1 meshes take %2 instead of %3 (%4%)\n")
+                    .arg(report.meshes)
+                    .arg(QLocale().formattedDataSize(report.compactBytes))
+                    .arg(QLocale().formattedDataSize(report.sourceBytes))
+                    .arg(100.0 * report.compactBytes / std::max<qint64>(1, report.sourceBytes), 0, 'f', 1);
+        text += tr("Largest position error: %1 model units, %2% of the part size\n")
+                    .arg(report.error.position, 0, 'g', 3)
+                    .arg(100.0 * report.error.relative, 0, 'g', 3);
+        text += tr("Largest normal error: %1 degrees").arg(report.error.normalDegrees, 0, 'f', 2);
     }
+
+    QMessageBox::information(this, tr("Compact geometry"), text);
+}
+
+// Shows or hides the per part memory column of the tree
+void MainWindow::handleMemoryColumnToggled(bool shown)
+{
+    ui->treeView->setColumnHidden(ModelPartList::MEMORY_COLUMN, !shown);
+}
+
+// Shows where load time went, stage totals first and then the slowest files
+void MainWindow::handleLoadReport()
+{
+    const QString report = LoadProfiler::instance().report();
+
+    QMessageBox box(this);
+    box.setWindowTitle(tr("Load timing"));
+    box.setText(report.section("\n\n", 0, 1));
+    box.setDetailedText(report);
+    box.exec();
+}
+
+// Saves the load timings as a trace that chrome://tracing or Perfetto can open
+void MainWindow::handleExportLoadTrace()
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("Export load trace"), QDir::homePath() + "/load-trace.json",
+                                                tr("Trace files (*.json)"));
+    if (path.isEmpty())
+        return;
+
+    if (LoadProfiler::instance().writeChromeTrace(path))
+        emit statusUpdateMessageSignal("Load trace written to " + path, 2000);
+    else
+        QMessageBox::warning(this, tr("Export load trace"), tr("Could not write %1").arg(path));
+}
+
+// Shows or hides the frame statistics drawn over the 3D view
+void MainWindow::handleFrameStatsToggled(bool shown)
+{
+    statsOverlay->SetInput(desktopStats->summary().toUtf8().constData());
+    statsOverlay->SetVisibility(shown);
+    renderWindow->Render();
+}
+
+// Saves the desktop and VR frame timings together with the load timings as one trace
+void MainWindow::handleExportFrameTrace()
+{
+    QString path = QFileDialog::getSaveFileName(this, tr("Export frame trace"), QDir::homePath() + "/frame-trace.json",
+                                                tr("Trace files (*.json)"));
+    if (path.isEmpty())
+        return;
+
+    QList<const FrameStats*> sources = { desktopStats };
+    if (vrThread)
+        sources.append(&vrThread->getFrameStats());
+
+    if (FrameStats::writeChromeTrace(path, sources))
+        emit statusUpdateMessageSignal("Frame trace written to " + path, 2000);
+    else
+        QMessageBox::warning(this, tr("Export frame trace"), tr("Could not write %1").arg(path));
+}
+
+// Deletes the user level .stlcache entries, the next load re-parses every file
+void MainWindow::handleClearGeometryCache()
+{
+    GeometryCache(GeometryCache::userDirectory()).clear();
+    emit statusUpdateMessageSignal("Geometry cache cleared", 2000);
 }
 
-// Recursively loads all STL files and subfolders from a given directory into the model tree.
-void MainWindow::loadPartsRecursively(const QDir& dir, ModelPart* parentItem)
+// Shows loader progress in the status bar while a folder is loading
+void MainWindow::handleLoadProgress(int loaded, int total)
 {
-    QStringList filters;
-    filters << "*.stl" << "*.STL";
+    loadProgress->setMaximum(total);
+    loadProgress->setValue(loaded);
+    loadProgress->show();
+    cancelLoadButton->show();
 
-    // Load STL files in this directory
-    QFileInfoList fileList = dir.entryInfoList(filters, QDir::Files);
-    for (const QFileInfo& fileInfo : fileList) {
-        QString filePath = fileInfo.absoluteFilePath();
-        ModelPart* part = new ModelPart({ fileInfo.fileName(), 0 }, parentItem);
-        parentItem->appendChild(part);
+    emit statusUpdateMessageSignal(QString("Loading parts: %1 / %2").arg(loaded).arg(total), 0);
+}
 
-        part->loadSTL(filePath);
+// Shows how much of a streamed file is on screen, a zero total means it cannot be split into chunks
+void MainWindow::handleStreamProgress(ModelPart* part, qint64 triangles, qint64 total)
+{
+    loadProgress->setMaximum(total > 0 ? 1000 : 0);
+    loadProgress->setValue(total > 0 ? int(1000 * triangles / total) : 0);
+    loadProgress->show();
+    cancelLoadButton->show();
 
-        part->setVisible(false);  // Default invisible
+    emit statusUpdateMessageSignal(QString("Streaming %1: %2 / %3 triangles").arg(part->data(0).toString())
+                                   .arg(QLocale().toString(triangles)).arg(QLocale().toString(total)), 0);
+}
 
-        qDebug() << "Loaded" << filePath << "and set to invisible.";
+// A streamed part is complete and welded, it is treated like any other loaded part from now on
+void MainWindow::handleStreamLoaded(ModelPart* part)
+{
+    if (!streamingLoader->isLoading()) {
+        loadProgress->hide();
+        cancelLoadButton->hide();
     }
 
-    // Now handle subdirectories
-    QFileInfoList dirList = dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot);
-    for (const QFileInfo& subdirInfo : dirList) {
-        QString subdirPath = subdirInfo.absoluteFilePath();
-        QDir subdir(subdirPath);
+    handlePartLoaded(part);
+    if (part->getLoadState() == ModelPart::LoadState::Loaded)
+        emit statusUpdateMessageSignal("Loaded single file: " + part->data(0).toString(), 2000);
+}
+
+void MainWindow::handleStreamCancelled(const QString& filePath)
+{
+    loadProgress->hide();
+    cancelLoadButton->hide();
+    emit statusUpdateMessageSignal("Loading cancelled: " + QFileInfo(filePath).fileName(), 2000);
+}
+
+void MainWindow::handleStreamingToggled(bool enabled)
+{
+    streamLargeFiles = enabled;
+}
+
+// Runs the search box query against the name index once typing pauses, narrows the tree and optionally the 3D view to the matches
+void MainWindow::handleSearchChanged()
+{
+    searchTimer->stop();
+    const QString text = searchBox->text().trimmed();
+    if (text.isEmpty()) {
+        partFilter->clearMatches();
+        sceneSync->setIsolation(false);
+        return;
+    }
 
-        // Create a ModelPart to represent the folder
-        ModelPart* folderItem = new ModelPart({ subdirInfo.fileName(), 0 }, parentItem);
-        parentItem->appendChild(folderItem);
+    const QVector<ModelPart*> found = partSearch->find(text);
+    QSet<ModelPart*> matches;
+    matches.reserve(found.size());
+    for (ModelPart* part : found)
+        matches.insert(part);
 
-        qDebug() << "Created folder node:" << subdirPath;
+    partFilter->setMatches(matches);
+    sceneSync->setIsolation(isolateMatches, matches);
 
-        // Recursively load parts from the subfolder
-        loadPartsRecursively(subdir, folderItem);
+    // Opening the folders of a few matches is quick, for many it would cost more than the search
+    if (found.size() <= MAX_EXPANDED_MATCHES) {
+        for (ModelPart* part : found) {
+            for (ModelPart* folder = part->parentItem(); folder && folder != partList->getRootItem(); folder = folder->parentItem())
+                ui->treeView->expand(partFilter->indexFromPartList(partList->indexOf(folder)));
+        }
     }
 
+    emit statusUpdateMessageSignal(QString("%1 of %2 parts match (%3 ms)").arg(found.size()).arg(partSearch->partCount())
+                                   .arg(partSearch->lastFindTime(), 0, 'f', 3), 2000);
 }
+
+void MainWindow::handleIsolateToggled(bool isolate)
+{
+    isolateMatches = isolate;
+    handleSearchChanged();
+}
+
+// Hides the progress widgets and refreshes the view once a folder load ends
+void MainWindow::handleLoadFinished(int loaded, int total, bool cancelled)
+{
+    loadProgress->hide();
+    cancelLoadButton->hide();
+
+    requestBackgroundData(partList->getRootItem());
+
+    if (cancelled)
+        emit statusUpdateMessageSignal(QString("Loading cancelled after %1 of %2 parts").arg(loaded).arg(total), 2000);
+    else
+        emit statusUpdateMessageSignal(QString("Loaded %1 parts (invisible)").arg(loaded), 2000);
+}
+// Code for the button that starts the VR
+void MainWindow::startVRRendering() {
+
+    // loop through tree and add actors using add actor offline
+
+    if (vrThread && !vrThread->isRunning()) {
+        vrThread->start();
+        emit statusUpdateMessageSignal("VR thread started", 2000);
+    }
+    else {
+        emit statusUpdateMessageSignal("VR thread is already running", 2000);
+    }
+}
+
 //
 void MainWindow::handleStartVR() {
     if (vrThread && vrThread->isRunning()) {
@@ -289,12 +1048,23 @@ void MainWindow::handleStartVR() {
             return;
     }
 
+    // Visible parts that were loaded on demand are read first, VR starts from handlePartLoaded
+    loadVisibleParts(partList->getRootItem());
+    if (partLoader->pendingParts() > 0) {
+        vrStartPending = true;
+        emit statusUpdateMessageSignal("Loading visible parts for VR...", 0);
+        return;
+    }
+
     if (vrThread) {
         vrThread->deleteLater(); // deletion of previous thread
     }
 
     vrThread = new VRRenderThread();
 
+    vrActors.clear();
+    vrMeshes.clear();
+    vrLooks.clear();
     addVisiblePartsToVR(vrThread);
 
     vrThread->start();
@@ -317,10 +1087,13 @@ void MainWindow::addVisiblePartsToVR(VRRenderThread* thread) {
 void MainWindow ::addPartsFromTree(const QModelIndex& index, VRRenderThread* thread){
 
     ModelPart* selectedPart = static_cast<ModelPart*>(index.internalPointer());
-    if (selectedPart->visible()) {
+    // A part still streaming in joins through syncVRSubtree() once it is loaded
+    if (selectedPart->visible() && selectedPart->getLoadState() == ModelPart::LoadState::Loaded) {
         vtkSmartPointer<vtkActor> actor = selectedPart->getNewActor();
-        if (actor) {
-            thread->addActorOffline(actor);
+        if (actor && thread->addActorOffline(actor, selectedPart->getLodLevels())) {
+            vrActors.insert(selectedPart, actor);
+            vrMeshes.insert(selectedPart, selectedPart->getShadedMesh());
+            vrLooks.insert(selectedPart, lookOf(selectedPart));
         }
     }
     int rows = partList->rowCount(index);
@@ -341,24 +1114,33 @@ void MainWindow::on_actionOpenSingleFile_triggered()
         return;
 
     QFileInfo fileInfo(filePath);
-    partList->addPart(fileInfo.fileName(), filePath);
+    if (streamLargeFiles && MappedSTLReader::binaryTriangleCount(filePath) >= StreamingLoader::MIN_STREAMED_TRIANGLES) {
+        streamingLoader->load(fileInfo.fileName(), filePath, weldOptions);
+        emit statusUpdateMessageSignal("Streaming " + fileInfo.fileName(), 0);
+        return;
+    }
+
+    partList->addPart(fileInfo.fileName(), filePath, weldOptions);
+    ModelPart* rootItem = partList->getRootItem();
+    requestBackgroundData(rootItem->child(rootItem->childCount() - 1));
 
-    updateRender();
     emit statusUpdateMessageSignal("Loaded single file: " + fileInfo.fileName(), 2000);
     qDebug() << "Loaded single file:" << filePath;
 }
 
 void MainWindow::on_actionClearTreeView_triggered()
 {
-    // Clear the model (removes all ModelPart entries)
+    // Stop any folder load so it does not add parts to the cleared tree
+    partLoader->cancel();
+    partLoader->cancelParts();
+    streamingLoader->cancel();
+    vrStartPending = false;
+    clearVRScene();
+    discardBackgroundData();
+
+    // Clear the model (removes all ModelPart entries), the scene drops their actors and re-renders
     partList->clear();
 
-    // Clear all VTK actors from the renderer
-    renderer->RemoveAllViewProps();
-
-    // Trigger a render update to reflect the empty scene
-    renderWindow->Render();
-
     // Optionally show a status bar message
     emit statusUpdateMessageSignal("Tree view and VTK scene cleared", 2000);
 
@@ -370,6 +1152,9 @@ void MainWindow::handleStopVR() {
     if (vrThread && vrThread->isRunning()) {
         vrThread->issueCommand(VRRenderThread::END_RENDER, 0.0); // assuming END_RENDER properly stops rendering
         vrThread->wait(); // Wait until the thread has stopped
+        vrActors.clear();
+        vrMeshes.clear();
+        vrLooks.clear();
         emit statusUpdateMessageSignal("VR thread stopped", 2000);
         qDebug() << "VR thread stopped safely.";
     }
@@ -4,17 +4,40 @@
 #include <QMainWindow>
 #include <QModelIndex>
 #include <QDir>
+#include <QHash>
+#include <QColor>
 
 #include "VRRenderThread.h"
+#include "MeshWelder.h"
 
 // Forward declarations
 class ModelPart;
 class ModelPartList;
+class PartLoader;
+class StreamingLoader;
+class PartSearch;
+class PartFilterModel;
+class InstancedRenderer;
+class BatchRenderer;
+class LodGenerator;
+class LodSelector;
+class NormalGenerator;
+class SceneSync;
+class MemoryBudget;
+class GeometryCompactor;
+class PartPicker;
+class FrameStats;
+class FrameRecorder;
+class QProgressBar;
+class QPushButton;
+class QLineEdit;
+class QTimer;
 
 // VTK includes
 #include <vtkSmartPointer.h>
 #include <vtkRenderer.h>
 #include <vtkGenericOpenGLRenderWindow.h>
+#include <vtkTextActor.h>
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -33,15 +56,49 @@ signals:
     void sendActors(vtkActorCollection* actors);
 
 private slots:
-    void updateRender();
-    void updateRenderFromTree(const QModelIndex& index);
+    void handleSceneChanged(bool firstContent);
+    void handleResetCamera();
     void handleTreeClicked();
     void on_actionOpenFile_triggered();
     void on_actionOpenSingleFile_triggered();
     void on_actionItemOptions_triggered();
     void statusUpdateMessage(const QString &message, int timeout); 
     void loadInitialPartsFromFolder(const QString& folderPath);
-    void loadPartsRecursively(const QDir& dir, ModelPart* parentItem);
+    void handleLoadProgress(int loaded, int total);
+    void handleLoadFinished(int loaded, int total, bool cancelled);
+    void handleStreamProgress(ModelPart* part, qint64 triangles, qint64 total);
+    void handleStreamLoaded(ModelPart* part);
+    void handleStreamCancelled(const QString& filePath);
+    void handleStreamingToggled(bool enabled);
+    void handleSearchChanged();
+    void handleShowSelected();
+    void handleHideSelected();
+    void handleIsolateSelected();
+    void handleColourSelected();
+    void handleShowAll();
+    void handleIsolateToggled(bool isolate);
+    void handleWeldOptions();
+    void handleMeshOrderToggled(bool optimise);
+    void handleInstancingToggled(bool enabled);
+    void handleBatchingToggled(bool enabled);
+    void handleCullingToggled(bool enabled);
+    void handleClearGeometryCache();
+    void handleLevelsReady(const QList<ModelPart*>& parts);
+    void handleNormalsReady(const QList<ModelPart*>& parts);
+    void handleSmoothShadingToggled(bool smooth);
+    void handleFeatureAngle();
+    void handlePartsChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+    void handlePartLoaded(ModelPart* part);
+    void handleMemoryBudget();
+    void handleCompactionToggled(bool enabled);
+    void handleCompactPrecision();
+    void handleCompactReport();
+    void handleMemoryColumnToggled(bool shown);
+    void handleLoadReport();
+    void handleExportLoadTrace();
+    void handleFrameStatsToggled(bool shown);
+    void handlePartPicked(ModelPart* part);
+    void handleExportFrameTrace();
     void startVRRendering();
     void handleStartVR();
     void on_actionClearTreeView_triggered();
@@ -56,11 +113,62 @@ private:
 private:
     Ui::MainWindow *ui;
     ModelPartList* partList;
+    PartFilterModel* partFilter;   // What the tree view shows, the parts list narrowed to search matches
+    PartSearch* partSearch;
+    QLineEdit* searchBox;
+    QTimer* searchTimer;           // Runs the query once typing pauses
+    bool isolateMatches = false;   // Only search matches are drawn while there is a search
+    PartLoader* partLoader;
+    StreamingLoader* streamingLoader;
+    bool streamLargeFiles = true;  // Large binary files opened on their own are shown while they are read
+    QProgressBar* loadProgress;
+    QPushButton* cancelLoadButton;
+    MeshWelder::Options weldOptions;
+    bool vrStartPending = false;   // VR starts once the visible parts have been read
+    QHash<ModelPart*, vtkSmartPointer<vtkActor>> vrActors;   // Actors handed to the running VR thread
+    QHash<ModelPart*, vtkSmartPointer<vtkPolyData>> vrMeshes; // Mesh each of those actors was last given
+    // Colour and visibility an actor was last given
+    struct VRLook {
+        QColor colour;
+        bool visible = true;
+    };
+    QHash<ModelPart*, VRLook> vrLooks;
+    // Edits of one VR batch, recorded in vrActors, vrMeshes and vrLooks once the batch is queued
+    struct VRChanges {
+        QHash<ModelPart*, vtkSmartPointer<vtkActor>> added;
+        QHash<ModelPart*, vtkSmartPointer<vtkPolyData>> meshes;
+        QHash<ModelPart*, VRLook> looks;
+        QList<ModelPart*> removed;
+    };
+    // Colour and visibility a part's VR actor should have
+    static VRLook lookOf(ModelPart* part);
     // VTK Rendering Components
     vtkSmartPointer<vtkRenderer> renderer;
     vtkSmartPointer<vtkGenericOpenGLRenderWindow> renderWindow;
+    InstancedRenderer* instancedRenderer = nullptr;
+    BatchRenderer* batchRenderer = nullptr;
+    LodGenerator* lodGenerator;
+    LodSelector* lodSelector = nullptr;
+    NormalGenerator* normalGenerator;
+    bool smoothShading = false;    // Parts are drawn with split smooth normals once they are generated
+    SceneSync* sceneSync = nullptr;
+    MemoryBudget* memoryBudget = nullptr;
+    GeometryCompactor* geometryCompactor = nullptr;   // Swaps hidden meshes for quantised copies when switched on
+    PartPicker* partPicker = nullptr;
+    FrameStats* desktopStats = nullptr;
+    FrameRecorder* frameRecorder = nullptr;
+    vtkSmartPointer<vtkTextActor> statsOverlay;   // Frame statistics drawn over the view, hidden by default
 
     void setupVTK(); 
+    ModelPart* partFromViewIndex(const QModelIndex& index) const;
+    QList<ModelPart*> selectedParts() const;
+    void requestBackgroundData(ModelPart* part);
+    void applyShading(ModelPart* part);
+    void loadVisibleParts(ModelPart* part);
+    void syncVRSubtree(ModelPart* part);
+    void queueVRSubtree(ModelPart* part, VRChanges& changes);
+    void clearVRScene();
+    void discardBackgroundData();
     void showContextMenu(const QPoint &pos);
 
     void addVisiblePartsToVR(VRRenderThread* thread);